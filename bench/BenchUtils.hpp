@@ -0,0 +1,128 @@
+#ifndef BENCHUTILS_HPP
+#define BENCHUTILS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Вспомогательные функции для микробенчмарков.
+ */
+namespace bench {
+
+/**
+ * @brief Запускает fn несколько раз и возвращает медианное время одного запуска (сек).
+ */
+template <typename Fn>
+double medianSeconds(Fn&& fn, int repeats = 7) {
+    std::vector<double> times;
+    times.reserve(repeats);
+    for (int i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto stop = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double>(stop - start).count());
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+/**
+ * @brief Результаты текущего запуска: имя строки отчёта и время (сек)
+ */
+inline std::vector<std::pair<std::string, double>>& results() {
+    static std::vector<std::pair<std::string, double>> list;
+    return list;
+}
+
+/**
+ * @brief Запоминает результат для сравнения с базовой линией (см. finish).
+ */
+inline void record(const std::string& name, double seconds) {
+    results().emplace_back(name, seconds);
+}
+
+/**
+ * @brief Печатает строку отчёта: имя, время, пропускная способность.
+ */
+inline void report(const char* name, double seconds, double items) {
+    std::printf("%-40s %10.3f ms %12.2f Mitems/s\n",
+                name, seconds * 1e3, items / seconds / 1e6);
+    record(name, seconds);
+}
+
+/**
+ * @brief Сравнивает результаты запуска с базовой линией или записывает их в неё.
+ *
+ * Файл базовой линии задаёт MAP_BUILDER_BASELINE: строки
+ * "бенчмарк/строка отчёта<TAB>секунды" для всех бенчмарков сразу. При
+ * MAP_BUILDER_BASELINE_SAVE=1 строки этого бенчмарка заменяются текущими,
+ * иначе каждая строка сравнивается с записанной: замедление больше
+ * MAP_BUILDER_BASELINE_TOLERANCE (доля, по умолчанию 0.15) — регрессия.
+ * @param benchmark Имя бенчмарка (префикс строк файла)
+ * @return Код возврата main: 1, если есть регрессия
+ */
+inline int finish(const char* benchmark) {
+    const char* path = std::getenv("MAP_BUILDER_BASELINE");
+    if (!path || !*path)
+        return 0;
+    const std::string prefix = std::string(benchmark) + "/";
+
+    std::map<std::string, double> baseline;
+    {
+        std::ifstream ifs(path);
+        std::string line;
+        while (std::getline(ifs, line)) {
+            const std::size_t tab = line.rfind('\t');
+            if (tab != std::string::npos)
+                baseline[line.substr(0, tab)] = std::atof(line.c_str() + tab + 1);
+        }
+    }
+
+    const char* save = std::getenv("MAP_BUILDER_BASELINE_SAVE");
+    if (save && std::string(save) == "1") {
+        for (auto it = baseline.begin(); it != baseline.end();)
+            it = it->first.compare(0, prefix.size(), prefix) == 0 ? baseline.erase(it) : std::next(it);
+        for (const auto& result : results())
+            baseline[prefix + result.first] = result.second;
+        std::ofstream ofs(path, std::ios::trunc);
+        for (const auto& entry : baseline)
+            ofs << entry.first << '\t' << entry.second << '\n';
+        std::printf("базовая линия записана: %s\n", path);
+        return ofs ? 0 : 1;
+    }
+
+    const char* toleranceText = std::getenv("MAP_BUILDER_BASELINE_TOLERANCE");
+    const double tolerance = toleranceText ? std::atof(toleranceText) : 0.15;
+    int regressions = 0;
+    std::printf("\n%-40s %12s %12s %8s\n", "сравнение с базовой линией", "было, мс", "стало, мс", "отн.");
+    for (const auto& result : results()) {
+        auto it = baseline.find(prefix + result.first);
+        if (it == baseline.end() || it->second <= 0.0)
+            continue;
+        const double ratio = result.second / it->second;
+        const bool regressed = ratio > 1.0 + tolerance;
+        regressions += regressed;
+        std::printf("%-40s %12.3f %12.3f %7.2fx%s\n", result.first.c_str(), it->second * 1e3,
+                    result.second * 1e3, ratio, regressed ? "  РЕГРЕССИЯ" : "");
+    }
+    return regressions ? 1 : 0;
+}
+
+/**
+ * @brief Не даёт компилятору выбросить вычисление значения.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+} // namespace bench
+
+#endif // BENCHUTILS_HPP
@@ -0,0 +1,200 @@
+#ifndef SYNTHETICDATASET_HPP
+#define SYNTHETICDATASET_HPP
+
+#include "Camera.hpp"
+#include "PoseTransform.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Синтетический проезд для бенчмарков: траектория .ext1 и кадры сегментации.
+ */
+namespace bench {
+
+/**
+ * @brief Параметры синтетического проезда.
+ *
+ * Путь — прямая (radius = 0) или дуга постоянного радиуса. Координаты
+ * траектории заданы до зеркалирования PipelineConfig::mirrorX, как в
+ * реальных журналах. Метки кадра: 1 — рельс, 2 — полотно между рельсами,
+ * 0 — остальное.
+ */
+struct SyntheticConfig
+{
+    double length = 200.0;      ///< Длина пути (м)
+    double radius = 0.0;        ///< Радиус кривой (м); 0 — прямая, знак — сторона поворота
+    double speed = 10.0;        ///< Скорость (м/с)
+    double frameRate = 10.0;    ///< Частота кадров (Гц)
+    double poseRate = 50.0;     ///< Частота записей траектории (Гц)
+    int width = 1920;           ///< Ширина кадра (пикс)
+    int height = 1080;          ///< Высота кадра (пикс)
+    double roiTopFraction = 0.4; ///< Верхняя доля строк кадра остаётся пустой (как PipelineConfig)
+    double trackOffset = 0.25;  ///< Смещение оси пути от камеры вбок (м)
+    double gauge = 1.5;         ///< Расстояние между рельсами (м)
+    double railWidth = 0.08;    ///< Ширина рельса (м)
+    double maxRange = 60.0;     ///< Дальше этого расстояния пиксели не размечаются (м)
+    double startTime = 1000.0;  ///< Время первой записи траектории (с)
+};
+
+/**
+ * @brief Камера с опорными точками main.cpp, пересчитанными под размер кадра.
+ */
+inline bool makeCamera(const SyntheticConfig& config, Camera& camera) {
+    // Опорные точки main.cpp масштабируются от кадра 1024x576
+    const float sx = config.width / 1024.f;
+    const float sy = config.height / 576.f;
+    std::vector<cv::Point2f> imgPts = {
+        {414.f * sx, 540.f * sy}, {617.f * sx, 540.f * sy}, {443.f * sx, 408.f * sy}, {557.f * sx, 408.f * sy}};
+    std::vector<cv::Point2f> worldPts = {{3.5f, -0.5f}, {3.5f, 1.f}, {6.1f, -0.5f}, {6.1f, 1.f}};
+    return camera.computeHomography(imgPts, worldPts);
+}
+
+/**
+ * @brief Поза на расстоянии s от начала пути (x, y в метрах, yaw в градусах).
+ *
+ * В системе траектории камера смотрит вдоль (-sin yaw, cos yaw), а её
+ * поперечная ось — (cos yaw, sin yaw) (см. PoseTransform).
+ */
+inline void trackPose(const SyntheticConfig& config, double s, double& x, double& y, double& yaw) {
+    if (config.radius == 0.0) {
+        x = 0.0;
+        y = s;
+        yaw = 0.0;
+        return;
+    }
+    const double theta = s / config.radius;
+    x = config.radius * (std::cos(theta) - 1.0);
+    y = config.radius * std::sin(theta);
+    yaw = theta * 180.0 / CV_PI;
+}
+
+/**
+ * @brief Смещение точки (x, y) системы траектории поперёк пути (по поперечной оси камеры).
+ */
+inline double lateralOffset(const SyntheticConfig& config, double x, double y) {
+    if (config.radius == 0.0)
+        return x;
+    // Центр кривой лежит на поперечной оси начальной позы на расстоянии radius
+    const double d = std::hypot(x + config.radius, y);
+    return config.radius > 0.0 ? d - config.radius : -config.radius - d;
+}
+
+/**
+ * @brief Записывает траекторию в формате .ext1 (со служебными столбцами, как в реальных журналах).
+ */
+inline bool writeTrajectory(const SyntheticConfig& config, const std::string& path) {
+    std::ofstream ofs(path);
+    if (!ofs.is_open()) {
+        std::cerr << "Не удалось открыть файл: " << path << "\n";
+        return false;
+    }
+    ofs << "frame, time.s, speed.mps, local.x.m, local.y.m, local.z.m, local_yaw.grad, quality\n";
+    // Записи с запасом в секунду с обеих сторон, чтобы позы кадров интерполировались
+    const double duration = config.length / config.speed;
+    const std::size_t count = static_cast<std::size_t>((duration + 2.0) * config.poseRate) + 1;
+    char line[256];
+    for (std::size_t i = 0; i < count; i++) {
+        const double t = i / config.poseRate;
+        double x, y, yaw;
+        trackPose(config, (t - 1.0) * config.speed, x, y, yaw);
+        std::snprintf(line, sizeof(line), "%zu, %.4f, %.3f, %.4f, %.4f, %.3f, %.5f, %d\n",
+                      i, config.startTime + t, config.speed, x, y, 150.0, yaw, 4);
+        ofs << line;
+    }
+    return static_cast<bool>(ofs);
+}
+
+/**
+ * @brief Число кадров проезда.
+ */
+inline std::size_t frameCount(const SyntheticConfig& config) {
+    return static_cast<std::size_t>(config.length / config.speed * config.frameRate) + 1;
+}
+
+/**
+ * @brief Время кадра index (с).
+ */
+inline double frameTime(const SyntheticConfig& config, std::size_t index) {
+    // Целые миллисекунды: время кадра восстанавливается из имени файла без потерь
+    return std::round((config.startTime + 1.0 + index / config.frameRate) * 1000.0) / 1000.0;
+}
+
+/**
+ * @brief Рисует кадр сегментации index (CV_8UC1).
+ */
+inline void renderFrame(const SyntheticConfig& config, const Camera& camera, std::size_t index, cv::Mat& frame) {
+    frame.create(config.height, config.width, CV_8UC1);
+    frame.setTo(cv::Scalar(0));
+
+    double x, y, yaw;
+    trackPose(config, (frameTime(config, index) - config.startTime - 1.0) * config.speed, x, y, yaw);
+    const PoseTransform toTrack(x, y, yaw, false);
+    const double halfGauge = 0.5 * config.gauge;
+    const double halfRail = 0.5 * config.railWidth;
+
+    std::vector<cv::Point2f> row(config.width);
+    const int top = static_cast<int>(config.height * config.roiTopFraction);
+    for (int r = top; r < config.height; r++) {
+        for (int c = 0; c < config.width; c++)
+            row[c] = cv::Point2f(static_cast<float>(c), static_cast<float>(r));
+        camera.projectPoints(row.data(), row.data(), row.size());
+        std::uint8_t* labels = frame.ptr<std::uint8_t>(r);
+        for (int c = 0; c < config.width; c++) {
+            // В системе камеры x — поперёк пути, y — вперёд
+            if (!(row[c].y > 0.f && row[c].y < config.maxRange))
+                continue;
+            const cv::Point2f p = toTrack.apply(row[c]);
+            const double a = lateralOffset(config, p.x, p.y) - config.trackOffset;
+            if (std::fabs(std::fabs(a) - halfGauge) < halfRail)
+                labels[c] = 1;
+            else if (std::fabs(a) < halfGauge)
+                labels[c] = 2;
+        }
+    }
+}
+
+/**
+ * @brief Записывает проезд: directory/trajectory.ext1 и directory/segmentation/<мс>.segm.png.
+ */
+inline bool writeDataset(const SyntheticConfig& config, const std::string& directory) {
+    Camera camera;
+    if (!makeCamera(config, camera))
+        return false;
+    const std::string segFolder = directory + "/segmentation";
+    std::error_code ec;
+    std::filesystem::create_directories(segFolder, ec);
+    if (ec) {
+        std::cerr << "Не удалось создать папку: " << segFolder << "\n";
+        return false;
+    }
+    if (!writeTrajectory(config, directory + "/trajectory.ext1"))
+        return false;
+
+    const std::vector<int> params = {cv::IMWRITE_PNG_COMPRESSION, 1};
+    cv::Mat frame;
+    for (std::size_t i = 0; i < frameCount(config); i++) {
+        renderFrame(config, camera, i, frame);
+        char name[64];
+        std::snprintf(name, sizeof(name), "/%lld.segm.png",
+                      static_cast<long long>(std::llround(frameTime(config, i) * 1000.0)));
+        if (!cv::imwrite(segFolder + name, frame, params)) {
+            std::cerr << "Ошибка записи кадра: " << segFolder + name << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace bench
+
+#endif // SYNTHETICDATASET_HPP
@@ -0,0 +1,136 @@
+#include "BenchUtils.hpp"
+#include "GlobalGridMapHandler.hpp"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Сравнение addPoint с пакетным addPoints (и билинейным addSplats), масштабирование
+// GlobalGridMapHandler::addPointsConcurrent от 1 до N потоков и онлайн-режим
+// (скользящее окно вдоль пути) для Dense и Sparse.
+// Заодно проверяет, что при любом числе потоков и в онлайн-режиме ни одна точка не теряется.
+int main() {
+    const int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const std::size_t framesPerThread = 200;
+    const std::size_t pointsPerFrame = 20000;
+    const float value = 6.0f;
+
+    // Кадр — полоса точек вдоль пути; кадры разных потоков попадают в одни квадранты
+    std::mt19937 rng(7);
+    std::normal_distribution<float> lateral(0.f, 3.f);
+    std::uniform_real_distribution<float> along(-150.f, 150.f);
+    std::vector<cv::Point2f> frame(pointsPerFrame);
+    for (auto& pt : frame) {
+        float s = along(rng);
+        pt = cv::Point2f(s, 0.3f * s + lateral(rng));
+    }
+    // Как в кадре: соседние точки пакета лежат рядом
+    std::sort(frame.begin(), frame.end(),
+              [](const cv::Point2f& a, const cv::Point2f& b) { return a.x < b.x; });
+
+    // Один поток: addPoint по точке против пакетного addPoints
+    {
+        GlobalGridMapHandler map(100.0, 0.1);
+        map.addPoints(frame.data(), frame.size(), 0.f);
+        const double points = static_cast<double>(framesPerThread) * pointsPerFrame;
+        double tSingle = bench::medianSeconds([&] {
+            for (std::size_t f = 0; f < framesPerThread; f++)
+                for (const cv::Point2f& pt : frame)
+                    map.addPoint(pt.x, pt.y, value);
+        }, 3);
+        bench::report("addPoint (по одной точке)", tSingle, points);
+        double tBatch = bench::medianSeconds([&] {
+            for (std::size_t f = 0; f < framesPerThread; f++)
+                map.addPoints(frame.data(), frame.size(), value);
+        }, 3);
+        bench::report("addPoints (пакет)", tBatch, points);
+        // Билинейное распределение с весом следа пикселя (PipelineConfig::splatting)
+        const std::vector<float> weights(frame.size(), 1.0f);
+        double tSplat = bench::medianSeconds([&] {
+            for (std::size_t f = 0; f < framesPerThread; f++)
+                map.addSplats(frame.data(), weights.data(), frame.size(), value);
+        }, 3);
+        bench::report("addSplats (билинейно)", tSplat, points);
+        std::printf("ускорение пакета: %.1fx, цена билинейного: %.2fx\n\n", tSingle / tBatch, tSplat / tBatch);
+    }
+
+    std::printf("%8s %12s %14s %10s\n", "потоков", "время, мс", "Mточек/с", "ускорение");
+    double base = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        GlobalGridMapHandler map(100.0, 0.1);
+        // Квадранты создаются заранее, чтобы измерять только накопление
+        map.addPointsConcurrent(frame.data(), frame.size(), 0.f);
+
+        double seconds = bench::medianSeconds([&] {
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&] {
+                    for (std::size_t f = 0; f < framesPerThread; f++)
+                        map.addPointsConcurrent(frame.data(), frame.size(), value);
+                });
+            }
+            for (auto& w : workers)
+                w.join();
+        }, 1);
+
+        const double points = static_cast<double>(threads) * framesPerThread * pointsPerFrame;
+        const double expected = points * value;
+        if (std::fabs(map.getTotal() - expected) > 1e-6 * expected) {
+            std::printf("ОШИБКА: сумма %.1f, ожидалось %.1f\n", map.getTotal(), expected);
+            return 1;
+        }
+        if (threads == 1)
+            base = points / seconds;
+        char name[64];
+        std::snprintf(name, sizeof(name), "addPointsConcurrent (%d потоков)", threads);
+        bench::record(name, seconds);
+        std::printf("%8d %12.1f %14.2f %10.2f\n", threads, seconds * 1e3,
+                    points / seconds / 1e6, points / seconds / base);
+    }
+
+    // Онлайн-режим: кадр — та же полоса, сжатая до ±15 м вокруг позы, поза идёт по пути;
+    // окно сдвигается, вышедшие полосы переносятся в квадранты в фоне
+    std::printf("\n");
+    const std::size_t pathFrames = 2000;
+    for (QuadrantStorage storage : {QuadrantStorage::Dense, QuadrantStorage::Sparse}) {
+        const char* storageName = storage == QuadrantStorage::Dense ? "Dense" : "Sparse";
+        std::vector<cv::Point2f> local(frame.size());
+        for (std::size_t k = 0; k < frame.size(); k++)
+            local[k] = frame[k] * 0.1f;
+        std::vector<cv::Point2f> points(frame.size());
+        OnlineStats online;
+        double total = 0.0;
+        double seconds = bench::medianSeconds([&] {
+            GlobalGridMapHandler map(100.0, 0.1, storage);
+            map.startOnline(0.0, 0.0);
+            for (std::size_t f = 0; f < pathFrames; f++) {
+                const cv::Point2f pose(static_cast<float>(f), 0.3f * f);
+                map.updatePose(pose.x, pose.y);
+                for (std::size_t k = 0; k < local.size(); k++)
+                    points[k] = pose + local[k];
+                map.addPoints(points.data(), points.size(), value);
+            }
+            online = map.getOnlineStats();
+            map.stopOnline();
+            total = map.getTotal();
+        }, 1);
+
+        const double count = static_cast<double>(pathFrames) * pointsPerFrame;
+        const double expected = count * value;
+        if (!(std::fabs(total - expected) <= 1e-6 * expected)) {
+            std::printf("ОШИБКА: онлайн-режим (%s): сумма %.1f, ожидалось %.1f\n", storageName, total, expected);
+            return 1;
+        }
+        char name[64];
+        std::snprintf(name, sizeof(name), "онлайн-режим (%s)", storageName);
+        bench::report(name, seconds, count);
+        std::printf("сдвигов окна: %llu, ячеек перенесено: %llu\n",
+                    static_cast<unsigned long long>(online.moves),
+                    static_cast<unsigned long long>(online.cellsFlushed));
+    }
+    return bench::finish("bench_accumulation");
+}
@@ -0,0 +1,73 @@
+#include "BenchUtils.hpp"
+#include "GlobalGridMapHandler.hpp"
+#include "SyntheticDataset.hpp"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Экспорт квадрантов: перевод слоя в изображение (renderImage) и сохранение
+// PNG (saveAllQuadrants) с разным сжатием и числом потоков. Карта — полоса
+// точек вдоль синтетического пути с кривой, как после проезда.
+int main() {
+    bench::SyntheticConfig track;
+    track.length = 1500.0;
+    track.radius = 400.0;
+
+    GlobalGridMapHandler map(100.0, 0.1, QuadrantStorage::Sparse);
+    std::mt19937 rng(11);
+    std::normal_distribution<double> lateral(0.0, 2.0);
+    std::vector<cv::Point2f> points;
+    for (double s = 0.0; s < track.length; s += 0.02) {
+        double x, y, yaw;
+        bench::trackPose(track, s, x, y, yaw);
+        const double a = lateral(rng);
+        const double rad = yaw * CV_PI / 180.0;
+        points.emplace_back(static_cast<float>(x + a * std::cos(rad)), static_cast<float>(y + a * std::sin(rad)));
+    }
+    for (int pass = 0; pass < 20; pass++)
+        map.addPoints(points.data(), points.size(), 6.0f);
+
+    std::vector<QuadrantKey> keys;
+    for (const auto& item : map.getQuadrantVersions())
+        keys.push_back(item.first);
+    const double quadrants = static_cast<double>(keys.size());
+    std::printf("квадрантов: %zu\n", keys.size());
+
+    for (ImageScale scale : {ImageScale::Linear, ImageScale::Log, ImageScale::Percentile}) {
+        ImageOptions options;
+        options.scale = scale;
+        double t = bench::medianSeconds([&] {
+            for (const QuadrantKey& key : keys) {
+                map.visitQuadrant(key, [&](const QuadrantMap& quadrant) {
+                    cv::Mat image;
+                    quadrant.renderImage("heat", options, image);
+                    bench::doNotOptimize(image.data);
+                });
+            }
+        }, 3);
+        const char* names[] = {"renderImage (linear)", "renderImage (log)", "renderImage (percentile)"};
+        bench::report(names[static_cast<int>(scale)], t, quadrants);
+    }
+
+    const std::string directory = "bench_export";
+    std::filesystem::create_directories(directory);
+    const int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int compression : {-1, 1}) {
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            ImageOptions options;
+            options.pngCompression = compression;
+            options.threads = threads;
+            double t = bench::medianSeconds([&] { map.saveAllQuadrants(directory + "/quadrant", "heat", options); }, 3);
+            char name[64];
+            std::snprintf(name, sizeof(name), "saveAllQuadrants (сжатие %d, %d потоков)", compression, threads);
+            bench::report(name, t, quadrants);
+        }
+    }
+    std::filesystem::remove_all(directory);
+    return bench::finish("bench_export");
+}
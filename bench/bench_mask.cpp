@@ -0,0 +1,71 @@
+#include "BenchUtils.hpp"
+#include "MaskExtractor.hpp"
+#include "SyntheticDataset.hpp"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Выделение пикселей классов (MaskExtractor) на синтетическом кадре сегментации:
+// одноканальный и трёхканальный кадр, одна и несколько меток, 1..N потоков.
+// Сравнивается с простым обходом пикселей через cv::Mat::at.
+int main() {
+    bench::SyntheticConfig config;
+    Camera camera;
+    if (!bench::makeCamera(config, camera))
+        return -1;
+    cv::Mat gray;
+    bench::renderFrame(config, camera, 0, gray);
+    cv::Mat color;
+    cv::Mat channels[3] = {gray, gray, gray};
+    cv::merge(channels, 3, color);
+
+    const int top = static_cast<int>(config.height * config.roiTopFraction);
+    const cv::Rect roi(0, top, config.width, config.height - top);
+    const double pixels = static_cast<double>(roi.area());
+
+    std::size_t reference = 0;
+    double tNaive = bench::medianSeconds([&] {
+        std::size_t found = 0;
+        for (int r = roi.y; r < roi.y + roi.height; r++)
+            for (int c = roi.x; c < roi.x + roi.width; c++)
+                found += gray.at<uchar>(r, c) == 1;
+        reference = found;
+        bench::doNotOptimize(found);
+    });
+    bench::report("обход cv::Mat::at (1 канал)", tNaive, pixels);
+    std::printf("пикселей рельсов: %zu\n", reference);
+
+    std::vector<MaskPixel> out;
+    MaskExtractor rails(1);
+    double tGray = bench::medianSeconds([&] { rails.extract(gray, roi, out); });
+    if (out.size() != reference) {
+        std::printf("ОШИБКА: %zu пикселей, ожидалось %zu\n", out.size(), reference);
+        return 1;
+    }
+    bench::report("extract (1 канал, 1 метка)", tGray, pixels);
+
+    double tColor = bench::medianSeconds([&] { rails.extract(color, roi, out); });
+    if (out.size() != reference) {
+        std::printf("ОШИБКА: %zu пикселей в трёхканальном кадре, ожидалось %zu\n", out.size(), reference);
+        return 1;
+    }
+    bench::report("extract (3 канала, 1 метка)", tColor, pixels);
+
+    MaskExtractor track(std::vector<std::uint8_t>{1, 2});
+    double tLabels = bench::medianSeconds([&] { track.extract(gray, roi, out); });
+    bench::report("extract (1 канал, 2 метки)", tLabels, pixels);
+
+    const int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int threads = 2; threads <= maxThreads; threads *= 2) {
+        rails.setThreads(threads);
+        double t = bench::medianSeconds([&] { rails.extract(gray, roi, out); });
+        char name[64];
+        std::snprintf(name, sizeof(name), "extract (1 канал, %d потоков)", threads);
+        bench::report(name, t, pixels);
+    }
+    std::printf("ускорение extract: %.1fx\n", tNaive / tGray);
+    return bench::finish("bench_mask");
+}
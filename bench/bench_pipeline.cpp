@@ -0,0 +1,88 @@
+#include "BenchUtils.hpp"
+#include "FramePipeline.hpp"
+#include "GlobalGridMapHandler.hpp"
+#include "SyntheticDataset.hpp"
+#include "TrajectoryReader.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Конвейер целиком на синтетическом проезде: чтение траектории, декодирование,
+// сопоставление с позой, проекция, накопление. Аргумент — папка проезда
+// (trajectory.ext1 и segmentation/, см. make_dataset); без аргумента проезд
+// генерируется в bench_dataset/ (кривая, 1280x720) и удаляется после замера.
+int main(int argc, char** argv) {
+    bench::SyntheticConfig dataset;
+    dataset.length = 150.0;
+    dataset.radius = 300.0;
+    dataset.width = 1280;
+    dataset.height = 720;
+
+    const bool generated = argc < 2;
+    const std::string directory = generated ? "bench_dataset" : argv[1];
+    if (generated) {
+        auto start = std::chrono::steady_clock::now();
+        if (!bench::writeDataset(dataset, directory))
+            return -1;
+        std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+        std::cout << "сгенерировано кадров: " << bench::frameCount(dataset) << " за " << dt.count() << " с\n";
+    }
+
+    // Камера проезда: опорные точки пересчитываются под размер первого кадра папки
+    for (const auto& entry : std::filesystem::directory_iterator(directory + "/segmentation")) {
+        cv::Mat first = cv::imread(entry.path().string(), cv::IMREAD_UNCHANGED);
+        if (first.empty())
+            continue;
+        dataset.width = first.cols;
+        dataset.height = first.rows;
+        break;
+    }
+    Camera camera;
+    if (!bench::makeCamera(dataset, camera))
+        return -1;
+
+    const int cores = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+    TrajectoryReader trajectory(directory + "/trajectory.ext1");
+    double tTrajectory = bench::medianSeconds([&] { trajectory.readExtFileMapped(cores); }, 3);
+    if (trajectory.getTrajectory().empty()) {
+        std::cerr << "Пустая траектория: " << directory << "/trajectory.ext1\n";
+        return -1;
+    }
+    bench::report("readExtFileMapped", tTrajectory, static_cast<double>(trajectory.getTrajectory().size()));
+
+    PipelineConfig config;
+    config.decodeThreads = cores / 2;
+    config.projectionThreads = cores / 2;
+    config.roiTopFraction = dataset.roiTopFraction;
+
+    std::size_t frames = 0;
+    std::uint64_t points = 0;
+    for (bool ordered : {true, false}) {
+        config.orderedAccumulation = ordered;
+        double t = bench::medianSeconds([&] {
+            GlobalGridMapHandler map(100.0, 0.1, QuadrantStorage::Sparse);
+            FramePipeline pipeline(camera, trajectory, map, config);
+            pipeline.run(directory + "/segmentation");
+            for (const StageStats& stage : pipeline.getStats())
+                if (stage.name == "decode")
+                    frames = stage.processed;
+            points = pipeline.getTotalPoints();
+        }, 3);
+        if (points == 0) {
+            std::cerr << "Конвейер не добавил ни одной точки\n";
+            return 1;
+        }
+        bench::report(ordered ? "FramePipeline (по порядку кадров)" : "FramePipeline (addPointsConcurrent)",
+                      t, static_cast<double>(frames));
+    }
+    std::cout << "кадров: " << frames << ", точек: " << points << "\n";
+
+    if (generated)
+        std::filesystem::remove_all(directory);
+    return bench::finish("bench_pipeline");
+}
@@ -0,0 +1,67 @@
+#include "BenchUtils.hpp"
+#include "Camera.hpp"
+
+#include <opencv2/core.hpp>
+#include <random>
+#include <vector>
+
+// Сравнение проекции по одной точке (projectPoint) с пакетной (projectPoints/projectMask)
+// и с выборкой из таблицы проекции (ProjectionLut)
+int main() {
+    Camera camera;
+    std::vector<cv::Point2f> imgPts = {{414.f, 540.f}, {617.f, 540.f}, {443.f, 408.f}, {557.f, 408.f}};
+    std::vector<cv::Point2f> worldPts = {{3.5f, -0.5f}, {3.5f, 1.f}, {6.1f, -0.5f}, {6.1f, 1.f}};
+    if (!camera.computeHomography(imgPts, worldPts))
+        return -1;
+
+    // Кадр 1080p, нижние 60% строк, ~20% выбранных пикселей
+    const int width = 1920;
+    const int height = 1080;
+    const cv::Rect roi(0, height / 5 * 2, width, height - height / 5 * 2);
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> coin(0, 4);
+    cv::Mat mask(height, width, CV_8UC1);
+    std::vector<cv::Point2f> pixels;
+    for (int r = 0; r < height; r++) {
+        for (int c = 0; c < width; c++) {
+            bool on = r >= roi.y && coin(rng) == 0;
+            mask.at<uchar>(r, c) = on ? 1 : 0;
+            if (on)
+                pixels.emplace_back(static_cast<float>(c), static_cast<float>(r));
+        }
+    }
+    const double n = static_cast<double>(pixels.size());
+    std::vector<cv::Point2f> out(roi.area());
+
+    double tSingle = bench::medianSeconds([&] {
+        for (size_t i = 0; i < pixels.size(); i++)
+            out[i] = camera.projectPoint(pixels[i]);
+        bench::doNotOptimize(out[0]);
+    }, 3);
+    bench::report("projectPoint (по одной точке)", tSingle, n);
+
+    double tBatch = bench::medianSeconds([&] {
+        camera.projectPoints(pixels.data(), out.data(), pixels.size());
+        bench::doNotOptimize(out[0]);
+    });
+    bench::report("projectPoints (пакет)", tBatch, n);
+
+    double tMask = bench::medianSeconds([&] {
+        size_t written = camera.projectMask(mask, roi, out.data(), out.size());
+        bench::doNotOptimize(written);
+    });
+    bench::report("projectMask (маска + ROI)", tMask, n);
+
+    if (!camera.prepareLut(mask.size(), roi))
+        return -1;
+    double tLut = bench::medianSeconds([&] {
+        size_t written = camera.projectMask(mask, roi, out.data(), out.size());
+        bench::doNotOptimize(written);
+    });
+    bench::report("projectMask (таблица проекции)", tLut, n);
+
+    std::printf("ускорение пакета: %.1fx, маски: %.1fx, таблицы: %.1fx\n",
+                tSingle / tBatch, tSingle / tMask, tSingle / tLut);
+    return bench::finish("bench_projection");
+}
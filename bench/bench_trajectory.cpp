@@ -0,0 +1,74 @@
+#include "BenchUtils.hpp"
+#include "TrajectoryReader.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+// Сравнение TrajectoryReader::readExtFile и readExtFileMapped на синтетическом
+// журнале траектории. Первый аргумент — число строк (по умолчанию 2 млн).
+int main(int argc, char** argv) {
+    const std::size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    const std::string path = "bench_trajectory.ext1";
+
+    // Журнал со служебными столбцами вокруг четырёх нужных, как в реальных .ext1
+    {
+        std::ofstream ofs(path);
+        ofs << "frame, gps.lat.deg, gps.lon.deg, time.s, speed.mps, local.x.m, local.y.m, "
+               "local.z.m, local_yaw.grad, pitch.grad, roll.grad, quality, sats\n";
+        char line[256];
+        for (std::size_t i = 0; i < rows; i++) {
+            const double t = 1600000000.0 + i * 0.01;
+            std::snprintf(line, sizeof(line),
+                          "%zu, 55.%09zu, 37.%09zu, %.3f, %.3f, %.4f, %.4f, %.3f, %.4f, %.3f, %.3f, %d, %d\n",
+                          i, i * 7 % 1000000000, i * 13 % 1000000000, t, 8.0 + std::sin(i * 1e-3),
+                          i * 0.08, 20.0 * std::sin(i * 1e-4), 150.0, std::fmod(i * 1e-3, 360.0),
+                          0.5, -0.2, 4, 12);
+            ofs << line;
+        }
+    }
+    std::printf("строк: %zu\n", rows);
+
+    std::size_t reference = 0;
+    double tBase = bench::medianSeconds([&] {
+        TrajectoryReader reader(path);
+        reader.readExtFile();
+        reference = reader.getTrajectory().size();
+    }, 3);
+    bench::report("readExtFile (getline + stod)", tBase, static_cast<double>(rows));
+
+    const int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        TrajectoryReader check(path);
+        check.readExtFileMapped(threads);
+        TrajectoryReader base(path);
+        base.readExtFile();
+        if (check.getTrajectory().size() != reference) {
+            std::printf("ОШИБКА: %zu точек, ожидалось %zu\n", check.getTrajectory().size(), reference);
+            return 1;
+        }
+        for (std::size_t i = 0; i < reference; i++) {
+            const TrajectoryPoint& a = base.getTrajectory()[i];
+            const TrajectoryPoint& b = check.getTrajectory()[i];
+            if (a.time != b.time || a.x != b.x || a.y != b.y || a.yaw != b.yaw) {
+                std::printf("ОШИБКА: точка %zu отличается\n", i);
+                return 1;
+            }
+        }
+
+        double t = bench::medianSeconds([&] {
+            TrajectoryReader reader(path);
+            reader.readExtFileMapped(threads);
+            bench::doNotOptimize(reader.getTrajectory().size());
+        }, 5);
+        char name[64];
+        std::snprintf(name, sizeof(name), "readExtFileMapped (%d потоков)", threads);
+        bench::report(name, t, static_cast<double>(rows));
+        std::printf("ускорение: %.1fx\n", tBase / t);
+    }
+    std::remove(path.c_str());
+    return bench::finish("bench_trajectory");
+}
@@ -0,0 +1,52 @@
+#include "SyntheticDataset.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Генератор синтетического проезда для бенчмарков и отладки конвейера:
+//   make_dataset <папка> [--length м] [--radius м] [--width пикс] [--height пикс]
+//                [--fps Гц] [--speed м/с]
+// Пишет <папка>/trajectory.ext1 и <папка>/segmentation/<мс>.segm.png.
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Использование: " << argv[0]
+                  << " <папка> [--length м] [--radius м] [--width пикс] [--height пикс] [--fps Гц] [--speed м/с]\n";
+        return -1;
+    }
+    bench::SyntheticConfig config;
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc) {
+            std::cerr << "Нет значения параметра: " << argv[i] << "\n";
+            return -1;
+        }
+        const char* name = argv[i];
+        const double value = std::atof(argv[++i]);
+        if (std::strcmp(name, "--length") == 0)
+            config.length = value;
+        else if (std::strcmp(name, "--radius") == 0)
+            config.radius = value;
+        else if (std::strcmp(name, "--width") == 0)
+            config.width = static_cast<int>(value);
+        else if (std::strcmp(name, "--height") == 0)
+            config.height = static_cast<int>(value);
+        else if (std::strcmp(name, "--fps") == 0)
+            config.frameRate = value;
+        else if (std::strcmp(name, "--speed") == 0)
+            config.speed = value;
+        else {
+            std::cerr << "Неизвестный параметр: " << name << "\n";
+            return -1;
+        }
+    }
+    if (config.length <= 0.0 || config.speed <= 0.0 || config.frameRate <= 0.0 ||
+        config.width <= 0 || config.height <= 0) {
+        std::cerr << "Длина, скорость, частота и размер кадра должны быть положительными\n";
+        return -1;
+    }
+    if (!bench::writeDataset(config, argv[1]))
+        return -1;
+    std::cout << "Кадров: " << bench::frameCount(config) << ", папка: " << argv[1] << std::endl;
+    return 0;
+}
@@ -0,0 +1,157 @@
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief Ограниченная неблокирующая очередь MPMC (схема Д. Вьюкова).
+ *
+ * tryPush/tryPop не используют блокировок. push/pop ждут места или
+ * элемента, уступая процессор, и возвращают false после close(),
+ * когда ждать больше нечего.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * @param capacity Ёмкость (округляется вверх до степени двойки)
+     */
+    explicit BoundedQueue(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask_ = size - 1;
+        cells_ = std::make_unique<Cell[]>(size);
+        for (std::size_t i = 0; i < size; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Пытается добавить элемент, не ожидая.
+     * @return false, если очередь заполнена
+     */
+    bool tryPush(T& value) {
+        std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Пытается извлечь элемент, не ожидая.
+     * @return false, если очередь пуста
+     */
+    bool tryPop(T& value) {
+        std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Добавляет элемент, ожидая свободного места.
+     * @return false, если очередь закрыта
+     */
+    bool push(T value) {
+        for (int spins = 0; !closed_.load(std::memory_order_acquire); spins++) {
+            if (tryPush(value))
+                return true;
+            backoff(spins);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Извлекает элемент, ожидая его появления.
+     * @return false, если очередь закрыта и пуста
+     */
+    bool pop(T& value) {
+        for (int spins = 0;; spins++) {
+            if (tryPop(value))
+                return true;
+            if (closed_.load(std::memory_order_acquire))
+                return tryPop(value);
+            backoff(spins);
+        }
+    }
+
+    /**
+     * @brief Закрывает очередь: новые элементы не принимаются,
+     *        оставшиеся ещё можно извлечь.
+     */
+    void close() { closed_.store(true, std::memory_order_release); }
+
+    /**
+     * @brief Снова открывает закрытую очередь. Только когда ни один поток
+     *        не вызывает push/pop (например, между прогонами конвейера).
+     */
+    void reopen() { closed_.store(false, std::memory_order_release); }
+
+    bool isClosed() const { return closed_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Приблизительное число элементов в очереди.
+     */
+    std::size_t size() const {
+        std::size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+        std::size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static void backoff(int spins) {
+        if (spins < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_ = 0;
+    alignas(64) std::atomic<std::size_t> enqueuePos_{0};
+    alignas(64) std::atomic<std::size_t> dequeuePos_{0};
+    alignas(64) std::atomic<bool> closed_{false};
+};
+
+#endif // BOUNDEDQUEUE_HPP
@@ -2,8 +2,13 @@
 #define CAMERA_HPP
 
 #include <opencv2/core.hpp>
+#include <cstddef>
+#include <memory>
+#include <string>
 #include <vector>
 
+class ProjectionLut;
+
 /**
  * @brief Класс для работы с гомографией.
  *
@@ -41,13 +46,77 @@ public:
      */
     cv::Point2f projectPoint(const cv::Point2f& imagePoint) const;
 
+    /**
+     * @brief Пакетно проецирует массив точек изображения в мировую систему (z = 0).
+     *
+     * Не выделяет память, использует SIMD (см. Simd.hpp).
+     * src и dst могут совпадать.
+     * @param src Точки в системе изображения
+     * @param dst Буфер вызывающей стороны не менее чем на count точек
+     * @param count Количество точек
+     */
+    void projectPoints(const cv::Point2f* src, cv::Point2f* dst, std::size_t count) const;
+
+    /**
+     * @brief Проецирует все ненулевые пиксели маски внутри ROI.
+     *
+     * Пиксели обходятся построчно слева направо, результат записывается
+     * в буфер вызывающей стороны без выделения памяти. Если подготовлена
+     * таблица проекции для того же кадра и ROI, используется она.
+     * @param mask Маска CV_8UC1 (ненулевые пиксели проецируются)
+     * @param roi Область маски, которую нужно обработать
+     * @param dst Буфер для мировых точек
+     * @param capacity Размер буфера dst (достаточно roi.area())
+     * @return Количество записанных точек
+     */
+    std::size_t projectMask(const cv::Mat& mask, const cv::Rect& roi,
+                            cv::Point2f* dst, std::size_t capacity) const;
+
+    /**
+     * @brief Проецирует углы ROI на плоскость земли — след кадра в системе камеры.
+     *
+     * Гомография переводит прямые в прямые, поэтому след прямоугольной ROI —
+     * четырёхугольник с вершинами в проекциях её угловых пикселей. Если ROI
+     * достаёт до горизонта или дальше maxRange, её верхние углы опускаются
+     * по своим столбцам до последнего пикселя, видимого на земле в пределах
+     * maxRange от камеры, и след обрезается, а не отбрасывается.
+     * @param roi Область кадра
+     * @param footprint Четыре вершины следа в порядке обхода углов ROI
+     * @param maxRange Дальность следа от камеры в метрах (0 — только до горизонта)
+     * @return false, если нижние углы ROI не видны на земле в пределах дальности
+     */
+    bool projectFootprint(const cv::Rect& roi, cv::Point2f footprint[4], float maxRange = 0.0f) const;
+
+    /**
+     * @brief Подготавливает таблицу проекции (см. ProjectionLut) для кадра и ROI.
+     *
+     * Если cacheFile содержит таблицу для текущей гомографии, кадра и ROI,
+     * она отображается в память; иначе таблица строится и сохраняется в cacheFile.
+     * @param imageSize Размер кадра
+     * @param roi Область кадра
+     * @param cacheFile Файл кэша таблицы (пустая строка — не сохранять)
+     * @return true, если таблица готова
+     */
+    bool prepareLut(const cv::Size& imageSize, const cv::Rect& roi,
+                    const std::string& cacheFile = "");
+
+    /**
+     * @brief Текущая таблица проекции или nullptr
+     */
+    const ProjectionLut* getLut() const { return lut_.get(); }
+
     /**
      * @brief Возвращает копию текущей гомографии
      */
     cv::Mat getHomography() const { return homography_.clone(); }
 
 private:
+    // Копирует гомографию в hf_ для пакетной проекции
+    void cacheCoefficients();
+
     cv::Mat homography_; // матрица гомографии (image -> world)
+    float hf_[9];        // та же гомография в float, построчно
+    std::shared_ptr<const ProjectionLut> lut_; // таблица проекции (необязательна)
 };
 
 #endif // CAMERA_HPP
@@ -0,0 +1,71 @@
+#ifndef CAMERARIG_HPP
+#define CAMERARIG_HPP
+
+#include "Camera.hpp"
+#include "TrajectoryReader.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <string>
+
+/**
+ * @brief Установка камеры на вагоне относительно позы траектории.
+ *
+ * Смещение задано в системе камеры с нулевым поворотом (x — поперёк пути,
+ * y — вперёд, метры), поворот — в тех же единицах и направлении, что yaw
+ * траектории (градусы). Передняя камера, по которой снята траектория, —
+ * нулевая установка; задняя — yaw = 180.
+ */
+struct CameraMount
+{
+    double x = 0.0;   ///< Смещение поперёк оси вагона (м)
+    double y = 0.0;   ///< Смещение вдоль оси вагона (м)
+    double yaw = 0.0; ///< Поворот оси камеры относительно оси вагона (градусы)
+};
+
+/**
+ * @brief Камера установки вместе с её креплением и источником кадров.
+ */
+struct RigCamera
+{
+    std::string name;         ///< Имя для журнала ("front", "rear", ...)
+    Camera camera;            ///< Камера с вычисленной гомографией
+    CameraMount mount;        ///< Установка на вагоне
+    std::string segFolder;    ///< Папка кадров сегментации этой камеры
+    std::string lutCacheFile; ///< Файл кэша таблицы проекции (пусто — без кэша)
+};
+
+/**
+ * @brief Набор камер вагона, кадры которых накапливаются в одну карту.
+ *
+ * FramePipeline обрабатывает кадры всех камер за один проход: траектория
+ * читается один раз, кадры разных камер идут вперемешку в порядке времени,
+ * поэтому квадранты, которые видят соседние камеры, остаются горячими.
+ * Ссылки на камеры установки не меняются при добавлении новых.
+ */
+class CameraRig
+{
+public:
+    /**
+     * @brief Добавляет камеру в установку.
+     * @return Номер камеры в установке
+     */
+    std::size_t addCamera(const std::string& name, const Camera& camera, const CameraMount& mount,
+                          const std::string& segFolder, const std::string& lutCacheFile = std::string());
+
+    std::size_t size() const { return cameras_.size(); }
+    bool empty() const { return cameras_.empty(); }
+
+    RigCamera& operator[](std::size_t index) { return cameras_[index]; }
+    const RigCamera& operator[](std::size_t index) const { return cameras_[index]; }
+
+    /**
+     * @brief Поза камеры по позе вагона: установка поворачивается на yaw вагона и прибавляется к нему.
+     */
+    static TrajectoryPoint cameraPose(const TrajectoryPoint& pose, const CameraMount& mount);
+
+private:
+    std::deque<RigCamera> cameras_;
+};
+
+#endif // CAMERARIG_HPP
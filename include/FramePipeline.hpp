@@ -0,0 +1,298 @@
+#ifndef FRAMEPIPELINE_HPP
+#define FRAMEPIPELINE_HPP
+
+#include "BoundedQueue.hpp"
+#include "Camera.hpp"
+#include "CameraRig.hpp"
+#include "FrameScheduler.hpp"
+#include "FrameSource.hpp"
+#include "FrameStream.hpp"
+#include "GlobalGridMapHandler.hpp"
+#include "MaskExtractor.hpp"
+#include "TrajectoryReader.hpp"
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Параметры конвейера обработки кадров.
+ */
+struct PipelineConfig
+{
+    int decodeThreads = 4;          ///< Потоки декодирования изображений
+    int poseThreads = 1;            ///< Потоки сопоставления кадра с траекторией
+    int projectionThreads = 4;      ///< Потоки проекции пикселей
+    std::size_t queueCapacity = 64; ///< Ёмкость каждой очереди между стадиями
+    double roiTopFraction = 0.4;    ///< Доля верхних строк кадра, которые не обрабатываются
+    float pointValue = 6.0f;        ///< Приращение карты на один пиксель
+    /// Метки классов сегментации, попадающих в карту. Для карты со слоями по меткам
+    /// должны совпадать с MapLayers::heatLabels, иначе run() возвращает false
+    std::vector<std::uint8_t> labels{1};
+    FrameDecode frameDecode = FrameDecode::Unchanged; ///< Декодирование кадров сегментации
+    bool mirrorX = true;            ///< Зеркалить точки относительно OY
+    /// true — поза интерполируется на время кадра; false — берётся
+    /// ближайший отсчёт траектории не раньше кадра
+    bool interpolatePose = true;
+    std::string lutCacheFile;       ///< Файл кэша таблицы проекции (пусто — без кэша)
+    bool logFrames = false;         ///< Печатать путь и позу каждого кадра в std::clog
+    /// true — точки добавляются в карту одним потоком строго по порядку кадров
+    /// (побитово детерминированный результат); false — потоками проекции
+    /// через GlobalGridMapHandler::addPointsConcurrent (масштабируется по ядрам)
+    bool orderedAccumulation = true;
+    /// true — точка делится между четырьмя ячейками (GlobalGridMapHandler::addSplats)
+    /// с весом, равным площади следа пикселя в ячейках: pointValue — приращение
+    /// ячейки, целиком покрытой пикселями класса. Только для карты без слоёв по меткам
+    /// (MapLayers::needsLabels), иначе run() возвращает false
+    bool splatting = false;
+    float maxSplatCells = 16.0f;    ///< Предел веса пикселя (в ячейках) у горизонта
+    /// Дальность следа кадра для слоя occupancy (м): дальше неё и у горизонта
+    /// след обрезается (Camera::projectFootprint), 0 — только по горизонту
+    double footprintRange = 50.0;
+    /// Потоковый режим: кадр отдаётся в обработку, когда пришёл кадр новее него
+    /// на reorderWindow секунд или когда он, самый ранний из ждущих, прождал reorderWindow секунд
+    double reorderWindow = 0.5;
+    std::size_t reorderCapacity = 256; ///< Потоковый режим: максимум кадров, ждущих переупорядочивания
+    double streamIdleTimeout = 0.0; ///< Потоковый режим: завершиться, если кадров нет столько секунд (0 — ждать)
+    double poseTimeout = 2.0;       ///< Потоковая траектория: сколько ждать позу на время кадра (сек)
+    /// Отбор кадров по движению вагона: пропущенные кадры не декодируются,
+    /// вклад взятых умножается на их вес (MotionPolicy::Weight)
+    MotionSchedule motion;
+    /// Не добавлять в карту кадр, маска которого почти совпала с маской последнего
+    /// добавленного кадра той же камеры (MaskSignature). Только при orderedAccumulation
+    bool cullRepeatedMasks = false;
+    double repeatedMaskTolerance = 0.02; ///< Доля пикселей, на которую может отличаться повторная маска
+};
+
+/**
+ * @brief Счётчики одной стадии конвейера.
+ */
+struct StageStats
+{
+    std::string name;           ///< Имя стадии
+    std::size_t queueDepth;     ///< Текущая глубина входной очереди
+    std::size_t maxQueueDepth;  ///< Максимальная наблюдавшаяся глубина входной очереди
+    std::uint64_t processed;    ///< Обработано кадров
+    double totalSeconds;        ///< Суммарное время работы над кадрами (по всем потокам)
+    double maxSeconds;          ///< Максимальная задержка обработки одного кадра
+};
+
+/**
+ * @brief Счётчики отбора кадров (PipelineConfig::motion, cullRepeatedMasks).
+ */
+struct ScheduleStats
+{
+    std::uint64_t framesSkipped;  ///< Кадров пропущено по движению (не декодировались)
+    std::uint64_t framesWeighted; ///< Кадров с уменьшенным вкладом
+    std::uint64_t framesCulled;   ///< Кадров с повторной маской: спроецированы, но не добавлены
+    std::uint64_t pixelsSkipped;  ///< Пикселей ROI пропущенных кадров (по среднему ROI обработанных)
+    std::uint64_t pointsCulled;   ///< Точек повторных масок, не добавленных в карту
+};
+
+/**
+ * @brief Многопоточный конвейер: сканирование папки -> декодирование ->
+ *        сопоставление с траекторией -> проекция -> накопление в карте.
+ *
+ * Стадии связаны ограниченными неблокирующими очередями, число потоков
+ * каждой стадии настраивается. Кадры нумеруются при сканировании, и стадия
+ * накопления применяет их строго по порядку номеров, поэтому результат не
+ * зависит от чередования потоков. При orderedAccumulation = false точки
+ * добавляются в карту прямо из потоков проекции.
+ *
+ * В потоковом режиме (run(FrameStream&)) вместо сканирования папки кадры
+ * берутся из FrameStream по мере поступления и переупорядочиваются по
+ * времени в окне PipelineConfig::reorderWindow, а позы можно брать из
+ * TrajectoryStream, который дочитывается во время работы.
+ *
+ * С установкой из нескольких камер (CameraRig) кадры всех камер сливаются
+ * в один поток по времени и делят траекторию, очереди и карту; поза кадра —
+ * поза вагона с учётом установки его камеры.
+ *
+ * run() можно вызывать повторно (не одновременно): счётчики и состояние
+ * планировщика кадров продолжаются с прошлого прогона.
+ */
+class FramePipeline
+{
+public:
+    /**
+     * @param camera Камера с вычисленной гомографией
+     * @param trajectory Загруженная траектория
+     * @param map Глобальная карта, в которую накапливаются точки
+     * @param config Параметры конвейера
+     */
+    FramePipeline(Camera& camera, const TrajectoryReader& trajectory,
+                  GlobalGridMapHandler& map, const PipelineConfig& config = PipelineConfig());
+
+    /**
+     * @param camera Камера с вычисленной гомографией
+     * @param trajectory Запущенная потоковая траектория: позы ждутся не дольше PipelineConfig::poseTimeout
+     * @param map Глобальная карта, в которую накапливаются точки
+     * @param config Параметры конвейера
+     */
+    FramePipeline(Camera& camera, TrajectoryStream& trajectory,
+                  GlobalGridMapHandler& map, const PipelineConfig& config = PipelineConfig());
+
+    /**
+     * @param rig Установка камер (должна жить дольше конвейера); PipelineConfig::lutCacheFile
+     *        не используется — у каждой камеры свой файл кэша
+     * @param trajectory Загруженная траектория вагона
+     * @param map Глобальная карта, в которую накапливаются точки
+     * @param config Параметры конвейера
+     */
+    FramePipeline(CameraRig& rig, const TrajectoryReader& trajectory,
+                  GlobalGridMapHandler& map, const PipelineConfig& config = PipelineConfig());
+
+    /**
+     * @param rig Установка камер (должна жить дольше конвейера)
+     * @param trajectory Запущенная потоковая траектория вагона
+     * @param map Глобальная карта, в которую накапливаются точки
+     * @param config Параметры конвейера
+     */
+    FramePipeline(CameraRig& rig, TrajectoryStream& trajectory,
+                  GlobalGridMapHandler& map, const PipelineConfig& config = PipelineConfig());
+    ~FramePipeline();
+
+    /**
+     * @brief Обрабатывает все файлы папки (блокирующий вызов, только для одной камеры).
+     * @param segFolder Папка с кадрами сегментации
+     * @return true, если папку удалось прочитать и конфигурация совместима со слоями карты
+     */
+    bool run(const std::string& segFolder);
+
+    /**
+     * @brief Обрабатывает папки кадров всех камер установки (блокирующий вызов).
+     * @return true, если все папки удалось прочитать и конфигурация совместима со слоями карты
+     */
+    bool run();
+
+    /**
+     * @brief Обрабатывает кадры по мере поступления (блокирующий вызов).
+     *
+     * Возвращается, когда источник закончился, закрыт (FrameStream::close)
+     * или молчал PipelineConfig::streamIdleTimeout секунд. Кадр, пришедший
+     * позже уже обработанных больше чем на reorderWindow, пропускается.
+     * Камера кадра установки определяется по папке файла (RigCamera::segFolder).
+     * @param stream Открытый источник кадров
+     * @return false, если конфигурация несовместима со слоями карты
+     */
+    bool run(FrameStream& stream);
+
+    /**
+     * @brief Снимок счётчиков всех стадий (можно вызывать во время run()).
+     */
+    std::vector<StageStats> getStats() const;
+
+    /**
+     * @brief Счётчики отбора кадров (можно вызывать во время run()).
+     */
+    ScheduleStats getScheduleStats() const;
+
+    /**
+     * @brief Печатает счётчики стадий в виде таблицы.
+     */
+    void printStats(std::ostream& os) const;
+
+    /**
+     * @brief Общее число ярких пикселей, добавленных в карту.
+     */
+    std::uint64_t getTotalPoints() const { return totalPoints_.load(); }
+
+    /**
+     * @brief Извлекает время кадра (сек) из имени файла вида "16363.segm.png" (мс).
+     */
+    static double extractTimestamp(const std::string& filename);
+
+private:
+    struct Frame;
+    using FramePtr = std::unique_ptr<Frame>;
+
+    struct Stage {
+        std::string name;
+        std::atomic<std::uint64_t> processed{0};
+        std::atomic<std::uint64_t> totalNs{0};
+        std::atomic<std::uint64_t> maxNs{0};
+        std::atomic<std::size_t> maxDepth{0};
+        std::atomic<int> activeWorkers{0};
+    };
+
+    enum StageId { SCAN = 0, DECODE, POSE, PROJECT, ACCUMULATE, STAGE_COUNT };
+
+    // Камера, чьи кадры обрабатывает конвейер
+    struct View {
+        Camera* camera;
+        CameraMount mount;
+        std::string segFolder;    // нормализованный путь папки (пусто — не задана)
+        std::string lutCacheFile;
+    };
+
+    // Общая часть конструкторов (траекторию задаёт вызывающий)
+    FramePipeline(std::vector<View> views, GlobalGridMapHandler& map, const PipelineConfig& config);
+
+    static std::vector<View> rigViews(CameraRig& rig);
+    // Камера кадра по папке файла; -1 — папка не принадлежит ни одной камере
+    int viewOf(const std::string& path) const;
+
+    // Запускает стадии; producer наполняет decodeQueue_ и закрывает её
+    // Метки и splatting конфигурации согласованы со слоями карты (сообщает об ошибке)
+    bool checkLayers() const;
+    void runStages(const std::function<void()>& producer);
+    // Сканирует папки камер (номер камеры, папка) и отдаёт кадры в порядке времени
+    void scanStage(const std::vector<std::pair<std::size_t, std::string>>& folders);
+    void streamStage(FrameStream& stream);
+    void decodeWorker();
+    void poseWorker();
+    void projectionWorker();
+    void accumulateStage();
+
+    // Решение планировщика по кадру; false — кадр пропускается
+    bool scheduleFrame(Frame& frame, TrajectoryReader::Cursor* cursor);
+    // Поза вагона на время кадра из загруженной или потоковой траектории
+    bool lookupPose(double time, TrajectoryPoint& pose, TrajectoryReader::Cursor* cursor) const;
+    void decodeFrame(Frame& frame);
+    void associatePose(Frame& frame, TrajectoryReader::Cursor* cursor);
+    void projectFrame(Frame& frame);
+    void accumulateFrame(Frame& frame);
+    void accumulateConcurrent(Frame& frame);
+
+    // Учитывает время обработки кадра стадией
+    void record(StageId id, std::uint64_t ns);
+    // Учитывает глубину входной очереди стадии
+    void observeDepth(StageId id, std::size_t depth);
+    // Передаёт кадр дальше; последний завершившийся поток стадии закрывает очередь
+    void finishWorker(StageId id, BoundedQueue<FramePtr>& out);
+
+    std::vector<View> views_;
+    const TrajectoryReader* trajectory_ = nullptr; // ровно одна из двух траекторий
+    TrajectoryStream* poseStream_ = nullptr;
+    GlobalGridMapHandler& map_;
+    PipelineConfig config_;
+    FrameSource frameSource_;
+    MaskExtractor extractor_;
+    FrameScheduler scheduler_;                  // вызывается только стадией сканирования
+    std::vector<MaskSignature> lastSignature_;  // последняя добавленная маска камеры (стадия накопления)
+    std::vector<bool> hasSignature_;
+
+    // Входные очереди стадий (у сканирования входной очереди нет)
+    BoundedQueue<FramePtr> decodeQueue_;
+    BoundedQueue<FramePtr> poseQueue_;
+    BoundedQueue<FramePtr> projectQueue_;
+    BoundedQueue<FramePtr> accumulateQueue_;
+
+    Stage stages_[STAGE_COUNT];
+    std::shared_mutex lutMutex_; // защищает подготовку таблиц проекции камер
+    std::atomic<std::uint64_t> totalPoints_{0};
+    std::atomic<std::uint64_t> framesSkipped_{0};
+    std::atomic<std::uint64_t> framesWeighted_{0};
+    std::atomic<std::uint64_t> framesCulled_{0};
+    std::atomic<std::uint64_t> pointsCulled_{0};
+    std::atomic<std::uint64_t> projectedFrames_{0};
+    std::atomic<std::uint64_t> projectedPixels_{0}; // пиксели ROI спроецированных кадров
+};
+
+#endif // FRAMEPIPELINE_HPP
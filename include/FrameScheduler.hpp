@@ -0,0 +1,103 @@
+#ifndef FRAMESCHEDULER_HPP
+#define FRAMESCHEDULER_HPP
+
+#include "MaskExtractor.hpp"
+#include "TrajectoryReader.hpp"
+
+#include <opencv2/core.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Что делать с кадрами, снятыми почти с той же позы (вагон стоит).
+ */
+enum class MotionPolicy
+{
+    Keep,  ///< Обрабатывать все кадры
+    Skip,  ///< Пропускать кадры, пока вагон не сдвинется на порог от последнего взятого кадра
+    Weight ///< Вклад кадра пропорционален сдвигу от последнего взятого кадра (не больше 1)
+};
+
+/**
+ * @brief Пороги отбора кадров по движению.
+ */
+struct MotionSchedule
+{
+    MotionPolicy policy = MotionPolicy::Keep;
+    double minDistance = 0.5;  ///< Сдвиг, при котором кадр берётся полностью (м)
+    double minYaw = 1.0;       ///< Поворот, при котором кадр берётся полностью (градусы)
+    double maxInterval = 0.0;  ///< Skip: брать кадр не реже чем раз в столько секунд (0 — без ограничения)
+    /// Weight: кадры с меньшим весом пропускаются, их сдвиг переходит к следующему кадру
+    double minWeight = 0.1;
+};
+
+/**
+ * @brief Сигнатура маски: число пикселей классов в ячейках сетки 8x8 поверх ROI.
+ *
+ * Дешёвая замена сравнению масок целиком: кадры стоящего вагона дают почти
+ * одинаковые сигнатуры даже при шуме сегментации, в отличие от точного хэша.
+ */
+struct MaskSignature
+{
+    static constexpr int GRID = 8;
+    std::array<std::uint32_t, GRID * GRID> counts{};
+    std::uint64_t total = 0;
+
+    /**
+     * @brief Строит сигнатуру по пикселям, найденным MaskExtractor
+     */
+    void build(const std::vector<MaskPixel>& pixels, const cv::Rect& roi);
+
+    /**
+     * @brief Учитывает один пиксель класса (для построения по строкам)
+     */
+    void add(int row, int col, const cv::Rect& roi) {
+        const int gy = (row - roi.y) * GRID / roi.height;
+        const int gx = (col - roi.x) * GRID / roi.width;
+        counts[gy * GRID + gx]++;
+        total++;
+    }
+
+    /**
+     * @brief true, если маски отличаются не больше чем на долю tolerance пикселей
+     */
+    bool similar(const MaskSignature& other, double tolerance) const;
+};
+
+/**
+ * @brief Отбор кадров по движению вагона, до декодирования.
+ *
+ * Кадры подаются в порядке времени; для каждой камеры помнится свой
+ * предыдущий кадр, поэтому кадры разных камер с одним временем не
+ * вытесняют друг друга. Не потокобезопасен: вызывается из одной стадии.
+ */
+class FrameScheduler
+{
+public:
+    explicit FrameScheduler(const MotionSchedule& schedule = MotionSchedule());
+
+    /**
+     * @brief Нужны ли позы кадров (MotionPolicy::Keep — нет)
+     */
+    bool active() const { return schedule_.policy != MotionPolicy::Keep; }
+
+    /**
+     * @brief Решение по очередному кадру камеры view.
+     * @return Вес кадра: 0 — пропустить, 1 — обработать полностью, между ними — уменьшенный вклад
+     */
+    float admit(std::size_t view, double timestamp, const TrajectoryPoint& pose);
+
+private:
+    struct Last {
+        bool valid = false;
+        double time = 0.0;
+        TrajectoryPoint pose{};
+    };
+
+    MotionSchedule schedule_;
+    std::vector<Last> last_; // последний взятый кадр каждой камеры
+};
+
+#endif // FRAMESCHEDULER_HPP
@@ -0,0 +1,97 @@
+#ifndef FRAMESOURCE_HPP
+#define FRAMESOURCE_HPP
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Как декодировать изображение сегментации
+ */
+enum class FrameDecode
+{
+    Unchanged, ///< как записано в файле: серый PNG даёт сразу один канал
+    Grayscale, ///< всегда один канал; точно для меток, записанных равными каналами
+    Color      ///< BGR, три канала (исходное поведение)
+};
+
+/**
+ * @brief Пул буферов кадров для повторного использования.
+ *
+ * Кадры одного потока обычно одного размера, поэтому буфер, возвращённый
+ * в пул, при следующем декодировании используется без выделения памяти.
+ * Потокобезопасен.
+ */
+class FrameBufferPool {
+public:
+    /**
+     * @param capacity Сколько свободных буферов хранить (лишние освобождаются)
+     */
+    explicit FrameBufferPool(std::size_t capacity = 64) : capacity_(capacity) {}
+
+    /**
+     * @brief Свободный буфер (пустой cv::Mat, если пул пуст)
+     */
+    cv::Mat acquire();
+
+    /**
+     * @brief Возвращает буфер в пул; frame становится пустым.
+     *
+     * Буфер не должен использоваться где-то ещё (другие cv::Mat на те же данные).
+     */
+    void release(cv::Mat& frame);
+
+private:
+    std::size_t capacity_;
+    std::mutex mutex_;
+    std::vector<cv::Mat> free_;
+};
+
+/**
+ * @brief Источник кадров сегментации: читает файл и декодирует метки
+ *        в буфер из пула.
+ *
+ * Изображения (PNG и др.) декодируются cv::imdecode прямо в буфер пула.
+ * Файлы с расширением RAW_EXTENSION — сырые метки (заголовок и W*H байт) —
+ * читаются в буфер без декодирования. 16-битные метки приводятся к 8 битам.
+ * decode можно вызывать из нескольких потоков.
+ */
+class FrameSource {
+public:
+    static constexpr const char* RAW_EXTENSION = ".lbl";
+
+    /**
+     * @param mode Режим декодирования изображений
+     * @param poolCapacity Ёмкость пула буферов
+     */
+    explicit FrameSource(FrameDecode mode = FrameDecode::Unchanged, std::size_t poolCapacity = 64);
+
+    /**
+     * @brief Читает кадр.
+     * @param path Путь к файлу
+     * @param frame Результат: CV_8UC1 (или CV_8UC3 в режимах Color/Unchanged для цветных файлов)
+     * @return true, если успешно
+     */
+    bool decode(const std::string& path, cv::Mat& frame);
+
+    /**
+     * @brief Возвращает буфер обработанного кадра в пул
+     */
+    void recycle(cv::Mat& frame) { pool_.release(frame); }
+
+    /**
+     * @brief Сохраняет одноканальные метки в сыром формате
+     * @return true, если успешно
+     */
+    static bool writeRaw(const std::string& path, const cv::Mat& labels);
+
+private:
+    bool readRaw(const std::string& path, cv::Mat& frame);
+
+    FrameDecode mode_;
+    FrameBufferPool pool_;
+};
+
+#endif // FRAMESOURCE_HPP
@@ -0,0 +1,89 @@
+#ifndef FRAMESTREAM_HPP
+#define FRAMESTREAM_HPP
+
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <string>
+
+/**
+ * @brief Источник кадров, поступающих во время работы (потоковый режим FramePipeline).
+ *
+ * Источник — одно из двух:
+ *  - папка, за которой следит inotify: кадр — файл, закрытый после записи
+ *    или перемещённый в папку (запись во временный файл и rename);
+ *  - список путей: файл или именованный канал (FIFO), по пути кадра в строке.
+ *    Дописанные в файл строки подхватываются; FIFO заканчивается, когда его
+ *    закроют все писатели.
+ * Кадры выдаются в порядке поступления; файлы, уже лежавшие в папке, — до новых,
+ * по времени из имени (как FramePipeline::extractTimestamp).
+ * next() вызывается из одного потока; close() — из любого.
+ */
+class FrameStream
+{
+public:
+    /**
+     * @brief Результат next()
+     */
+    enum class Status
+    {
+        Ready,   ///< путь кадра записан в path
+        Timeout, ///< за отведённое время кадров не поступило
+        End      ///< источник закончился или закрыт
+    };
+
+    FrameStream() = default;
+    ~FrameStream();
+
+    FrameStream(const FrameStream&) = delete;
+    FrameStream& operator=(const FrameStream&) = delete;
+
+    /**
+     * @brief Следит за появлением кадров в папке.
+     * @param directory Папка кадров
+     * @param suffix Учитываются только имена с этим окончанием (пусто — все файлы)
+     * @param includeExisting Выдать сначала файлы, уже лежащие в папке (по времени из имени)
+     * @return false, если за папкой не удалось установить наблюдение
+     */
+    bool watchDirectory(const std::string& directory, const std::string& suffix = std::string(),
+                        bool includeExisting = false);
+
+    /**
+     * @brief Читает пути кадров построчно из файла или FIFO.
+     * @return false, если источник не удалось открыть
+     */
+    bool openPathList(const std::string& path);
+
+    /**
+     * @brief Ждёт следующий кадр не дольше timeout секунд.
+     */
+    Status next(std::string& path, double timeout);
+
+    /**
+     * @brief Закрывает источник: текущий и последующие next() возвращают End.
+     */
+    void close() { closed_ = true; }
+
+private:
+    enum class Kind { None, Directory, PathList };
+
+    // Читает доступные события или строки в ready_; false — источник закончился
+    bool readSource();
+    // Следующий из уже лежавших в папке файлов; false — список исчерпан
+    bool nextExisting(std::string& path);
+    bool accepts(const std::string& name) const;
+
+    Kind kind_ = Kind::None;
+    int fd_ = -1;
+    bool fifo_ = false;
+    bool ended_ = false;
+    std::string directory_;
+    std::string suffix_;
+    std::deque<std::string> existing_; // ещё не выданные файлы папки, по времени
+    std::filesystem::file_time_type watchStart_;
+    std::deque<std::string> ready_;  // разобранные, но не выданные пути
+    std::string partial_;            // неполная последняя строка списка путей
+    std::atomic<bool> closed_{false};
+};
+
+#endif // FRAMESTREAM_HPP
@@ -1,21 +1,131 @@
 #ifndef GLOBALGRIDMAPHANDLER_HPP
 #define GLOBALGRIDMAPHANDLER_HPP
 
+#include "MappedFile.hpp"
 #include "QuadrantMap.hpp"
+#include <opencv2/core.hpp>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 // Ключ квадранта – пара (qx, qy)
 using QuadrantKey = std::pair<int, int>;
 
+/**
+ * @brief Счётчики подкачки квадрантов (см. GlobalGridMapHandler::enablePaging).
+ */
+struct PagingStats {
+    std::uint64_t hits = 0;          ///< Обращения к квадранту, находящемуся в памяти
+    std::uint64_t misses = 0;        ///< Загрузки выгруженного квадранта с диска
+    std::uint64_t evictions = 0;     ///< Выгрузки квадрантов из памяти
+    std::uint64_t bytesSpilled = 0;  ///< Байт записано на диск
+    std::uint64_t bytesLoaded = 0;   ///< Байт прочитано с диска
+    std::size_t residentBytes = 0;   ///< Память квадрантов, находящихся в памяти
+    std::size_t residentQuadrants = 0; ///< Квадрантов в памяти
+};
+
+/**
+ * @brief Параметры онлайн-режима (см. GlobalGridMapHandler::startOnline).
+ */
+struct OnlineConfig {
+    double windowSize = 200.0;      ///< Сторона скользящего окна вокруг позы (м)
+    double recenterDistance = 5.0;  ///< Окно сдвигается, когда поза отходит от центра дальше (м)
+    std::size_t maxQueuedCells = std::size_t(1) << 22; ///< Предел очереди выгрузки; сверх него updatePose ждёт
+};
+
+/**
+ * @brief Счётчики онлайн-режима.
+ */
+struct OnlineStats {
+    std::uint64_t moves = 0;          ///< Сдвиги окна
+    std::uint64_t cellsFlushed = 0;   ///< Ячеек перенесено из окна в квадранты
+    std::uint64_t pointsOutside = 0;  ///< Точек вне окна, записанных сразу в квадранты
+    std::size_t queuedCells = 0;      ///< Ячеек в очереди выгрузки
+};
+
+/**
+ * @brief Как сводятся значения одной ячейки из разных файлов карты (см. GlobalGridMapHandler::mergeMapFiles).
+ */
+enum class MergeMode {
+    Sum,     ///< Сложение, как в loadMapFile: last_seen — максимум, occupancy ограничивается
+    Max,     ///< Максимум по всем слоям среди файлов, где есть блок ячейки (отрицательные значения сохраняются)
+    Weighted ///< Сумма с весами входов; last_seen — максимум, occupancy ограничивается
+};
+
+/**
+ * @brief Параметры объединения файлов карты.
+ */
+struct MergeOptions {
+    MergeMode mode = MergeMode::Sum;
+    std::vector<double> weights; ///< Вес каждого входа для MergeMode::Weighted (пусто — все по 1)
+    int threads = 1;             ///< Потоки свёртки квадрантов
+};
+
+/**
+ * @brief Счётчики объединения файлов карты.
+ */
+struct MergeStats {
+    std::size_t inputs = 0;         ///< Входных файлов
+    std::size_t quadrants = 0;      ///< Квадрантов в результате
+    std::uint64_t blocksRead = 0;   ///< Блоков 64x64, прочитанных из входов
+    std::uint64_t blocksWritten = 0; ///< Блоков 64x64 в результате
+};
+
+/**
+ * @brief Геометрия и слои файла карты (см. GlobalGridMapHandler::readMapFileInfo).
+ */
+struct MapFileInfo {
+    double quadrantSize = 0.0;
+    double resolution = 0.0;
+    MapLayers layers;              ///< heatLabels в файле не хранятся и остаются по умолчанию
+    std::uint64_t quadrantCount = 0;
+    std::uint64_t blockCount = 0;
+};
+
 /**
  * @brief Класс для управления глобальной картой, разбитой на квадранты.
  *
  * При добавлении точки GlobalGridMapHandler вычисляет, в какой квадрант (по размеру quadrantSize)
  * она попадает, и, если объект для этого квадранта ещё не создан, создаёт его.
  * Затем точка добавляется в соответствующий квадрант.
+ *
+ * addPoint не синхронизирован и предназначен для одного потока.
+ * Для накопления из нескольких потоков используется addPointsConcurrent:
+ * точки пакета группируются по квадрантам, и каждый квадрант блокируется
+ * один раз на группу. Смешивать эти вызовы одновременно нельзя.
+ *
+ * После enablePaging давно не использовавшиеся квадранты (LRU) выгружаются
+ * на диск, когда память превышает бюджет, и прозрачно загружаются обратно
+ * при следующем обращении.
+ *
+ * Накопленную карту можно сохранить в бинарный файл (saveMapFile) и позже
+ * отобразить его в память (loadMapFile), чтобы продолжить накопление.
+ * Файлы карт многих проездов сводятся в один по ключам квадрантов
+ * (mergeMapFiles, утилита merge_maps) без загрузки в карту.
+ *
+ * Кроме слоя heat карта может за один проход вести слои из MapLayers
+ * (попадания по классам, число наблюдений, время последнего наблюдения);
+ * они заполняются через addObservations. Слой занятости (occupancy) хранит
+ * ограниченные лог-шансы и обновляется по следу камеры (updateOccupancy):
+ * видимые в кадре ячейки без попаданий получают отрицательное свидетельство,
+ * поэтому следы временных объектов со временем исчезают.
+ *
+ * В онлайн-режиме (startOnline) накопление идёт в скользящее окно — квадрант
+ * с кольцевым буфером вокруг текущей позы. При сдвиге окна (updatePose)
+ * вышедшие из него ячейки уходят в очередь, и отдельный поток переносит их
+ * в квадранты, поэтому задержка кадра не зависит от длины маршрута.
  */
 class GlobalGridMapHandler {
 public:
@@ -23,37 +133,429 @@ public:
      * @brief Конструктор глобальной карты.
      * @param quadrantSize Размер одного квадранта в метрах
      * @param resolution Разрешение для каждого квадранта (м/пикс).
+     * @param storage Способ хранения ячеек квадрантов (плотный или разреженный).
+     */
+    GlobalGridMapHandler(double quadrantSize = 500.0, double resolution = 0.1,
+                         QuadrantStorage storage = QuadrantStorage::Dense);
+
+    /**
+     * @brief Удаляет файлы выгруженных квадрантов.
+     */
+    ~GlobalGridMapHandler();
+
+    /**
+     * @brief Задаёт накапливаемые слои и тип ячейки heat. Вызывается до добавления первых точек.
+     *
+     * Компактный heat (MapLayers::heatCell) уменьшает память квадрантов в 2 (UInt16)
+     * или 4 (UInt8Log) раза; файлы карты, пирамида и изображения по-прежнему получают float.
+     * @return false, если квадранты уже созданы, набор слоёв некорректен
+     *         или компактный heat запрошен для плотного хранения
+     */
+    bool setLayers(const MapLayers &layers);
+
+    const MapLayers& getLayers() const { return layers_; }
+
+    /**
+     * @brief Включает подкачку квадрантов с бюджетом памяти.
+     * @param memoryBudgetBytes Допустимая память квадрантов в памяти (байт)
+     * @param spillDirectory Папка для выгруженных квадрантов
+     * @return true, если папку удалось создать
      */
-    GlobalGridMapHandler(double quadrantSize = 500.0, double resolution = 0.1);
+    bool enablePaging(std::size_t memoryBudgetBytes, const std::string &spillDirectory);
+
+    /**
+     * @brief Счётчики подкачки.
+     */
+    PagingStats getPagingStats() const;
 
     /**
      * @brief Добавляет точку в глобальную карту.
+     *
+     * При подкачке LRU и учёт памяти обновляются, только когда точка попадает
+     * в другой квадрант, чем предыдущая.
      * @param x Координата X в метрах.
      * @param y Координата Y в метрах.
      * @param value Приращение
      */
     void addPoint(double x, double y, float value = 1.0f);
 
+    /**
+     * @brief Добавляет пакет точек в глобальную карту (быстрый путь).
+     *
+     * Подряд идущие точки одного квадранта обрабатываются одним вызовом
+     * QuadrantMap::addPoints, поэтому поиск квадранта выполняется один раз
+     * на серию, а не на каждую точку.
+     * @param points Точки (x, y) в метрах
+     * @param count Количество точек
+     * @param value Приращение
+     */
+    void addPoints(const cv::Point2f* points, std::size_t count, float value = 1.0f);
+
+    /**
+     * @brief Потокобезопасно добавляет пакет точек в глобальную карту.
+     *
+     * Квадранты создаются под эксклюзивной блокировкой, поиск идёт под
+     * разделяемой, точки одного квадранта добавляются под его мьютексом.
+     * Порядок сложения в ячейке зависит от потоков, поэтому для дробных
+     * приращений возможны расхождения в последних битах float.
+     * @param points Точки (x, y) в метрах
+     * @param count Количество точек
+     * @param value Приращение
+     */
+    void addPointsConcurrent(const cv::Point2f* points, std::size_t count, float value = 1.0f);
+
+    /**
+     * @brief Добавляет пакет точек с билинейным распределением по ячейкам (слой heat).
+     *
+     * Приращение value * weights[k] делится между четырьмя ячейками, центры
+     * которых окружают точку, пропорционально близости к ним: положение точки
+     * внутри ячейки не теряется, и на карте нет полос наложения. Если вес —
+     * площадь следа пикселя в ячейках (ProjectionLut::area), плотность карты
+     * не зависит от дальности до камеры. Квадранты ищутся по сериям, как
+     * в addPoints (см. QuadrantMap::addSplats); точки у края квадранта
+     * раскладываются на отсчёты по соседним квадрантам отдельно.
+     * @param points Точки (x, y) в метрах
+     * @param weights Вес каждой точки
+     * @param count Количество точек
+     * @param value Приращение при единичном весе
+     */
+    void addSplats(const cv::Point2f* points, const float* weights, std::size_t count, float value = 1.0f);
+
+    /**
+     * @brief Потокобезопасный вариант addSplats (синхронизация как в addPointsConcurrent).
+     */
+    void addSplatsConcurrent(const cv::Point2f* points, const float* weights, std::size_t count,
+                             float value = 1.0f);
+
+    /**
+     * @brief Добавляет пакет помеченных пикселей во все слои (см. QuadrantMap::addObservations).
+     *
+     * Квадранты ищутся по сериям подряд идущих точек, как в addPoints.
+     * @param points Точки (x, y) в метрах
+     * @param labels Метки классов точек
+     * @param count Количество точек
+     * @param value Приращение слоя heat
+     * @param time Время кадра (сек)
+     */
+    void addObservations(const cv::Point2f* points, const std::uint8_t* labels, std::size_t count,
+                         float value, double time);
+
+    /**
+     * @brief Потокобезопасный вариант addObservations (синхронизация как в addPointsConcurrent).
+     */
+    void addObservationsConcurrent(const cv::Point2f* points, const std::uint8_t* labels, std::size_t count,
+                                   float value, double time);
+
+    /**
+     * @brief Обновляет слой occupancy по кадру.
+     *
+     * След кадра (проекция ROI на плоскость) растеризуется построчным
+     * заполнением многоугольника по центрам ячеек. Ячейки следа, в которые
+     * попала хотя бы одна точка, получают logOddsHit, остальные —
+     * logOddsMiss (один раз за кадр, сколько бы точек ни попало в ячейку).
+     * @param footprint Вершины следа кадра в метрах (мировая система)
+     * @param vertexCount Количество вершин (не меньше 3)
+     * @param points Точки кадра (x, y) в метрах
+     * @param labels Метки точек; попаданием считаются точки с метками heatLabels.
+     *               nullptr — попаданием считается каждая точка
+     * @param count Количество точек
+     * @return false, если слой occupancy не ведётся или след вырожден либо слишком велик
+     */
+    bool updateOccupancy(const cv::Point2f* footprint, std::size_t vertexCount,
+                         const cv::Point2f* points, const std::uint8_t* labels, std::size_t count);
+
+    /**
+     * @brief Потокобезопасный вариант updateOccupancy (синхронизация как в addPointsConcurrent).
+     */
+    bool updateOccupancyConcurrent(const cv::Point2f* footprint, std::size_t vertexCount,
+                                   const cv::Point2f* points, const std::uint8_t* labels, std::size_t count);
+
+    /**
+     * @brief Включает онлайн-режим: скользящее окно с центром у позы (x, y).
+     *
+     * Окно выровнено по сетке ячеек квадрантов. Пока режим включён, addPoint(s),
+     * addSplats, addObservations и updateOccupancy (и их потокобезопасные варианты) пишут
+     * в окно, а точки вне окна — сразу в квадранты. Квадранты получают
+     * содержимое окна только после выгрузки (flushOnline, stopOnline), поэтому
+     * чтение и сохранение карты выполняются после них.
+     * @return false, если режим уже включён, окно меньше ячейки или размер
+     *         квадранта не кратен разрешению
+     */
+    bool startOnline(double x, double y, const OnlineConfig &config = OnlineConfig());
+
+    /**
+     * @brief Сдвигает окно к позе (x, y), если она отошла от центра дальше recenterDistance.
+     *
+     * Стоимость пропорциональна площади вышедшей полосы; её ячейки переносятся
+     * в квадранты асинхронно. Можно вызывать одновременно с накоплением.
+     */
+    void updatePose(double x, double y);
+
+    /**
+     * @brief Переносит всё окно в квадранты и ждёт, пока очередь выгрузки опустеет.
+     */
+    void flushOnline();
+
+    /**
+     * @brief Выгружает окно (flushOnline), останавливает поток выгрузки и выключает режим.
+     */
+    void stopOnline();
+
+    bool isOnline() const { return online_.active; }
+
+    /**
+     * @brief Счётчики онлайн-режима.
+     */
+    OnlineStats getOnlineStats() const;
+
+    double getQuadrantSize() const { return quadrantSize_; }
+    double getResolution() const { return resolution_; }
+
+    /**
+     * @brief Ключи квадрантов и их счётчики изменений.
+     *
+     * Счётчик квадранта увеличивается при каждом добавлении в него данных,
+     * поэтому по двум снимкам можно найти квадранты, изменившиеся между ними.
+     * Не вызывать одновременно с накоплением.
+     */
+    std::vector<std::pair<QuadrantKey, std::uint64_t>> getQuadrantVersions() const;
+
+    /**
+     * @brief Вызывает fn для квадранта (выгруженный квадрант читается во временный объект).
+     *
+     * Можно вызывать из нескольких потоков, но не одновременно с накоплением.
+     * @return false, если квадранта нет или его не удалось прочитать
+     */
+    bool visitQuadrant(const QuadrantKey &key, const std::function<void(const QuadrantMap&)>& fn) const;
+
+    /**
+     * @brief Количество созданных квадрантов.
+     */
+    std::size_t getQuadrantCount() const;
+
+    /**
+     * @brief Сумма значений всех ячеек всех квадрантов.
+     */
+    double getTotal() const;
+
+    /**
+     * @brief Память, занятая значениями ячеек квадрантов, находящихся в памяти, и окна онлайн-режима (байт).
+     */
+    std::size_t getMemoryBytes() const;
+
+    /**
+     * @brief Сохраняет все квадранты в бинарный файл карты.
+     *
+     * Файл хранит размер квадранта, разрешение, ключи квадрантов и непустые
+     * блоки 64x64 сырыми float. Блоки выровнены по странице, поэтому файл
+     * можно отображать в память без разбора. Не вызывать одновременно с накоплением.
+     * @param fileName Путь к файлу
+     * @return true, если успешно
+     */
+    bool saveMapFile(const std::string &fileName) const;
+
+    /**
+     * @brief Отображает файл карты в память и добавляет его значения к карте.
+     *
+     * Размер квадранта и разрешение файла должны совпадать с картой. В режиме
+     * Sparse блоки новых плиток не копируются: плитки ссылаются на отображение
+     * (copy-on-write), и накопление продолжается прямо в нём. Значения
+     * квадрантов и плиток, уже существующих в карте, складываются. При подкачке
+     * изменённые страницы отображения освобождаются вместе с выгруженным квадрантом.
+     * @param fileName Путь к файлу
+     * @return true, если файл корректен и загружен целиком
+     */
+    bool loadMapFile(const std::string &fileName);
+
+    /**
+     * @brief Читает геометрию и слои файла карты, не загружая квадранты.
+     * @return false, если файл не открылся или повреждён
+     */
+    static bool readMapFileInfo(const std::string &fileName, MapFileInfo &info);
+
+    /**
+     * @brief Объединяет файлы карты нескольких проездов в один, не загружая их в карту.
+     *
+     * Входы отображаются в память только для чтения, квадранты сводятся по
+     * ключу (qx, qy) в options.threads потоков. Каждый поток держит один
+     * сводимый квадрант (блоки этого ключа из всех входов), а записи в
+     * порядке ключей ждут не больше 2 * threads готовых квадрантов, поэтому
+     * память не зависит ни от числа входов, ни от размера города. Размер
+     * квадранта, разрешение и слои входов должны совпадать с картой;
+     * собственные квадранты карты не используются и не меняются.
+     * Результат — файл того же формата, что у saveMapFile: его можно снова
+     * объединять (проезды делятся между процессами и машинами, частичные
+     * карты сводятся следующим вызовом) или загрузить loadMapFile.
+     * @param inputs Файлы карты проездов
+     * @param output Путь к результату (пишется во временный файл и переименовывается)
+     * @param options Способ свёртки, веса входов и потоки
+     * @param stats Счётчики (может быть nullptr)
+     * @return false, если вход повреждён, не совпадает с картой или результат не записан
+     */
+    bool mergeMapFiles(const std::vector<std::string> &inputs, const std::string &output,
+                       const MergeOptions &options = MergeOptions(), MergeStats *stats = nullptr) const;
+
     /**
      * @brief Сохраняет квадрант с заданным ключом в виде изображения.
      * @param key Ключ квадранта (qx, qy).
      * @param fileName Путь к выходному файлу.
+     * @param layer Сохраняемый слой
+     * @param options Масштаб яркости и параметры кодировщика
      * @return true, если успешно.
      */
-    bool saveQuadrant(const QuadrantKey &key, const std::string &fileName) const;
+    bool saveQuadrant(const QuadrantKey &key, const std::string &fileName, const std::string &layer = "heat",
+                      const ImageOptions &options = ImageOptions()) const;
 
     /**
      * @brief Сохраняет все существующие квадранты, используя заданный префикс для имен файлов.
+     *
+     * Квадранты кодируются параллельно в options.threads потоков; пустые
+     * пропускаются при options.skipEmpty. Не вызывать одновременно с накоплением.
+     * @param prefix Префикс имён файлов
+     * @param layer Сохраняемый слой; для слоёв, кроме heat, имя слоя добавляется к префиксу
+     * @param options Масштаб яркости, пропуск пустых, потоки и параметры кодировщика
      */
-    void saveAllQuadrants(const std::string &prefix) const;
+    void saveAllQuadrants(const std::string &prefix, const std::string &layer = "heat",
+                          const ImageOptions &options = ImageOptions()) const;
 
 private:
+    // Квадрант и мьютекс, защищающий его ячейки при параллельном накоплении
+    struct Quadrant {
+        QuadrantKey key;
+        std::unique_ptr<QuadrantMap> map; // nullptr — квадрант ещё не создан или выгружен
+        std::mutex mutex;
+        bool spilled = false;   // на диске есть копия квадранта
+        bool dirty = false;     // квадрант изменён после загрузки или выгрузки
+        std::size_t bytes = 0;  // память квадранта, учтённая в residentBytes
+        std::uint64_t version = 0; // счётчик изменений (см. getQuadrantVersions)
+        bool inLru = false;
+        std::list<Quadrant*>::iterator lruIt;
+        // Участки mappedFiles_, на которые ссылаются плитки квадранта (см. loadMapFile)
+        std::vector<std::pair<char*, std::size_t>> mappedBlocks;
+    };
+
+    // Состояние подкачки; все поля, кроме enabled, защищены mutex
+    struct Paging {
+        bool enabled = false;
+        std::size_t budget = 0;
+        std::string directory;
+        std::list<Quadrant*> lru; // в начале — недавно использованные
+        // После неудачной выгрузки следующая попытка — когда память вырастет выше этого порога
+        std::size_t retryAbove = 0;
+        bool spillFailing = false;
+        PagingStats stats;
+        std::mutex mutex;
+    };
+
     // Вычисляет ключ квадранта для точки (x, y)
     QuadrantKey getQuadrantKey(double x, double y) const;
 
+    // Возвращает квадрант, создавая его при необходимости (без синхронизации)
+    Quadrant& getOrCreateQuadrant(const QuadrantKey& key);
+
+    // То же под quadrantsMutex_; узлы std::map не перемещаются, ссылка остаётся валидной
+    Quadrant& getOrCreateQuadrantShared(const QuadrantKey& key);
+
+    // Создаёт пустой квадрант по ключу
+    std::unique_ptr<QuadrantMap> createQuadrantMap(const QuadrantKey& key) const;
+
+    // Делает квадрант резидентным (создаёт или загружает с диска) и отмечает обращение.
+    // Вызывающий владеет квадрантом: один поток или захваченный quadrant.mutex
+    QuadrantMap& acquire(Quadrant& quadrant);
+
+    // Учитывает изменение квадранта и выгружает холодные квадранты сверх бюджета
+    void release(Quadrant& quadrant);
+
+    // Выгружает квадрант на диск (под paging_.mutex и мьютексом квадранта);
+    // false, если файл не записан и квадрант остался в памяти
+    bool evict(Quadrant& quadrant);
+
+    // Ячейки следа кадра, разложенные по квадрантам (центры ячеек и признак попадания)
+    struct OccupancyBin {
+        std::vector<cv::Point2f> cells;
+        std::vector<std::uint8_t> hits;
+    };
+    using OccupancyBins = std::map<QuadrantKey, OccupancyBin>;
+
+    // Растеризует след кадра и раскладывает его ячейки по квадрантам (буферы потока)
+    OccupancyBins* rasterizeFootprint(const cv::Point2f* footprint, std::size_t vertexCount,
+                                      const cv::Point2f* points, const std::uint8_t* labels,
+                                      std::size_t count) const;
+
+    // Онлайн-режим: скользящее окно и поток, переносящий вышедшие из него ячейки в квадранты.
+    // active меняется только в startOnline/stopOnline (не одновременно с накоплением)
+    struct FlushBatch {
+        std::vector<cv::Point2f> cells; // центры ячеек
+        std::vector<float> values;      // layers_.channelCount() значений на ячейку
+    };
+    struct Online {
+        bool active = false;
+        OnlineConfig config;
+        std::unique_ptr<QuadrantMap> window;
+        std::mutex mutex;            // ячейки и геометрия окна
+        long long cornerX = 0;       // угол окна с максимальными координатами, в ячейках
+        long long cornerY = 0;
+        int cells = 0;               // сторона окна в ячейках
+        double minX = 0, maxX = 0, minY = 0, maxY = 0; // точки строго внутри попадают в окно
+        std::deque<FlushBatch> queue;
+        bool flushing = false;       // поток выгрузки обрабатывает пакет
+        bool stop = false;
+        std::condition_variable queued;   // в очереди появился пакет
+        std::condition_variable drained;  // пакет обработан
+        std::mutex queueMutex;       // queue, flushing, stop, stats
+        OnlineStats stats;
+        std::thread flusher;
+    };
+
+    // Точка строго внутри окна и не ближе margin к его краю (под online_.mutex)
+    bool inWindow(double x, double y, double margin = 0.0) const {
+        return x > online_.minX + margin && x < online_.maxX - margin &&
+               y > online_.minY + margin && y < online_.maxY - margin;
+    }
+
+    // Квадрант точки; false — точка ближе ячейки к краю квадранта, и её отсчёты
+    // addSplats могут попасть в соседний квадрант
+    bool splatInterior(double x, double y, QuadrantKey& key) const;
+
+    // Ставит центр окна у позы (x, y) по сетке ячеек и сдвигает окно (под online_.mutex)
+    void recenterWindow(double x, double y, FlushBatch& batch);
+
+    // Ставит пакет в очередь выгрузки, ожидая, пока очередь не превышает предел
+    void enqueueFlush(FlushBatch&& batch);
+
+    // Поток выгрузки: переносит ячейки пакетов в квадранты
+    void flushLoop();
+
+    // В онлайн-режиме передаёт fn точки пакета, попавшие в окно дальше margin от края
+    // (под мьютексом окна), и заменяет points/labels/weights/count остальными точками
+    // (буферы потока); labels и weights могут быть nullptr. false — остальных точек нет
+    bool routeToWindow(const cv::Point2f*& points, const std::uint8_t*& labels, const float*& weights,
+                       std::size_t& count,
+                       const std::function<void(QuadrantMap&, const cv::Point2f*, const std::uint8_t*,
+                                                const float*, std::size_t)>& fn,
+                       double margin = 0.0);
+
+    // Вызывает fn для квадранта; выгруженный квадрант читается во временный объект
+    bool withQuadrant(const Quadrant& quadrant, const std::function<void(const QuadrantMap&)>& fn) const;
+
+    // Файл выгрузки квадранта
+    std::string spillPath(const QuadrantKey& key) const;
+
     double quadrantSize_; // размер одного квадранта (в метрах)
     double resolution_;   // разрешение для каждого квадранта (м/пикс)
-    std::map<QuadrantKey, std::unique_ptr<QuadrantMap>> quadrants_;
+    QuadrantStorage storage_;
+    MapLayers layers_;
+    std::array<bool, 256> heatLabel_{}; // метка считается попаданием в updateOccupancy
+    std::shared_ptr<TilePool> tilePool_; // общий пул плиток для режима Sparse
+    // Отображённые файлы карт; объявлены до quadrants_, чтобы пережить ссылающиеся на них плитки
+    std::vector<std::unique_ptr<MappedFile>> mappedFiles_;
+    std::map<QuadrantKey, Quadrant> quadrants_;
+    mutable std::shared_mutex quadrantsMutex_; // защищает структуру quadrants_
+    mutable Paging paging_;
+    mutable Online online_;
+    // Квадрант, в который при подкачке пишут addPoint: захвачен (acquire), а release
+    // с учётом памяти откладывается до перехода addPoint к другому квадранту
+    Quadrant* pointQuadrant_ = nullptr;
 };
 
 #endif // GLOBALGRIDMAPHANDLER_HPP
@@ -0,0 +1,107 @@
+#ifndef MAPLAYERS_HPP
+#define MAPLAYERS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Тип ячейки слоя heat
+ */
+enum class CellType
+{
+    Float32, ///< float: любые приращения, 4 байта
+    UInt16,  ///< счётчик с насыщением: heat = n * heatScale, 2 байта
+    UInt8Log ///< логарифмический код: точные 16 единиц heatScale, дальше шаг 6.25%, 1 байт
+};
+
+/**
+ * @brief Набор слоёв, накапливаемых картой за один проход.
+ *
+ * Слой "heat" есть всегда: в нём копятся приращения от пикселей с метками
+ * heatLabels (и от обычных addPoints). Дополнительно можно включить:
+ * число попаданий каждого класса из classes ("hits_<метка>"), число
+ * наблюдений ячейки любым пикселем ("observations") и время последнего
+ * наблюдения ("last_seen", секунды от timeOrigin) и вероятность занятости
+ * ячейки в лог-шансах ("occupancy", см. GlobalGridMapHandler::updateOccupancy).
+ *
+ * Каналы ячейки хранятся подряд (stride() float на ячейку), поэтому
+ * обновление всех слоёв от одного пикселя затрагивает одну кэш-линию.
+ *
+ * Если ведётся только heat, его можно хранить компактно (heatCell): приращения
+ * переводятся в единицы heatScale, дробная часть единицы округляется случайно
+ * (в среднем без потерь), а значения float получаются только при выгрузке —
+ * в блоки, изображения и файлы карты.
+ */
+struct MapLayers
+{
+    static constexpr int MAX_CHANNELS = 16;
+
+    std::vector<std::uint8_t> heatLabels{1}; ///< Метки, дающие приращение слоя heat
+    std::vector<std::uint8_t> classes;       ///< Метки, для которых ведётся слой попаданий
+    bool observations = false;               ///< Вести слой observations
+    bool lastSeen = false;                   ///< Вести слой last_seen
+    double timeOrigin = 0.0;                 ///< Начало отсчёта для last_seen (сек)
+    bool occupancy = false;                  ///< Вести слой occupancy (лог-шансы)
+    float logOddsHit = 0.85f;                ///< Приращение ячейки с попаданием за кадр
+    float logOddsMiss = -0.4f;               ///< Приращение видимой ячейки без попаданий
+    float logOddsMin = -2.0f;                ///< Нижняя граница лог-шансов
+    float logOddsMax = 3.5f;                 ///< Верхняя граница лог-шансов
+    CellType heatCell = CellType::Float32;   ///< Тип ячейки heat (компактные — без других слоёв, режим Sparse)
+    float heatScale = 1.0f;                  ///< Цена единицы компактной ячейки
+
+    /**
+     * @brief Количество слоёв
+     */
+    int channelCount() const;
+
+    /**
+     * @brief Шаг ячейки в float: channelCount(), округлённое до степени двойки
+     */
+    int stride() const;
+
+    /**
+     * @brief Размер ячейки в байтах: stride() float или один компактный heat
+     */
+    int cellBytes() const;
+
+    /**
+     * @brief Имена слоёв по порядку каналов
+     */
+    std::vector<std::string> channelNames() const;
+
+    /**
+     * @brief Номер канала по имени слоя, -1 если слоя нет
+     */
+    int channelOf(const std::string& name) const;
+
+    /**
+     * @brief Канал слоя попаданий класса, -1 если класс не отслеживается
+     */
+    int classChannel(std::uint8_t label) const;
+
+    int observationsChannel() const;
+    int lastSeenChannel() const;
+    int occupancyChannel() const;
+
+    /**
+     * @brief Нужны ли карте все пиксели кадра с метками (а не только пиксели heatLabels)
+     */
+    bool needsLabels() const { return !classes.empty() || observations || lastSeen; }
+
+    /**
+     * @brief Корректность набора: слоёв не больше MAX_CHANNELS, метки классов
+     *        не повторяются, logOddsMin <= 0 <= logOddsMax, компактный heat —
+     *        единственный слой с heatScale > 0
+     */
+    bool isValid() const;
+
+    /**
+     * @brief Совпадение слоёв и их смысла; тип ячейки heat не сравнивается —
+     *        он влияет только на хранение в памяти, а не на выгружаемые значения
+     */
+    bool operator==(const MapLayers& other) const;
+    bool operator!=(const MapLayers& other) const { return !(*this == other); }
+};
+
+#endif // MAPLAYERS_HPP
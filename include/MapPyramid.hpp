@@ -0,0 +1,93 @@
+#ifndef MAPPYRAMID_HPP
+#define MAPPYRAMID_HPP
+
+#include "GlobalGridMapHandler.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+/**
+ * @brief Свёртка 2x2 ячеек при переходе на более грубый уровень пирамиды
+ */
+enum class PyramidReduction
+{
+    Sum, ///< сумма (на изображении делится на площадь — плотность)
+    Max  ///< максимум
+};
+
+/**
+ * @brief Параметры пирамиды тайлов.
+ */
+struct PyramidConfig
+{
+    std::string layer = "heat";          ///< Экспортируемый слой (см. MapLayers::channelNames)
+    PyramidReduction reduction = PyramidReduction::Sum;
+    int maxZoom = 16;                    ///< Уровень исходного разрешения карты (ячейка = пиксель)
+    int minZoom = 8;                     ///< Самый грубый экспортируемый уровень
+    float displayMin = 0.0f;             ///< Значение, соответствующее началу палитры
+    float displayMax = 60.0f;            ///< Значение, соответствующее концу палитры
+    int threads = 4;                     ///< Потоки построения тайлов
+};
+
+/**
+ * @brief Пирамида уменьшенных копий слоя карты, экспортируемая деревом тайлов XYZ.
+ *
+ * Тайлы 256x256 пишутся как {папка}/{z}/{x}/{y}.png (палитра JET, пустые
+ * ячейки прозрачны). Схема тайлов метрическая: на уровне maxZoom пиксель
+ * равен ячейке карты, на каждом следующем уровне вдвое крупнее; тайл (0, 0)
+ * уровня 0 накрывает квадрат с центром в начале координат карты, x растёт
+ * на восток (X), y — на юг (против Y), как в slippy map.
+ *
+ * Рядом хранятся сырые значения тайлов грубых уровней ({папка}/raw/{z}/{x}/{y}.f32),
+ * поэтому повторный экспорт перестраивает только тайлы над квадрантами,
+ * изменившимися с прошлого экспорта (см. GlobalGridMapHandler::getQuadrantVersions).
+ * Папка должна принадлежать одной карте.
+ */
+class MapPyramid {
+public:
+    static constexpr int TILE_SIZE = 256;
+
+    explicit MapPyramid(const PyramidConfig& config = PyramidConfig());
+
+    /**
+     * @brief Строит и записывает тайлы над квадрантами, изменившимися с прошлого вызова.
+     *
+     * Первый вызов строит всю пирамиду. Квадранты читаются по одному,
+     * тайлы строятся в config.threads потоков. Не вызывать одновременно с накоплением.
+     * @param map Глобальная карта
+     * @param directory Корневая папка дерева тайлов
+     * @return true, если все тайлы записаны
+     */
+    bool exportTiles(const GlobalGridMapHandler& map, const std::string& directory);
+
+    /**
+     * @brief Забывает состояние прошлого экспорта: следующий строит всё заново.
+     */
+    void invalidate() { exported_.clear(); }
+
+    /**
+     * @brief Считает текущее состояние карты уже экспортированным.
+     *
+     * Состояние экспорта хранится только в памяти, а loadMapFile меняет счётчики
+     * всех квадрантов. Если тайлы в папке построены по загруженному файлу карты,
+     * вызов сразу после loadMapFile оставляет следующему экспорту только квадранты,
+     * изменённые после загрузки.
+     * @param map Глобальная карта
+     */
+    void markExported(const GlobalGridMapHandler& map);
+
+    /**
+     * @brief Количество тайлов (png), записанных последним экспортом.
+     */
+    std::size_t getTilesWritten() const { return tilesWritten_; }
+
+    const PyramidConfig& getConfig() const { return config_; }
+
+private:
+    PyramidConfig config_;
+    std::map<QuadrantKey, std::uint64_t> exported_; // счётчики квадрантов на момент экспорта
+    std::size_t tilesWritten_ = 0;
+};
+
+#endif // MAPPYRAMID_HPP
@@ -0,0 +1,59 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Файл, отображённый в память (mmap), с освобождением в деструкторе.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Режим отображения
+     */
+    enum class Mode {
+        ReadOnly,    ///< только чтение
+        CopyOnWrite  ///< запись разрешена, изменения не попадают в файл (MAP_PRIVATE)
+    };
+
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Отображает файл в память.
+     * @param fileName Путь к файлу
+     * @param mode Режим отображения
+     * @return true, если успешно (пустой файл считается ошибкой)
+     */
+    bool open(const std::string& fileName, Mode mode = Mode::ReadOnly);
+
+    /**
+     * @brief Снимает отображение.
+     */
+    void close();
+
+    /**
+     * @brief Сбрасывает изменённые страницы участка отображения (madvise MADV_DONTNEED).
+     *
+     * Для CopyOnWrite участок снова читается из файла, а его анонимные копии
+     * освобождаются. Неполные страницы по краям участка не затрагиваются.
+     * @param begin Начало участка внутри отображения
+     * @param size Размер участка в байтах
+     */
+    static void discard(char* begin, std::size_t size);
+
+    bool isOpen() const { return data_ != nullptr; }
+    const char* data() const { return static_cast<const char*>(data_); }
+    char* mutableData() { return static_cast<char*>(data_); }
+    std::size_t size() const { return size_; }
+
+private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif // MAPPEDFILE_HPP
@@ -0,0 +1,81 @@
+#ifndef MASKEXTRACTOR_HPP
+#define MASKEXTRACTOR_HPP
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Пиксель кадра, метка которого прошла фильтр классов
+ */
+struct MaskPixel
+{
+    std::uint16_t row;   ///< Строка кадра
+    std::uint16_t col;   ///< Столбец кадра
+    std::uint8_t label;  ///< Метка класса
+};
+
+/**
+ * @brief Выделение пикселей заданных классов из кадра сегментации.
+ *
+ * Метка пикселя — значение одноканального кадра (CV_8UC1) или целое среднее
+ * трёх каналов (CV_8UC3, как в исходной обработке BGR-кадров). Строки ROI
+ * сравниваются с набором меток блоками по simd::ByteMatcher::BYTES байт,
+ * совпавшие позиции извлекаются из битовой маски. Большие наборы меток
+ * (больше ByteMatcher::MAX_LABELS) проверяются по таблице. Строки можно
+ * обрабатывать в нескольких потоках; порядок пикселей в результате —
+ * по строкам, как при последовательном обходе.
+ */
+class MaskExtractor {
+public:
+    /**
+     * @param label Единственная метка класса
+     */
+    explicit MaskExtractor(std::uint8_t label = 1);
+
+    /**
+     * @param labels Набор меток классов
+     */
+    explicit MaskExtractor(const std::vector<std::uint8_t>& labels);
+
+    /**
+     * @brief Число потоков, между которыми делятся строки ROI (по умолчанию 1)
+     */
+    void setThreads(int threads);
+
+    /**
+     * @brief Проверяет, входит ли метка в набор
+     */
+    bool accepts(std::uint8_t label) const { return table_[label]; }
+
+    const std::vector<std::uint8_t>& getLabels() const { return labels_; }
+
+    /**
+     * @brief Находит пиксели ROI, метки которых входят в набор.
+     * @param frame Кадр CV_8UC1 или CV_8UC3 (не больше 65535x65535)
+     * @param roi Область кадра (обрезается по границам кадра)
+     * @param out Результат; прежнее содержимое заменяется
+     * @return Количество найденных пикселей
+     */
+    std::size_t extract(const cv::Mat& frame, const cv::Rect& roi, std::vector<MaskPixel>& out) const;
+
+    /**
+     * @brief Метки строки row кадра в столбцах roi.x .. roi.x + roi.width - 1.
+     * @param scratch Буфер для трёхканальных кадров (для одноканальных не используется)
+     * @return Указатель на roi.width меток
+     */
+    static const std::uint8_t* rowLabels(const cv::Mat& frame, int row, const cv::Rect& roi,
+                                         std::vector<std::uint8_t>& scratch);
+
+private:
+    // Обрабатывает строки [rowBegin, rowEnd) области roi, дописывая пиксели в out
+    void extractRows(const cv::Mat& frame, const cv::Rect& roi, int rowBegin, int rowEnd,
+                     std::vector<MaskPixel>& out) const;
+
+    std::vector<std::uint8_t> labels_;
+    bool table_[256] = {};
+    int threads_ = 1;
+};
+
+#endif // MASKEXTRACTOR_HPP
@@ -0,0 +1,36 @@
+#ifndef PARALLELFOR_HPP
+#define PARALLELFOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Выполняет fn(k) для каждого k из [0, count) в threads потоках.
+ *
+ * Потоки берут индексы по одному в порядке возрастания, вызывающий поток
+ * работает наравне с остальными. Потоков не больше count; возврат — когда
+ * обработаны все индексы.
+ * @param count Количество индексов
+ * @param threads Количество потоков (не меньше 1)
+ * @param fn Функция fn(std::size_t k), вызываемая из разных потоков
+ */
+template <typename Fn>
+void parallelFor(std::size_t count, int threads, Fn&& fn) {
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+        for (std::size_t k = next.fetch_add(1); k < count; k = next.fetch_add(1))
+            fn(k);
+    };
+    const std::size_t n = std::min<std::size_t>(static_cast<std::size_t>(std::max(threads, 1)), count);
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < n; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool)
+        thread.join();
+}
+
+#endif // PARALLELFOR_HPP
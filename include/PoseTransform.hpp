@@ -0,0 +1,40 @@
+#ifndef POSETRANSFORM_HPP
+#define POSETRANSFORM_HPP
+
+#include <opencv2/core.hpp>
+#include <cstddef>
+
+/**
+ * @brief Жёсткое преобразование точек из системы камеры в мировую.
+ *
+ * Поворот на yaw, сдвиг на (x, y) и, при необходимости, зеркалирование
+ * относительно OY (x -> -x) после сдвига.
+ */
+class PoseTransform {
+public:
+    /**
+     * @param x Смещение по X (метры)
+     * @param y Смещение по Y (метры)
+     * @param yawDegrees Угол поворота (градусы)
+     * @param mirrorX Зеркалить результат относительно OY
+     */
+    PoseTransform(double x, double y, double yawDegrees, bool mirrorX = false);
+
+    /**
+     * @brief Преобразует одну точку.
+     */
+    cv::Point2f apply(const cv::Point2f& p) const {
+        return cv::Point2f(a_[0] * p.x + a_[1] * p.y + a_[2],
+                           a_[3] * p.x + a_[4] * p.y + a_[5]);
+    }
+
+    /**
+     * @brief Пакетно преобразует массив точек (SIMD). src и dst могут совпадать.
+     */
+    void apply(const cv::Point2f* src, cv::Point2f* dst, std::size_t count) const;
+
+private:
+    float a_[6]; // аффинная матрица 2x3, построчно
+};
+
+#endif // POSETRANSFORM_HPP
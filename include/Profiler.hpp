@@ -0,0 +1,128 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Замеры горячих участков: таймеры областей и счётчики.
+ *
+ * Каждый поток пишет в собственный буфер (без блокировок и атомиков), буферы
+ * сводятся только в printSummary() и writeChromeTrace(), которые вызываются,
+ * когда замеряемая работа закончена. Замеры ставятся макросами PROFILE_SCOPE
+ * и PROFILE_COUNT; без MAP_BUILDER_PROFILING (опция CMake ENABLE_PROFILING)
+ * макросы пусты и в коде не остаётся ни вызовов, ни чтения часов.
+ * Пробы могут быть вложенными: время внешней включает время внутренних.
+ */
+class Profiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Замеряемые участки
+     */
+    enum class Probe
+    {
+        Decode,     ///< FrameSource::decode: чтение и декодирование кадра
+        Pose,       ///< Поиск позы кадра по траектории
+        Mask,       ///< MaskExtractor::extract
+        Projection, ///< Проекция кадра в конвейере (включает Mask и построение таблицы проекции)
+        CameraProjection, ///< Camera::projectPoints и projectMask
+        Accumulate, ///< Пакет GlobalGridMapHandler::add*: точки в квадранты
+        SaveImage,  ///< Рендер и кодирование квадранта: QuadrantMap::saveAsImage, GlobalGridMapHandler::saveAllQuadrants
+        Count
+    };
+
+    /**
+     * @brief Счётчики
+     */
+    enum class Counter
+    {
+        Frames,         ///< Кадров, добавленных в карту
+        Points,         ///< Точек, добавленных в карту
+        Quadrants,      ///< Созданных квадрантов
+        BytesAllocated, ///< Памяти, выделенной под ячейки карты (байт)
+        Count
+    };
+
+    /**
+     * @brief true, если замеры вкомпилированы (MAP_BUILDER_PROFILING)
+     */
+    static constexpr bool enabled() {
+#ifdef MAP_BUILDER_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Запоминать каждое срабатывание проб для writeChromeTrace (по умолчанию — только длительности).
+     */
+    static void enableTrace(bool enable);
+
+    /**
+     * @brief Записывает срабатывание пробы в буфер потока
+     */
+    static void record(Probe probe, Clock::time_point start, Clock::time_point end);
+
+    /**
+     * @brief Увеличивает счётчик в буфере потока
+     */
+    static void add(Counter counter, std::uint64_t value);
+
+    /**
+     * @brief Сводка: кадры/с, точки/с, p50/p99 длительности проб, квадранты и память.
+     *
+     * Скорости считаются по времени от первого до последнего замера.
+     */
+    static void printSummary(std::ostream& os);
+
+    /**
+     * @brief Записывает срабатывания проб в формате Chrome Trace (chrome://tracing, Perfetto).
+     * @return false, если трасса не включена или файл не записан
+     */
+    static bool writeChromeTrace(const std::string& fileName);
+
+    /**
+     * @brief Очищает буферы всех потоков (не во время замеряемой работы).
+     */
+    static void reset();
+
+    /**
+     * @brief Таймер области: записывает пробу при выходе из области
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(Probe probe) : probe_(probe), start_(Clock::now()) {}
+        ~Scope() { Profiler::record(probe_, start_, Clock::now()); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Probe probe_;
+        Clock::time_point start_;
+    };
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef MAP_BUILDER_PROFILING
+/// Замеряет время до конца области: PROFILE_SCOPE(Decode)
+#define PROFILE_SCOPE(probe) \
+    Profiler::Scope PROFILE_CONCAT(profileScope_, __LINE__)(Profiler::Probe::probe)
+/// Увеличивает счётчик: PROFILE_COUNT(Points, n)
+#define PROFILE_COUNT(counter, value) \
+    Profiler::add(Profiler::Counter::counter, static_cast<std::uint64_t>(value))
+#else
+#define PROFILE_SCOPE(probe) static_cast<void>(0)
+#define PROFILE_COUNT(counter, value) static_cast<void>(0)
+#endif
+
+#endif // PROFILER_HPP
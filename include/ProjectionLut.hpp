@@ -0,0 +1,94 @@
+#ifndef PROJECTIONLUT_HPP
+#define PROJECTIONLUT_HPP
+
+#include "MappedFile.hpp"
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Camera;
+
+/**
+ * @brief Таблица проекции пиксель -> точка на плоскости земли.
+ *
+ * Строится один раз для заданной гомографии, размера кадра и ROI и хранит
+ * смещение на плоскости (float2, метры) и площадь следа пикселя на плоскости
+ * (float, м², модуль якобиана гомографии) для каждого пикселя ROI. Проекция
+ * кадра сводится к выборке из таблицы. Таблицу можно сохранить на диск и
+ * затем отобразить в память (mmap) без повторного вычисления.
+ */
+class ProjectionLut {
+public:
+    ProjectionLut() = default;
+    ~ProjectionLut();
+
+    ProjectionLut(const ProjectionLut&) = delete;
+    ProjectionLut& operator=(const ProjectionLut&) = delete;
+
+    /**
+     * @brief Строит таблицу по гомографии камеры.
+     * @param camera Камера с вычисленной гомографией
+     * @param imageSize Размер кадра
+     * @param roi Область кадра, для которой строится таблица
+     * @return true, если успешно
+     */
+    bool build(const Camera& camera, const cv::Size& imageSize, const cv::Rect& roi);
+
+    /**
+     * @brief Сохраняет таблицу в бинарный файл (заголовок + массив float2).
+     */
+    bool save(const std::string& fileName) const;
+
+    /**
+     * @brief Отображает ранее сохранённый файл в память.
+     * @return true, если файл корректен
+     */
+    bool load(const std::string& fileName);
+
+    /**
+     * @brief Проверяет, что таблица построена для этой камеры, кадра и ROI.
+     */
+    bool matches(const Camera& camera, const cv::Size& imageSize, const cv::Rect& roi) const;
+
+    /**
+     * @brief Точка на плоскости для пикселя (r, c), лежащего внутри ROI.
+     */
+    const cv::Point2f& at(int r, int c) const {
+        return data_[static_cast<std::size_t>(r - roi_.y) * roi_.width + (c - roi_.x)];
+    }
+
+    /**
+     * @brief Площадь следа пикселя (r, c) на плоскости земли (м²); пиксель внутри ROI.
+     */
+    float area(int r, int c) const {
+        return area_[static_cast<std::size_t>(r - roi_.y) * roi_.width + (c - roi_.x)];
+    }
+
+    /**
+     * @brief Выбирает из таблицы точки для ненулевых пикселей маски внутри ROI.
+     * @param mask Маска CV_8UC1 размера imageSize()
+     * @param dst Буфер вызывающей стороны
+     * @param capacity Размер буфера dst
+     * @return Количество записанных точек
+     */
+    std::size_t gather(const cv::Mat& mask, cv::Point2f* dst, std::size_t capacity) const;
+
+    bool empty() const { return data_ == nullptr; }
+    const cv::Size& imageSize() const { return imageSize_; }
+    const cv::Rect& roi() const { return roi_; }
+
+private:
+    void release();
+
+    cv::Size imageSize_;
+    cv::Rect roi_;
+    float homography_[9] = {};            // гомография, по которой построена таблица
+    std::vector<cv::Point2f> table_;      // таблица, построенная в памяти
+    std::vector<float> areaTable_;        // площади следов пикселей, построенные в памяти
+    const cv::Point2f* data_ = nullptr;   // table_.data() или отображённый файл
+    const float* area_ = nullptr;         // areaTable_.data() или отображённый файл
+    MappedFile mapped_;                   // отображение загруженного файла
+};
+
+#endif // PROJECTIONLUT_HPP
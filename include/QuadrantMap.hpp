@@ -1,14 +1,85 @@
 #ifndef QUADRANTMAP_HPP
 #define QUADRANTMAP_HPP
 
+#include "MapLayers.hpp"
+#include "TileGrid.hpp"
 #include <grid_map_core/GridMap.hpp>
+#include <opencv2/core.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Способ хранения ячеек квадранта
+ */
+enum class QuadrantStorage
+{
+    Dense,  ///< плотный слой grid_map (вся площадь квадранта сразу)
+    Sparse  ///< разреженные плитки 64x64, выделяемые при первом обращении
+};
+
+/**
+ * @brief Шкала перевода значений слоя в палитру изображения
+ */
+enum class ImageScale
+{
+    Linear,    ///< [min, max] слоя линейно
+    Log,       ///< log(1 + v - min): различимы слабые значения рядом с сильными
+    Percentile ///< верхняя граница — перцентиль ненулевых значений, выше — насыщение
+};
+
+/**
+ * @brief Стратегия сжатия PNG (zlib): Rle и HuffmanOnly кодируют быстрее, файл больше
+ */
+enum class PngStrategy
+{
+    Default,
+    Filtered,
+    HuffmanOnly,
+    Rle,
+    Fixed
+};
+
+/**
+ * @brief Параметры сохранения квадранта изображением.
+ */
+struct ImageOptions
+{
+    ImageScale scale = ImageScale::Linear;
+    float percentile = 99.5f;        ///< Перцентиль для ImageScale::Percentile, (0, 100]
+    bool skipEmpty = false;          ///< Не сохранять квадранты, в которых слой пуст
+    int pngCompression = -1;         ///< Уровень сжатия PNG 0..9 (-1 — по умолчанию OpenCV)
+    PngStrategy pngStrategy = PngStrategy::Default;
+    int threads = 1;                 ///< Потоки GlobalGridMapHandler::saveAllQuadrants
+
+    /**
+     * @brief Параметры cv::imwrite
+     */
+    std::vector<int> encoderParams() const;
+};
 
 /**
  * @brief Класс, представляющий один квадрант карты
  *
  * Оборачивает grid_map_core, позволяя добавлять точки
- * и сохранять квадрант как изображение (тепловая карта)
+ * и сохранять квадрант как изображение (тепловая карта).
+ * В режиме Sparse grid_map хранит только геометрию, а значения
+ * лежат в TileGrid, поэтому память растёт с наблюдаемой площадью.
+ *
+ * Кроме слоя "heat" квадрант может вести слои из MapLayers. В режиме
+ * Dense каждый слой — отдельный слой grid_map; в режиме Sparse каналы
+ * ячейки лежат подряд и обновляются вместе.
+ *
+ * В режиме Sparse единственный слой heat можно хранить компактно
+ * (MapLayers::heatCell): ячейки лежат в CompactTileGrid, а значения float
+ * получаются только при выгрузке (readBlock, takeCells, getTotal, изображения).
+ * Плотный режим всегда хранит float.
  */
 class QuadrantMap {
 public:
@@ -19,9 +90,15 @@ public:
      * @param resolution Размер ячейки м/пикс
      * @param centerX Координата X центра квадранта
      * @param centerY Координата Y центра квадранта
+     * @param storage Способ хранения ячеек
+     * @param tilePool Пул плиток для режима Sparse (nullptr — собственный пул)
+     * @param layers Накапливаемые слои (по умолчанию только heat) и тип ячейки heat
      */
     QuadrantMap(double width = 500.0, double height = 500.0, double resolution = 0.1,
-                double centerX = 0.0, double centerY = 0.0);
+                double centerX = 0.0, double centerY = 0.0,
+                QuadrantStorage storage = QuadrantStorage::Dense,
+                std::shared_ptr<TilePool> tilePool = nullptr,
+                const MapLayers& layers = MapLayers());
 
     /**
      * @brief Добавляет точку (увеличивает значение) в квадранте
@@ -32,14 +109,243 @@ public:
     void addPoint(double x, double y, float value = 1.0f);
 
     /**
-     * @brief Сохраняет квадрант как изображение
+     * @brief Добавляет пакет точек в квадрант.
+     *
+     * Матрица слоя берётся один раз на пакет, индекс ячейки вычисляется
+     * целочисленно по геометрии карты (с учётом кольцевого буфера grid_map).
+     * Точки вне квадранта пропускаются.
+     * @param points Точки (x, y) в метрах
+     * @param count Количество точек
+     * @param value Приращение
+     */
+    void addPoints(const cv::Point2f* points, std::size_t count, float value = 1.0f);
+
+    /**
+     * @brief Добавляет пакет точек с весами: ячейка точки k получает value * weights[k].
+     *
+     * Используется для отсчётов билинейного распределения (GlobalGridMapHandler::addSplats).
+     * @param points Точки (x, y) в метрах
+     * @param weights Вес каждой точки
+     * @param count Количество точек
+     * @param value Приращение при единичном весе
+     */
+    void addWeightedPoints(const cv::Point2f* points, const float* weights, std::size_t count, float value);
+
+    /**
+     * @brief Билинейно распределяет пакет точек по ячейкам слоя heat.
+     *
+     * Точка делит value * weights[k] между четырьмя ячейками, центры которых
+     * её окружают. Координаты и веса отсчётов вычисляются векторно (simd::FloatV),
+     * сложение в ячейки скалярное. Отсчёты за краем квадранта пропускаются.
+     * @param points Точки (x, y) в метрах
+     * @param weights Вес каждой точки
+     * @param count Количество точек
+     * @param value Приращение при единичном весе
+     */
+    void addSplats(const cv::Point2f* points, const float* weights, std::size_t count, float value);
+
+    /**
+     * @brief Добавляет пакет помеченных пикселей во все слои за один проход.
+     *
+     * Для каждой точки: heat += value, если метка из heatLabels; попадания
+     * класса += 1; observations += 1; last_seen = max(last_seen, time - timeOrigin).
+     * @param points Точки (x, y) в метрах
+     * @param labels Метки классов точек
+     * @param count Количество точек
+     * @param value Приращение слоя heat
+     * @param time Время кадра (сек)
+     */
+    void addObservations(const cv::Point2f* points, const std::uint8_t* labels, std::size_t count,
+                         float value, double time);
+
+    /**
+     * @brief Обновляет лог-шансы занятости ячеек, видимых в кадре.
+     *
+     * Ячейке с попаданием прибавляется logOddsHit, остальным — logOddsMiss;
+     * результат ограничивается [logOddsMin, logOddsMax]. Каждая ячейка
+     * должна встречаться в пакете один раз за кадр.
+     * @param cells Центры ячеек (x, y) в метрах
+     * @param hits Признак попадания для каждой ячейки
+     * @param count Количество ячеек
+     */
+    void updateOccupancy(const cv::Point2f* cells, const std::uint8_t* hits, std::size_t count);
+
+    /**
+     * @brief Прибавляет значения ячеек, снятые с другого квадранта (см. move, takeCells).
+     *
+     * Каналы объединяются как в addBlock: last_seen — максимум, occupancy
+     * ограничивается, остальные складываются.
+     * @param cells Центры ячеек (x, y) в метрах
+     * @param values По getLayers().channelCount() значений на ячейку
+     * @param count Количество ячеек
+     */
+    void mergeCells(const cv::Point2f* cells, const float* values, std::size_t count);
+
+    /**
+     * @brief Сдвигает квадрант как кольцевой буфер так, чтобы его центр оказался у (centerX, centerY).
+     *
+     * Сдвиг округляется до целого числа ячеек, ячейки, оставшиеся в квадранте,
+     * не перемещаются в памяти. Непустые ячейки, вышедшие за квадрант,
+     * дописываются в cells/values (как в mergeCells) и обнуляются, поэтому
+     * стоимость сдвига пропорциональна площади вышедшей полосы.
+     */
+    void move(double centerX, double centerY, std::vector<cv::Point2f>& cells, std::vector<float>& values);
+
+    /**
+     * @brief Дописывает все непустые ячейки в cells/values (как в mergeCells) и обнуляет квадрант.
+     */
+    void takeCells(std::vector<cv::Point2f>& cells, std::vector<float>& values);
+
+    /**
+     * @brief Сумма значений всех ячеек квадранта
+     */
+    double getTotal() const;
+
+    /**
+     * @brief Память, занятая значениями ячеек (байт)
+     */
+    std::size_t getMemoryBytes() const;
+
+    QuadrantStorage getStorage() const { return storage_; }
+
+    /**
+     * @brief Фактический тип ячейки heat (Float32 в режиме Dense)
+     */
+    CellType getCellType() const { return cellType_; }
+
+    const MapLayers& getLayers() const { return layers_; }
+
+    /**
+     * @brief Размер квадранта в ячейках
+     */
+    grid_map::Size getSize() const { return gridMap_.getSize(); }
+
+    /**
+     * @brief Начальный индекс кольцевого буфера grid_map: ячейка буфера i лежит
+     *        на (i - start) mod size ячеек от угла с максимальными координатами
+     */
+    grid_map::Index getStartIndex() const { return gridMap_.getStartIndex(); }
+
+    /**
+     * @brief Размер блока 64x64 в float: TileGrid::TILE_CELLS * getLayers().stride()
+     */
+    std::size_t blockFloats() const { return TileGrid::TILE_CELLS * static_cast<std::size_t>(stride_); }
+
+    /**
+     * @brief Индексы (ti, tj) непустых блоков 64x64 в порядке хранения (по столбцам блоков)
+     */
+    std::vector<std::pair<int, int>> getNonEmptyBlocks() const;
+
+    /**
+     * @brief Копирует блок (ti, tj) в dst (blockFloats() float, раскладка как у плитки);
+     *        ячейки за краем квадранта заполняются нулями
+     */
+    void readBlock(int ti, int tj, float* dst) const;
+
+    /**
+     * @brief Прибавляет блок src (раскладка как у плитки) к ячейкам квадранта;
+     *        для last_seen берётся максимум, occupancy ограничивается как в updateOccupancy
+     */
+    void addBlock(int ti, int tj, const float* src);
+
+    /**
+     * @brief В режиме Sparse использует внешний блок как плитку без копирования.
+     *
+     * Память блока должна жить дольше квадранта и быть доступна для записи.
+     * @return false, если квадрант плотный или плитка уже выделена (тогда нужен addBlock)
+     */
+    bool attachBlock(int ti, int tj, float* external);
+
+    /**
+     * @brief Записывает квадрант в компактном бинарном виде:
+     *        геометрия и только непустые блоки 64x64 (компактные ячейки — как есть)
+     * @param os Поток, открытый в двоичном режиме
+     * @return Количество записанных байт (0 при ошибке)
+     */
+    std::size_t writeBinary(std::ostream &os) const;
+
+    /**
+     * @brief Читает квадрант, записанный writeBinary
+     * @param is Поток, открытый в двоичном режиме
+     * @param tilePool Пул плиток для режима Sparse (nullptr — собственный пул)
+     * @param layers Слои и тип ячейки, с которыми квадрант был записан
+     * @return Квадрант или nullptr, если данные повреждены
+     */
+    static std::unique_ptr<QuadrantMap> readBinary(std::istream &is,
+                                                   std::shared_ptr<TilePool> tilePool = nullptr,
+                                                   const MapLayers& layers = MapLayers());
+
+    /**
+     * @brief Сохраняет слой квадранта как изображение
      * @param fileName Путь к файлу для сохранения
+     * @param layer Имя слоя (см. MapLayers::channelNames)
      * @return true, если сохранение прошло успешно
      */
-    bool saveAsImage(const std::string &fileName) const;
+    bool saveAsImage(const std::string &fileName, const std::string &layer = LAYER_NAME,
+                     const ImageOptions &options = ImageOptions()) const;
+
+    /**
+     * @brief Переводит слой в цветное изображение (палитра JET) без копирования слоя.
+     *
+     * Строка изображения — столбец буфера grid_map, поэтому для плотного слоя
+     * строки читаются прямо из матрицы; min/max ищутся векторно, а перевод
+     * в байты и палитра применяются за один проход по строке.
+     * @param layer Имя слоя
+     * @param options Шкала и пропуск пустых квадрантов
+     * @param image CV_8UC3; пустое, если слой пуст и options.skipEmpty
+     * @return false, если слоя нет
+     */
+    bool renderImage(const std::string &layer, const ImageOptions &options, cv::Mat &image) const;
 
 private:
+    // Объединяет значение канала ячейки с прибавляемым блоком (см. addBlock)
+    float mergeChannel(int channel, float current, float value) const;
+
+    // Переносит непустые ячейки буфера [i0, i1) x [j0, j1) в cells/values и обнуляет их
+    void takeRange(int i0, int i1, int j0, int j1, std::vector<cv::Point2f>& cells, std::vector<float>& values);
+
+    // Значения канала для строки изображения r (столбец j = r буфера grid_map);
+    // плотный слой возвращается без копирования, разреженный собирается в scratch
+    const float* imageRow(const float* dense, int channel, int r, std::vector<float>& scratch) const;
+
+    bool compact() const { return cellType_ != CellType::Float32; }
+
+    // Прибавляет units единиц heatScale к компактной ячейке буфера (i, j)
+    void addUnits(int i, int j, float units);
+
+    // Размер блока 64x64 в байтах при хранении (writeBinary)
+    std::size_t blockBytes() const;
+
+    // Вызывает fn с компактной сеткой квадранта (uint16 или uint8)
+    template <typename Fn>
+    auto withCompact(Fn&& fn) const {
+        if (counts16_)
+            return fn(static_cast<const CompactTileGrid<std::uint16_t>&>(*counts16_));
+        return fn(static_cast<const CompactTileGrid<std::uint8_t>&>(*codes8_));
+    }
+
+    template <typename Fn>
+    auto withCompact(Fn&& fn) {
+        if (counts16_)
+            return fn(*counts16_);
+        return fn(*codes8_);
+    }
+
     grid_map::GridMap gridMap_;
+    QuadrantStorage storage_;
+    MapLayers layers_;
+    std::vector<std::string> channelNames_; // имена слоёв grid_map по каналам
+    int stride_;
+    int lastSeenChannel_;
+    int occupancyChannel_;
+    std::array<bool, 256> heatLabel_{};        // метка даёт приращение heat
+    std::array<std::int8_t, 256> classChannel_{}; // канал попаданий метки (0 — нет)
+    std::unique_ptr<TileGrid> tiles_; // значения ячеек в режиме Sparse
+    CellType cellType_;
+    float heatScale_;
+    std::unique_ptr<CompactTileGrid<std::uint16_t>> counts16_; // CellType::UInt16
+    std::unique_ptr<CompactTileGrid<std::uint8_t>> codes8_;    // CellType::UInt8Log
+    std::uint32_t dither_ = 0x9E3779B9u; // состояние случайного округления дробных единиц
     static constexpr const char* LAYER_NAME = "heat";
 };
 
@@ -0,0 +1,309 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MAP_BUILDER_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MAP_BUILDER_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MAP_BUILDER_SIMD_NEON 1
+#endif
+
+/**
+ * @brief Минимальная переносимая обёртка над SIMD-регистрами float.
+ *
+ * Ширина вектора выбирается при компиляции: AVX2 (8), SSE2/NEON (4),
+ * иначе скалярный вариант (1). Код, использующий simd::FloatV, пишется
+ * один раз и не зависит от набора инструкций.
+ */
+namespace simd {
+
+#if defined(MAP_BUILDER_SIMD_AVX2)
+
+struct FloatV {
+    static constexpr int WIDTH = 8;
+    __m256 v;
+};
+
+inline FloatV broadcast(float x) { return {_mm256_set1_ps(x)}; }
+inline FloatV load(const float* p) { return {_mm256_loadu_ps(p)}; }
+inline void store(float* p, FloatV a) { _mm256_storeu_ps(p, a.v); }
+inline FloatV operator+(FloatV a, FloatV b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline FloatV operator-(FloatV a, FloatV b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline FloatV operator*(FloatV a, FloatV b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline FloatV operator/(FloatV a, FloatV b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline FloatV iota(float start) {
+    return {_mm256_add_ps(_mm256_set1_ps(start),
+                          _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f))};
+}
+inline FloatV abs(FloatV a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v)}; }
+inline FloatV greater(FloatV a, FloatV b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+inline FloatV select(FloatV mask, FloatV a, FloatV b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+inline FloatV min(FloatV a, FloatV b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline FloatV max(FloatV a, FloatV b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline FloatV floor(FloatV a) { return {_mm256_floor_ps(a.v)}; }
+
+#elif defined(MAP_BUILDER_SIMD_SSE2)
+
+struct FloatV {
+    static constexpr int WIDTH = 4;
+    __m128 v;
+};
+
+inline FloatV broadcast(float x) { return {_mm_set1_ps(x)}; }
+inline FloatV load(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void store(float* p, FloatV a) { _mm_storeu_ps(p, a.v); }
+inline FloatV operator+(FloatV a, FloatV b) { return {_mm_add_ps(a.v, b.v)}; }
+inline FloatV operator-(FloatV a, FloatV b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline FloatV operator*(FloatV a, FloatV b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline FloatV operator/(FloatV a, FloatV b) { return {_mm_div_ps(a.v, b.v)}; }
+inline FloatV iota(float start) {
+    return {_mm_add_ps(_mm_set1_ps(start), _mm_setr_ps(0.f, 1.f, 2.f, 3.f))};
+}
+inline FloatV abs(FloatV a) { return {_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)}; }
+inline FloatV greater(FloatV a, FloatV b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline FloatV select(FloatV mask, FloatV a, FloatV b) {
+    return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+}
+inline FloatV min(FloatV a, FloatV b) { return {_mm_min_ps(a.v, b.v)}; }
+inline FloatV max(FloatV a, FloatV b) { return {_mm_max_ps(a.v, b.v)}; }
+inline FloatV floor(FloatV a) {
+    // В SSE2 нет округления вниз: отбрасывание дробной части и поправка для отрицательных
+    const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return {_mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.f)))};
+}
+
+#elif defined(MAP_BUILDER_SIMD_NEON)
+
+struct FloatV {
+    static constexpr int WIDTH = 4;
+    float32x4_t v;
+};
+
+inline FloatV broadcast(float x) { return {vdupq_n_f32(x)}; }
+inline FloatV load(const float* p) { return {vld1q_f32(p)}; }
+inline void store(float* p, FloatV a) { vst1q_f32(p, a.v); }
+inline FloatV operator+(FloatV a, FloatV b) { return {vaddq_f32(a.v, b.v)}; }
+inline FloatV operator-(FloatV a, FloatV b) { return {vsubq_f32(a.v, b.v)}; }
+inline FloatV operator*(FloatV a, FloatV b) { return {vmulq_f32(a.v, b.v)}; }
+#if defined(__aarch64__)
+inline FloatV operator/(FloatV a, FloatV b) { return {vdivq_f32(a.v, b.v)}; }
+#else
+inline FloatV operator/(FloatV a, FloatV b) {
+    // В ARMv7 нет деления: обратная величина + два шага Ньютона
+    float32x4_t r = vrecpeq_f32(b.v);
+    r = vmulq_f32(vrecpsq_f32(b.v, r), r);
+    r = vmulq_f32(vrecpsq_f32(b.v, r), r);
+    return {vmulq_f32(a.v, r)};
+}
+#endif
+inline FloatV iota(float start) {
+    const float offsets[4] = {0.f, 1.f, 2.f, 3.f};
+    return {vaddq_f32(vdupq_n_f32(start), vld1q_f32(offsets))};
+}
+inline FloatV abs(FloatV a) { return {vabsq_f32(a.v)}; }
+inline FloatV greater(FloatV a, FloatV b) { return {vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v))}; }
+inline FloatV select(FloatV mask, FloatV a, FloatV b) {
+    return {vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v)};
+}
+inline FloatV min(FloatV a, FloatV b) { return {vminq_f32(a.v, b.v)}; }
+inline FloatV max(FloatV a, FloatV b) { return {vmaxq_f32(a.v, b.v)}; }
+#if defined(__aarch64__)
+inline FloatV floor(FloatV a) { return {vrndmq_f32(a.v)}; }
+#else
+inline FloatV floor(FloatV a) {
+    const float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(a.v));
+    const uint32x4_t fix = vandq_u32(vcgtq_f32(t, a.v), vreinterpretq_u32_f32(vdupq_n_f32(1.f)));
+    return {vsubq_f32(t, vreinterpretq_f32_u32(fix))};
+}
+#endif
+
+#else
+
+struct FloatV {
+    static constexpr int WIDTH = 1;
+    float v;
+};
+
+inline FloatV broadcast(float x) { return {x}; }
+inline FloatV load(const float* p) { return {*p}; }
+inline void store(float* p, FloatV a) { *p = a.v; }
+inline FloatV operator+(FloatV a, FloatV b) { return {a.v + b.v}; }
+inline FloatV operator-(FloatV a, FloatV b) { return {a.v - b.v}; }
+inline FloatV operator*(FloatV a, FloatV b) { return {a.v * b.v}; }
+inline FloatV operator/(FloatV a, FloatV b) { return {a.v / b.v}; }
+inline FloatV iota(float start) { return {start}; }
+inline FloatV abs(FloatV a) { return {a.v < 0.f ? -a.v : a.v}; }
+inline FloatV greater(FloatV a, FloatV b) { return {a.v > b.v ? 1.f : 0.f}; }
+inline FloatV select(FloatV mask, FloatV a, FloatV b) { return mask.v != 0.f ? a : b; }
+inline FloatV min(FloatV a, FloatV b) { return {b.v < a.v ? b.v : a.v}; }
+inline FloatV max(FloatV a, FloatV b) { return {a.v < b.v ? b.v : a.v}; }
+inline FloatV floor(FloatV a) {
+    const float t = static_cast<float>(static_cast<int>(a.v));
+    return {t > a.v ? t - 1.f : t};
+}
+
+#endif
+
+constexpr int WIDTH = FloatV::WIDTH;
+
+/**
+ * @brief Загружает WIDTH точек (x, y), лежащих подряд, в два вектора.
+ */
+inline void loadInterleaved(const float* xy, FloatV& x, FloatV& y) {
+    alignas(32) float xs[WIDTH];
+    alignas(32) float ys[WIDTH];
+    for (int i = 0; i < WIDTH; i++) {
+        xs[i] = xy[2 * i];
+        ys[i] = xy[2 * i + 1];
+    }
+    x = load(xs);
+    y = load(ys);
+}
+
+/**
+ * @brief Сохраняет два вектора как WIDTH точек (x, y), лежащих подряд.
+ */
+inline void storeInterleaved(float* xy, FloatV x, FloatV y) {
+    alignas(32) float xs[WIDTH];
+    alignas(32) float ys[WIDTH];
+    store(xs, x);
+    store(ys, y);
+    for (int i = 0; i < WIDTH; i++) {
+        xy[2 * i] = xs[i];
+        xy[2 * i + 1] = ys[i];
+    }
+}
+
+/**
+ * @brief Расширяет [minVal, maxVal] значениями массива из count float.
+ */
+inline void minMax(const float* p, std::size_t count, float& minVal, float& maxVal) {
+    std::size_t i = 0;
+    if (count >= static_cast<std::size_t>(WIDTH)) {
+        FloatV lo = broadcast(minVal);
+        FloatV hi = broadcast(maxVal);
+        for (; i + WIDTH <= count; i += WIDTH) {
+            const FloatV v = load(p + i);
+            lo = min(lo, v);
+            hi = max(hi, v);
+        }
+        alignas(32) float los[WIDTH];
+        alignas(32) float his[WIDTH];
+        store(los, lo);
+        store(his, hi);
+        for (int k = 0; k < WIDTH; k++) {
+            minVal = los[k] < minVal ? los[k] : minVal;
+            maxVal = his[k] > maxVal ? his[k] : maxVal;
+        }
+    }
+    for (; i < count; i++) {
+        minVal = p[i] < minVal ? p[i] : minVal;
+        maxVal = p[i] > maxVal ? p[i] : maxVal;
+    }
+}
+
+/**
+ * @brief Сравнение байтов с небольшим набором значений (меток классов).
+ *
+ * match() сравнивает BYTES подряд идущих байтов со всеми метками сразу и
+ * возвращает битовую маску совпадений: бит k соответствует p[k]. Перебор
+ * установленных битов даёт сжатый список совпавших позиций.
+ */
+class ByteMatcher {
+public:
+    static constexpr int MAX_LABELS = 8;
+
+#if defined(MAP_BUILDER_SIMD_AVX2)
+    static constexpr int BYTES = 32;
+#elif defined(MAP_BUILDER_SIMD_SSE2) || defined(MAP_BUILDER_SIMD_NEON)
+    static constexpr int BYTES = 16;
+#else
+    static constexpr int BYTES = 8;
+#endif
+
+    /**
+     * @param labels Метки (не более MAX_LABELS, лишние игнорируются)
+     * @param count Количество меток
+     */
+    ByteMatcher(const std::uint8_t* labels, int count) : count_(count < MAX_LABELS ? count : MAX_LABELS) {
+        for (int k = 0; k < count_; k++) {
+#if defined(MAP_BUILDER_SIMD_AVX2)
+            labels_[k] = _mm256_set1_epi8(static_cast<char>(labels[k]));
+#elif defined(MAP_BUILDER_SIMD_SSE2)
+            labels_[k] = _mm_set1_epi8(static_cast<char>(labels[k]));
+#elif defined(MAP_BUILDER_SIMD_NEON)
+            labels_[k] = vdupq_n_u8(labels[k]);
+#else
+            labels_[k] = labels[k];
+#endif
+        }
+    }
+
+    std::uint32_t match(const std::uint8_t* p) const {
+#if defined(MAP_BUILDER_SIMD_AVX2)
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_setzero_si256();
+        for (int k = 0; k < count_; k++)
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, labels_[k]));
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(hit));
+#elif defined(MAP_BUILDER_SIMD_SSE2)
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hit = _mm_setzero_si128();
+        for (int k = 0; k < count_; k++)
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, labels_[k]));
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(hit));
+#elif defined(MAP_BUILDER_SIMD_NEON)
+        const uint8x16_t v = vld1q_u8(p);
+        uint8x16_t hit = vdupq_n_u8(0);
+        for (int k = 0; k < count_; k++)
+            hit = vorrq_u8(hit, vceqq_u8(v, labels_[k]));
+        // Аналог movemask: вес бита в каждой половине и горизонтальная сумма
+        static const std::uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                                  1, 2, 4, 8, 16, 32, 64, 128};
+        const uint8x16_t bits = vandq_u8(hit, vld1q_u8(weights));
+#if defined(__aarch64__)
+        return static_cast<std::uint32_t>(vaddv_u8(vget_low_u8(bits))) |
+               (static_cast<std::uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+#else
+        std::uint8_t lanes[16];
+        vst1q_u8(lanes, bits);
+        std::uint32_t mask = 0;
+        for (int i = 0; i < 8; i++)
+            mask |= lanes[i] | (static_cast<std::uint32_t>(lanes[i + 8]) << 8);
+        return mask;
+#endif
+#else
+        std::uint32_t mask = 0;
+        for (int i = 0; i < BYTES; i++) {
+            for (int k = 0; k < count_; k++) {
+                if (p[i] == labels_[k])
+                    mask |= 1u << i;
+            }
+        }
+        return mask;
+#endif
+    }
+
+private:
+    int count_;
+#if defined(MAP_BUILDER_SIMD_AVX2)
+    __m256i labels_[MAX_LABELS];
+#elif defined(MAP_BUILDER_SIMD_SSE2)
+    __m128i labels_[MAX_LABELS];
+#elif defined(MAP_BUILDER_SIMD_NEON)
+    uint8x16_t labels_[MAX_LABELS];
+#else
+    std::uint8_t labels_[MAX_LABELS];
+#endif
+};
+
+} // namespace simd
+
+#endif // SIMD_HPP
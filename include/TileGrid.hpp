@@ -0,0 +1,266 @@
+#ifndef TILEGRID_HPP
+#define TILEGRID_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Пул блоков фиксированного размера для плиток TileGrid.
+ *
+ * Память выделяется крупными кусками (slab) и раздаётся блоками;
+ * освобождённые блоки возвращаются в список свободных. Начало каждого
+ * блока выровнено по кэш-линии (при размере блока, кратном 16 float).
+ * Размер блока задаётся в float, но память не типизирована: блоки
+ * компактных сеток (CompactTileGrid) берутся из того же пула.
+ * Потокобезопасен.
+ */
+class TilePool {
+public:
+    /**
+     * @param tileFloats Размер одного блока в float
+     * @param tilesPerSlab Сколько блоков выделять за раз
+     */
+    explicit TilePool(std::size_t tileFloats, std::size_t tilesPerSlab = 256);
+
+    TilePool(const TilePool&) = delete;
+    TilePool& operator=(const TilePool&) = delete;
+
+    /**
+     * @brief Выдаёт обнулённый блок.
+     */
+    float* allocate();
+
+    /**
+     * @brief Возвращает блок в пул.
+     */
+    void release(float* tile);
+
+    /**
+     * @brief Размер одного блока в float.
+     */
+    std::size_t tileFloats() const { return tileFloats_; }
+
+    /**
+     * @brief Объём памяти, полученной пулом от системы (байт).
+     */
+    std::size_t reservedBytes() const;
+
+private:
+    std::size_t tileFloats_;
+    std::size_t tilesPerSlab_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<unsigned char[]>> slabs_;
+    std::vector<float*> free_;
+};
+
+/**
+ * @brief Разреженная сетка float-ячеек из плиток 64x64.
+ *
+ * Плитка выделяется из TilePool при первом обращении на запись, поэтому
+ * память пропорциональна реально наблюдаемой площади. Индексация (i, j)
+ * совпадает с индексами grid_map; внутри плитки ячейки хранятся по столбцам.
+ * Ячейка может состоять из нескольких каналов (stride float подряд,
+ * stride — степень двойки); канал 0 доступен через ref/get.
+ */
+class TileGrid {
+public:
+    static constexpr int TILE_SHIFT = 6;
+    static constexpr int TILE_SIZE = 1 << TILE_SHIFT;
+    static constexpr int TILE_MASK = TILE_SIZE - 1;
+    static constexpr std::size_t TILE_CELLS = static_cast<std::size_t>(TILE_SIZE) * TILE_SIZE;
+
+    /**
+     * @param rows Число ячеек по первому индексу
+     * @param cols Число ячеек по второму индексу
+     * @param pool Пул плиток (блоки по TILE_CELLS * stride float; nullptr — собственный пул)
+     * @param stride Число float на ячейку (степень двойки)
+     */
+    TileGrid(int rows, int cols, std::shared_ptr<TilePool> pool, int stride = 1);
+    ~TileGrid();
+
+    TileGrid(const TileGrid&) = delete;
+    TileGrid& operator=(const TileGrid&) = delete;
+
+    /**
+     * @brief Ссылка на ячейку; выделяет плитку при первом обращении.
+     */
+    float& ref(int i, int j) {
+        return *cell(i, j);
+    }
+
+    /**
+     * @brief Каналы ячейки (stride float подряд); выделяет плитку при первом обращении.
+     */
+    float* cell(int i, int j) {
+        float*& tile = tiles_[static_cast<std::size_t>(j >> TILE_SHIFT) * tileRows_ + (i >> TILE_SHIFT)];
+        if (!tile)
+            tile = allocateTile();
+        return tile + (static_cast<std::size_t>((i & TILE_MASK) + ((j & TILE_MASK) << TILE_SHIFT)) << strideShift_);
+    }
+
+    /**
+     * @brief Значение канала ячейки (0, если плитка не выделена).
+     */
+    float get(int i, int j, int channel = 0) const {
+        const float* tile = tiles_[static_cast<std::size_t>(j >> TILE_SHIFT) * tileRows_ + (i >> TILE_SHIFT)];
+        if (!tile)
+            return 0.0f;
+        return tile[(static_cast<std::size_t>((i & TILE_MASK) + ((j & TILE_MASK) << TILE_SHIFT)) << strideShift_) +
+                    channel];
+    }
+
+    /**
+     * @brief Плитка (ti, tj) или nullptr, если она не выделена.
+     */
+    const float* tile(int ti, int tj) const {
+        return tiles_[static_cast<std::size_t>(tj) * tileRows_ + ti];
+    }
+
+    /**
+     * @brief Плитка (ti, tj) для записи; выделяется, если её ещё нет.
+     */
+    float* mutableTile(int ti, int tj) {
+        float*& t = tiles_[static_cast<std::size_t>(tj) * tileRows_ + ti];
+        if (!t)
+            t = allocateTile();
+        return t;
+    }
+
+    /**
+     * @brief Использует внешний блок tileFloats() float как плитку (ti, tj) без копирования.
+     *
+     * Блок не возвращается в пул и должен жить дольше сетки (например,
+     * отображённый в память файл карты).
+     * @return false, если плитка уже есть
+     */
+    bool attachTile(int ti, int tj, float* external);
+
+    int stride() const { return 1 << strideShift_; }
+
+    /**
+     * @brief Размер плитки в float (TILE_CELLS * stride)
+     */
+    std::size_t tileFloats() const { return TILE_CELLS << strideShift_; }
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int tileRows() const { return tileRows_; }
+    int tileCols() const { return tileCols_; }
+
+    /**
+     * @brief Количество выделенных плиток.
+     */
+    std::size_t allocatedTiles() const { return allocated_; }
+
+    /**
+     * @brief Память, занятая плитками и таблицей указателей (байт).
+     */
+    std::size_t memoryBytes() const;
+
+    /**
+     * @brief Сумма канала по всем ячейкам.
+     */
+    double sum(int channel = 0) const;
+
+    /**
+     * @brief Минимум и максимум канала по всем ячейкам (невыделенные считаются нулями).
+     */
+    void minMax(float& minVal, float& maxVal, int channel = 0) const;
+
+private:
+    float* allocateTile();
+
+    int rows_;
+    int cols_;
+    int tileRows_;
+    int tileCols_;
+    int strideShift_;
+    std::vector<float*> tiles_; // по столбцам плиток: [tj * tileRows_ + ti]
+    std::vector<bool> external_; // плитка не из пула (см. attachTile)
+    std::shared_ptr<TilePool> pool_;
+    std::size_t allocated_ = 0;
+};
+
+/**
+ * @brief Разреженная сетка компактных ячеек (T = std::uint16_t или std::uint8_t).
+ *
+ * Раскладка плиток и индексация те же, что у одноканальной TileGrid, но
+ * ячейка занимает sizeof(T) байт, поэтому в кэш и в память помещается
+ * в 2-4 раза больше ячеек. Блоки берутся из TilePool с tileFloats().
+ * Смысл значений задаёт владелец (см. CellType).
+ */
+template <typename T>
+class CompactTileGrid {
+public:
+    using value_type = T;
+
+    /**
+     * @param pool Пул плиток (блоки по tileFloats() float; nullptr — собственный пул)
+     */
+    CompactTileGrid(int rows, int cols, std::shared_ptr<TilePool> pool);
+    ~CompactTileGrid();
+
+    CompactTileGrid(const CompactTileGrid&) = delete;
+    CompactTileGrid& operator=(const CompactTileGrid&) = delete;
+
+    /**
+     * @brief Ссылка на ячейку; выделяет плитку при первом обращении.
+     */
+    T& ref(int i, int j) {
+        T*& tile = tiles_[static_cast<std::size_t>(j >> TileGrid::TILE_SHIFT) * tileRows_ + (i >> TileGrid::TILE_SHIFT)];
+        if (!tile)
+            tile = allocateTile();
+        return tile[(i & TileGrid::TILE_MASK) + ((j & TileGrid::TILE_MASK) << TileGrid::TILE_SHIFT)];
+    }
+
+    /**
+     * @brief Плитка (ti, tj) или nullptr, если она не выделена.
+     */
+    const T* tile(int ti, int tj) const {
+        return tiles_[static_cast<std::size_t>(tj) * tileRows_ + ti];
+    }
+
+    T* tile(int ti, int tj) {
+        return tiles_[static_cast<std::size_t>(tj) * tileRows_ + ti];
+    }
+
+    /**
+     * @brief Плитка (ti, tj) для записи; выделяется, если её ещё нет.
+     */
+    T* mutableTile(int ti, int tj) {
+        T*& t = tiles_[static_cast<std::size_t>(tj) * tileRows_ + ti];
+        if (!t)
+            t = allocateTile();
+        return t;
+    }
+
+    /**
+     * @brief Размер плитки в float (для TilePool)
+     */
+    static constexpr std::size_t tileFloats() { return TileGrid::TILE_CELLS * sizeof(T) / sizeof(float); }
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int tileRows() const { return tileRows_; }
+    int tileCols() const { return tileCols_; }
+
+    /**
+     * @brief Память, занятая плитками и таблицей указателей (байт).
+     */
+    std::size_t memoryBytes() const;
+
+private:
+    T* allocateTile();
+
+    int rows_;
+    int cols_;
+    int tileRows_;
+    int tileCols_;
+    std::vector<T*> tiles_; // по столбцам плиток: [tj * tileRows_ + ti]
+    std::shared_ptr<TilePool> pool_;
+    std::size_t allocated_ = 0;
+};
+
+#endif // TILEGRID_HPP
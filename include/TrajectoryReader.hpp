@@ -1,7 +1,13 @@
 #ifndef TRAJECTORYREADER_HPP
 #define TRAJECTORYREADER_HPP
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 /**
@@ -33,6 +39,17 @@ public:
      */
     bool readExtFile();
 
+    /**
+     * @brief Быстрый вариант readExtFile: файл отображается в память,
+     *        поля разбираются на месте, числа читаются std::from_chars.
+     *
+     * Результат совпадает с readExtFile (кроме строк с некорректными числами:
+     * они пропускаются). Ранее прочитанные точки заменяются.
+     * @param threads Число потоков; файл делится на куски по границам строк
+     * @return true, если успешно
+     */
+    bool readExtFileMapped(int threads = 1);
+
     /**
      * @brief Находит ближайшую точку траектории по заданному времени
      * @param[in]  imageTime  время (сек)
@@ -41,6 +58,48 @@ public:
      */
     bool getClosestTrajectoryPoint(double imageTime, TrajectoryPoint& outPoint) const;
 
+    /**
+     * @brief Интерполирует позу на заданное время.
+     *
+     * x и y интерполируются линейно между соседними отсчётами, угол —
+     * по кратчайшей дуге (переход через 0/360 не даёт разворота).
+     * @param[in]  time      время (сек)
+     * @param[out] outPoint  интерполированная поза
+     * @return true, если время лежит внутри траектории
+     */
+    bool getInterpolatedTrajectoryPoint(double time, TrajectoryPoint& outPoint) const;
+
+    /**
+     * @brief Курсор для запросов по возрастающему времени.
+     *
+     * Помнит позицию последнего запроса и ищет от неё экспоненциальными
+     * шагами, поэтому для упорядоченного потока кадров запрос стоит O(1)
+     * в среднем; небольшие шаги назад (кадры, переупорядоченные потоками)
+     * тоже дешёвые. Курсор не потокобезопасен: по одному на поток.
+     */
+    class Cursor
+    {
+    public:
+        explicit Cursor(const TrajectoryReader& reader) : reader_(&reader) {}
+
+        /**
+         * @brief То же, что getInterpolatedTrajectoryPoint
+         */
+        bool interpolate(double time, TrajectoryPoint& outPoint);
+
+        /**
+         * @brief То же, что getClosestTrajectoryPoint
+         */
+        bool closest(double time, TrajectoryPoint& outPoint);
+
+    private:
+        // Первый отсчёт со временем >= time (как std::lower_bound)
+        std::size_t locate(double time);
+
+        const TrajectoryReader* reader_;
+        std::size_t index_ = 0;
+    };
+
     /**
      * @return Константная ссылка на весь вектор точек
      */
@@ -51,4 +110,72 @@ private:
     std::vector<TrajectoryPoint> trajectory_;
 };
 
+/**
+ * @brief Траектория, поступающая во время работы: файл, который дописывает
+ *        регистратор, или именованный канал (FIFO) в формате трк.эксти1.
+ *
+ * Поток чтения разбирает строки по мере поступления (первая строка — заголовок).
+ * Запрос позы ждёт, пока траектория не покроет время кадра. Файл читается,
+ * пока не вызван stop(); FIFO — пока его не закроют все писатели.
+ * Потокобезопасен.
+ */
+class TrajectoryStream
+{
+public:
+    /**
+     * @param extFilePath Путь к файлу или FIFO со столбцами как у TrajectoryReader
+     */
+    explicit TrajectoryStream(const std::string& extFilePath);
+    ~TrajectoryStream();
+
+    TrajectoryStream(const TrajectoryStream&) = delete;
+    TrajectoryStream& operator=(const TrajectoryStream&) = delete;
+
+    /**
+     * @brief Открывает источник и запускает поток чтения.
+     * @return false, если источник не удалось открыть
+     */
+    bool start();
+
+    /**
+     * @brief Останавливает поток чтения; ожидающие запросы завершаются.
+     */
+    void stop();
+
+    /**
+     * @brief То же, что TrajectoryReader::getInterpolatedTrajectoryPoint, но ждёт
+     *        отсчёт не раньше time не дольше timeout секунд.
+     */
+    bool interpolate(double time, TrajectoryPoint& outPoint, double timeout);
+
+    /**
+     * @brief То же, что TrajectoryReader::getClosestTrajectoryPoint, с ожиданием как в interpolate.
+     */
+    bool closest(double time, TrajectoryPoint& outPoint, double timeout);
+
+    /**
+     * @brief Забывает отсчёты, не нужные для запросов со временем >= time
+     *        (последний отсчёт раньше time остаётся для интерполяции).
+     */
+    void discardBefore(double time);
+
+    /**
+     * @brief Количество хранимых отсчётов.
+     */
+    std::size_t size() const;
+
+private:
+    void readLoop(int fd, bool fifo);
+    // Ждёт отсчёт со временем >= time, конец источника или таймаут; возвращает индекс lower_bound
+    std::size_t waitFor(double time, double timeout, std::unique_lock<std::mutex>& lock);
+
+    std::string extFilePath_;
+    std::deque<TrajectoryPoint> points_; // по возрастанию времени
+    mutable std::mutex mutex_;
+    std::condition_variable updated_;
+    bool finished_ = false;              // источник закончился, новых отсчётов не будет
+    std::atomic<bool> stop_{false};
+    std::thread reader_;
+};
+
 #endif // TRAJECTORYREADER_HPP
@@ -1,32 +1,47 @@
 #include "Camera.hpp"
+#include "CameraRig.hpp"
+#include "FramePipeline.hpp"
 #include "TrajectoryReader.hpp"
 #include "GlobalGridMapHandler.hpp" 
+#include "MapPyramid.hpp"
+#include "Profiler.hpp"
 #include <opencv2/opencv.hpp>
-#include <iostream>
+#include <algorithm>
+#include <cstdlib>
 #include <filesystem>
-#include <sstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
-cv::Point2f rotatePoint(const cv::Point2f &pt, float angleDegrees) {
-    float rad = angleDegrees * CV_PI / 180.0f;
-    float cosA = std::cos(rad);
-    float sinA = std::sin(rad);
-    return cv::Point2f(pt.x * cosA - pt.y * sinA,
-                       pt.x * sinA + pt.y * cosA);
-}
-
-
-
-double extractTimestamp(const std::string &filename) {
-    std::filesystem::path p(filename);
-    std::string stem = p.stem().string(); // например, "16363.segm"
-    std::istringstream iss(stem);
-    double ts;
-    iss >> ts;
-    return ts / 1000;
-}
+int main(int argc, char** argv) {
+    // --stream: кадры и траектория дописываются во время работы (запись с машины)
+    // --motion: вклад кадра зависит от сдвига вагона (значения карты отличаются от обычного прогона)
+    // --resume: продолжить накопление поверх карты прошлого запуска (кадры должны быть новыми,
+    //           иначе тепло тех же кадров учтётся дважды)
+    bool streaming = false;
+    bool motionWeighting = false;
+    bool resume = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--stream") {
+            streaming = true;
+        } else if (arg == "--motion") {
+            motionWeighting = true;
+        } else if (arg == "--resume") {
+            resume = true;
+        } else {
+            std::cerr << "Неизвестный аргумент: " << arg << "\n"
+                      << "Использование: " << argv[0] << " [--stream] [--motion] [--resume]\n";
+            return -1;
+        }
+    }
+    // Трасса замеров для chrome://tracing (при сборке с ENABLE_PROFILING)
+    const char* traceFile = std::getenv("MAP_BUILDER_TRACE");
+    if (Profiler::enabled() && traceFile)
+        Profiler::enableTrace(true);
 
-int main() {
     // Создаём камеру и вычисляем гомографию из 4 пар точек
     Camera camera;
     std::vector<cv::Point2f> imgPts = {
@@ -48,88 +63,129 @@ int main() {
     std::cout << "Гомография:\n" << camera.getHomography() << std::endl;
 
 
-    // Загружаем данные траектории
-    TrajectoryReader trajReader("/home/rougenn/projects/map_builder/data/get.356.trk.ext1");
-    if (!trajReader.readExtFile()) {
+    // Загружаем данные траектории (файл отображается в память и разбирается в несколько потоков);
+    // в потоковом режиме файл дочитывается по мере записи
+    const std::string trajectoryFile = "/home/rougenn/projects/map_builder/data/get.356.trk.ext1";
+    TrajectoryReader trajReader(trajectoryFile);
+    TrajectoryStream trajStream(trajectoryFile);
+    if (streaming ? !trajStream.start()
+                  : !trajReader.readExtFileMapped(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))) {
         std::cerr << "Ошибка чтения данных траектории!\n";
         return -1;
     }
 
-    GlobalGridMapHandler globalMap(500.0, 0.1);
-
-    std::string segFolder = "/home/rougenn/projects/map_builder/data/segmentation/get.356/";
-    int totalBrightPixels = 0;
-
-    std::vector<std::filesystem::directory_entry> entries;
-
-    // Собираем все файлы из папки
-    for (const auto &entry : std::filesystem::directory_iterator(segFolder)) {
-        if (entry.is_regular_file()) {
-            entries.push_back(entry);
-        }
+    // Разреженное хранение: память растёт с площадью пути, а не с площадью квадрантов
+    GlobalGridMapHandler globalMap(500.0, 0.1, QuadrantStorage::Sparse);
+    // Холодные квадранты выгружаются на диск, когда карта превышает бюджет памяти
+    if (!globalMap.enablePaging(std::size_t(4) << 30, "/home/rougenn/projects/map_builder/data/spill")) {
+        std::cerr << "Не удалось включить подкачку квадрантов!\n";
+        return -1;
     }
 
-    // Сортируем по имени файла
-    std::sort(entries.begin(), entries.end(),
-              [](const std::filesystem::directory_entry &a, const std::filesystem::directory_entry &b) {
-                  return extractTimestamp(a.path().string()) < extractTimestamp(b.path().string());
-              });
-
-    int cnt = 0;
-
-
-    for (const auto &entry : entries) {
-        std::string filePath = entry.path().string();
-        cv::Mat segImg = cv::imread(filePath, cv::IMREAD_COLOR);
-        if (segImg.empty()) {
-            std::cerr << "Не удалось загрузить изображение: " << filePath << "\n";
-            continue;
-        }
-
-        // ++cnt;
-        // if (cnt > 200) break;
-
-        double timestamp = extractTimestamp(filePath);
-        std::clog << filePath << std::endl;
-        TrajectoryPoint pose;
-        std::clog << timestamp << ' ';
-        if (!trajReader.getClosestTrajectoryPoint(timestamp, pose)) {
-            std::cerr << "Нет данных траектории для timestamp " << timestamp << "\n";
-            continue;
-        }
-        std::clog << pose.x << ' ' << pose.y << ", " << pose.yaw << std::endl;
-
-
-
-        for (int r = segImg.rows / 5 * 2; r < segImg.rows; r++) {
-            for (int c = 0; c < segImg.cols; c++) {
-                cv::Vec3b color = segImg.at<cv::Vec3b>(r, c);
-                
-                int avg = (color[0] + color[1] + color[2]) / 3;
-                if (avg == 1) { // если яркий пиксель
-                    totalBrightPixels++;
+    // Слой занятости: ячейки, видимые в кадре без попаданий, получают отрицательное
+    // свидетельство, поэтому следы проехавших объектов со временем исчезают
+    MapLayers layers;
+    layers.occupancy = true;
+    if (!globalMap.setLayers(layers)) {
+        std::cerr << "Не удалось задать слои карты!\n";
+        return -1;
+    }
 
-                    // Проецируем точку
-                    cv::Point2f projPt = camera.projectPoint({static_cast<float>(c), static_cast<float>(r)});
+    // Карта прошлых запусков: с --resume накопление продолжается поверх неё,
+    // без флага карта строится заново и перезаписывает файл
+    const std::string mapFile = "/home/rougenn/projects/map_builder/data/map.mbmap";
+    const bool mapLoaded = resume && std::filesystem::exists(mapFile);
+    if (mapLoaded && !globalMap.loadMapFile(mapFile)) {
+        std::cerr << "Ошибка загрузки карты: " << mapFile << "\n";
+        return -1;
+    }
 
-                    // Поворот точки
-                    cv::Point2f rotatedPt = rotatePoint(projPt, pose.yaw);
+    // Дерево тайлов XYZ для просмотрщика: обзорные уровни без чтения полных квадрантов.
+    // Тайлы прошлого запуска построены по загруженной карте: экспорт в конце
+    // перестроит только тайлы над квадрантами, изменёнными в этом запуске
+    const std::string tilesFolder = "/home/rougenn/projects/map_builder/data/tiles";
+    unsigned cores = std::max(2u, std::thread::hardware_concurrency());
+    PyramidConfig pyramidConfig;
+    pyramidConfig.threads = static_cast<int>(cores);
+    MapPyramid pyramid(pyramidConfig);
+    if (mapLoaded && std::filesystem::exists(tilesFolder + "/raw"))
+        pyramid.markExported(globalMap);
 
-                    // Если требуется добавить смещение по траектории (pose)
-                    cv::Point2f worldPt = rotatedPt;
-                    worldPt.x += static_cast<float>(pose.x);
-                    worldPt.y += static_cast<float>(pose.y);
+    std::string segFolder = "/home/rougenn/projects/map_builder/data/segmentation/get.356/";
 
-                    // Добавляем точку в глобальную карту
-                    // зеркалим относительно OY
-                    globalMap.addPoint(-worldPt.x, worldPt.y, 6.0f);
-                }
-            }
-        }
+    // Многопоточный конвейер: декодирование, сопоставление с траекторией, проекция, накопление
+    PipelineConfig config;
+    config.decodeThreads = static_cast<int>(cores / 2);
+    config.projectionThreads = static_cast<int>(cores / 2);
+    config.pointValue = 6.0f;
+    config.mirrorX = true; // зеркалим относительно OY
+    // Построчный журнал кадров пишется синхронно и замедляет прогон; время стадий — в сводке замеров
+    config.logFrames = false;
+    // Потоковый режим завершается, если запись кадров остановилась
+    config.streamIdleTimeout = 10.0;
+    // На остановках кадры почти не отличаются: с --motion вклад кадра пропорционален сдвигу
+    // вагона, кадры без заметного сдвига и с повторной маской не обрабатываются.
+    // По умолчанию каждый кадр даёт полный вклад, как раньше
+    if (motionWeighting) {
+        config.motion.policy = MotionPolicy::Weight;
+        config.motion.minDistance = 0.5;
+        config.motion.minYaw = 1.0;
+        config.cullRepeatedMasks = true;
     }
 
-    globalMap.saveAllQuadrants("quadrant");
-
-
+    // Установка камер вагона: кадры всех камер накапливаются за один проход по траектории.
+    // Кэш таблицы проекции у каждой камеры свой: при повторных запусках отображается в память.
+    // Остальные камеры добавляются со своей калибровкой, установкой и папкой кадров, например
+    // rig.addCamera("rear", rearCamera, CameraMount{0.0, -30.0, 180.0}, rearFolder, rearLut);
+    CameraRig rig;
+    rig.addCamera("front", camera, CameraMount(), segFolder,
+                  "/home/rougenn/projects/map_builder/data/projection.lut");
+
+    std::unique_ptr<FramePipeline> pipeline;
+    bool processed;
+    if (streaming) {
+        // Уже записанные кадры берутся сразу, новые — по мере появления
+        FrameStream frames;
+        if (!frames.watchDirectory(segFolder, ".png", true))
+            return -1;
+        pipeline = std::make_unique<FramePipeline>(rig, trajStream, globalMap, config);
+        processed = pipeline->run(frames);
+        trajStream.stop();
+    } else {
+        pipeline = std::make_unique<FramePipeline>(rig, trajReader, globalMap, config);
+        processed = pipeline->run();
+    }
+    if (!processed) {
+        std::cerr << "Ошибка обработки кадров!\n";
+        return -1;
+    }
+    pipeline->printStats(std::cout);
+    std::cout << "Ярких пикселей: " << pipeline->getTotalPoints() << std::endl;
+    std::cout << "Память карты: " << globalMap.getMemoryBytes() / (1024 * 1024) << " МБ" << std::endl;
+    PagingStats paging = globalMap.getPagingStats();
+    std::cout << "Подкачка: попаданий " << paging.hits << ", промахов " << paging.misses
+              << ", выгрузок " << paging.evictions << ", записано " << paging.bytesSpilled / (1024 * 1024)
+              << " МБ" << std::endl;
+
+    if (!globalMap.saveMapFile(mapFile))
+        std::cerr << "Ошибка сохранения карты: " << mapFile << "\n";
+    // Быстрое сжатие PNG и параллельное кодирование; пустые квадранты не пишутся
+    ImageOptions imageOptions;
+    imageOptions.threads = static_cast<int>(cores);
+    imageOptions.skipEmpty = true;
+    imageOptions.pngCompression = 1;
+    globalMap.saveAllQuadrants("quadrant", "heat", imageOptions);
+    globalMap.saveAllQuadrants("quadrant", "occupancy", imageOptions);
+
+    if (!pyramid.exportTiles(globalMap, tilesFolder))
+        std::cerr << "Ошибка экспорта тайлов карты\n";
+    else
+        std::cout << "Тайлов записано: " << pyramid.getTilesWritten() << std::endl;
+
+    if (Profiler::enabled()) {
+        Profiler::printSummary(std::cout);
+        if (traceFile)
+            Profiler::writeChromeTrace(traceFile);
+    }
     return 0;
 }
@@ -1,11 +1,44 @@
 #include "Camera.hpp"
+#include "Profiler.hpp"
+#include "ProjectionLut.hpp"
+#include "Simd.hpp"
 #include <opencv2/calib3d.hpp>   // findHomography
 #include <opencv2/imgproc.hpp>   // warpPerspective, perspectiveTransform
 #include <stdexcept>
 #include <iostream>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+// Проецирует WIDTH точек; при |w| <= FLT_EPSILON возвращает (0, 0), как cv::perspectiveTransform
+inline void projectLanes(const float* h, simd::FloatV x, simd::FloatV y,
+                         simd::FloatV& outX, simd::FloatV& outY) {
+    using namespace simd;
+    FloatV X = broadcast(h[0]) * x + broadcast(h[1]) * y + broadcast(h[2]);
+    FloatV Y = broadcast(h[3]) * x + broadcast(h[4]) * y + broadcast(h[5]);
+    FloatV W = broadcast(h[6]) * x + broadcast(h[7]) * y + broadcast(h[8]);
+    FloatV inv = select(greater(abs(W), broadcast(FLT_EPSILON)),
+                        broadcast(1.f) / W, broadcast(0.f));
+    outX = X * inv;
+    outY = Y * inv;
+}
+
+inline cv::Point2f projectScalar(const float* h, float x, float y) {
+    float W = h[6] * x + h[7] * y + h[8];
+    if (std::fabs(W) <= FLT_EPSILON)
+        return cv::Point2f(0.f, 0.f);
+    float inv = 1.f / W;
+    return cv::Point2f((h[0] * x + h[1] * y + h[2]) * inv,
+                       (h[3] * x + h[4] * y + h[5]) * inv);
+}
+
+} // namespace
 
 Camera::Camera() {
     homography_ = cv::Mat::eye(3, 3, CV_64F);
+    cacheCoefficients();
 }
 
 Camera::Camera(const cv::Mat& homography) {
@@ -13,6 +46,15 @@ Camera::Camera(const cv::Mat& homography) {
         throw std::invalid_argument("неправильный размер матрицы гомографии");
     }
     homography_ = homography.clone();
+    cacheCoefficients();
+}
+
+void Camera::cacheCoefficients() {
+    cv::Mat H;
+    homography_.convertTo(H, CV_64F);
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+            hf_[r * 3 + c] = static_cast<float>(H.at<double>(r, c));
 }
 
 bool Camera::computeHomography(const std::vector<cv::Point2f>& imagePoints,
@@ -36,6 +78,8 @@ bool Camera::computeHomography(const std::vector<cv::Point2f>& imagePoints,
         return false;
     }
     homography_ = H.clone();
+    cacheCoefficients();
+    lut_.reset(); // таблица проекции устарела
     return true;
 }
 
@@ -47,3 +91,125 @@ cv::Point2f Camera::projectPoint(const cv::Point2f& imagePoint) const {
         return dstPts[0];
     return cv::Point2f(0.f, 0.f);
 }
+
+void Camera::projectPoints(const cv::Point2f* src, cv::Point2f* dst, std::size_t count) const {
+    PROFILE_SCOPE(CameraProjection);
+    const float* in = reinterpret_cast<const float*>(src);
+    float* out = reinterpret_cast<float*>(dst);
+
+    std::size_t i = 0;
+    for (; i + simd::WIDTH <= count; i += simd::WIDTH) {
+        simd::FloatV x, y, wx, wy;
+        simd::loadInterleaved(in + 2 * i, x, y);
+        projectLanes(hf_, x, y, wx, wy);
+        simd::storeInterleaved(out + 2 * i, wx, wy);
+    }
+    for (; i < count; i++)
+        dst[i] = projectScalar(hf_, src[i].x, src[i].y);
+}
+
+bool Camera::projectFootprint(const cv::Rect& roi, cv::Point2f footprint[4], float maxRange) const {
+    if (roi.width <= 0 || roi.height <= 0)
+        return false;
+    const float left = static_cast<float>(roi.x);
+    const float right = static_cast<float>(roi.x + roi.width - 1);
+    const float top = static_cast<float>(roi.y);
+    const float bottom = static_cast<float>(roi.y + roi.height - 1);
+    // Нижние углы задают сторону горизонта, на которой лежит земля
+    const float wBottom = hf_[6] * left + hf_[7] * bottom + hf_[8];
+    const float sign = wBottom > 0.0f ? 1.0f : -1.0f;
+    // Пиксель виден на земле в пределах дальности: w того же знака, что у нижней строки
+    auto visible = [&](float x, float y) {
+        const float w = hf_[6] * x + hf_[7] * y + hf_[8];
+        if (w * sign <= FLT_EPSILON)
+            return false;
+        if (maxRange <= 0.0f)
+            return true;
+        const cv::Point2f p = projectScalar(hf_, x, y);
+        return p.x * p.x + p.y * p.y <= maxRange * maxRange;
+    };
+    if (!visible(left, bottom) || !visible(right, bottom))
+        return false;
+    // Вдоль столбца видимые пиксели образуют отрезок, начинающийся с нижней строки
+    // (знак w линеен, расстояние вдоль прямой на земле выпукло): верхняя граница
+    // ищется делением пополам с точностью до половины пикселя
+    auto clipTop = [&](float x) {
+        if (visible(x, top))
+            return top;
+        float out = top, in = bottom;
+        while (in - out > 0.5f) {
+            const float mid = 0.5f * (in + out);
+            if (visible(x, mid))
+                in = mid;
+            else
+                out = mid;
+        }
+        return in;
+    };
+    const cv::Point2f corners[4] = {{left, clipTop(left)}, {right, clipTop(right)}, {right, bottom}, {left, bottom}};
+    for (int k = 0; k < 4; k++)
+        footprint[k] = projectScalar(hf_, corners[k].x, corners[k].y);
+    return true;
+}
+
+std::size_t Camera::projectMask(const cv::Mat& mask, const cv::Rect& roi,
+                                cv::Point2f* dst, std::size_t capacity) const {
+    PROFILE_SCOPE(CameraProjection);
+    if (mask.empty() || mask.type() != CV_8UC1) {
+        std::cerr << "projectMask: ожидается непустая маска CV_8UC1\n";
+        return 0;
+    }
+    if (lut_ && lut_->imageSize() == mask.size() && lut_->roi() == roi)
+        return lut_->gather(mask, dst, capacity);
+
+    const int rowBegin = std::max(roi.y, 0);
+    const int rowEnd = std::min(roi.y + roi.height, mask.rows);
+    const int colBegin = std::max(roi.x, 0);
+    const int colEnd = std::min(roi.x + roi.width, mask.cols);
+
+    // Столбцы выбранных пикселей строки копятся небольшими порциями на стеке
+    constexpr int CHUNK = 256;
+    alignas(32) float cols[CHUNK + simd::WIDTH];
+
+    std::size_t written = 0;
+    for (int r = rowBegin; r < rowEnd && written < capacity; r++) {
+        const uchar* row = mask.ptr<uchar>(r);
+        const simd::FloatV y = simd::broadcast(static_cast<float>(r));
+        int c = colBegin;
+        while (c < colEnd && written < capacity) {
+            int n = 0;
+            const int limit = static_cast<int>(std::min<std::size_t>(CHUNK, capacity - written));
+            for (; c < colEnd && n < limit; c++) {
+                if (row[c])
+                    cols[n++] = static_cast<float>(c);
+            }
+
+            float* out = reinterpret_cast<float*>(dst + written);
+            int i = 0;
+            for (; i + simd::WIDTH <= n; i += simd::WIDTH) {
+                simd::FloatV wx, wy;
+                projectLanes(hf_, simd::load(cols + i), y, wx, wy);
+                simd::storeInterleaved(out + 2 * i, wx, wy);
+            }
+            for (; i < n; i++)
+                dst[written + i] = projectScalar(hf_, cols[i], static_cast<float>(r));
+            written += n;
+        }
+    }
+    return written;
+}
+
+bool Camera::prepareLut(const cv::Size& imageSize, const cv::Rect& roi, const std::string& cacheFile) {
+    auto lut = std::make_shared<ProjectionLut>();
+    if (!cacheFile.empty() && lut->load(cacheFile) && lut->matches(*this, imageSize, roi)) {
+        lut_ = std::move(lut);
+        return true;
+    }
+    lut = std::make_shared<ProjectionLut>();
+    if (!lut->build(*this, imageSize, roi))
+        return false;
+    if (!cacheFile.empty() && !lut->save(cacheFile))
+        std::cerr << "Не удалось сохранить таблицу проекции: " << cacheFile << "\n";
+    lut_ = std::move(lut);
+    return true;
+}
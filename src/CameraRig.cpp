@@ -0,0 +1,21 @@
+#include "CameraRig.hpp"
+
+#include <cmath>
+
+std::size_t CameraRig::addCamera(const std::string& name, const Camera& camera, const CameraMount& mount,
+                                 const std::string& segFolder, const std::string& lutCacheFile) {
+    cameras_.push_back({name, camera, mount, segFolder, lutCacheFile});
+    return cameras_.size() - 1;
+}
+
+TrajectoryPoint CameraRig::cameraPose(const TrajectoryPoint& pose, const CameraMount& mount) {
+    // Тот же поворот, что в PoseTransform: точка камеры p -> R(yaw)(R(mount.yaw) p + offset) + t
+    const double rad = pose.yaw * CV_PI / 180.0;
+    const double cosA = std::cos(rad);
+    const double sinA = std::sin(rad);
+    TrajectoryPoint result = pose;
+    result.x += cosA * mount.x - sinA * mount.y;
+    result.y += sinA * mount.x + cosA * mount.y;
+    result.yaw += mount.yaw;
+    return result;
+}
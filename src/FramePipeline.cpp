@@ -0,0 +1,697 @@
+#include "FramePipeline.hpp"
+#include "PoseTransform.hpp"
+#include "Profiler.hpp"
+#include "ProjectionLut.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+struct FramePipeline::Frame {
+    std::size_t seq = 0;             // порядковый номер кадра после сортировки (переупорядочивания)
+    std::size_t view = 0;            // камера кадра (номер в установке)
+    std::string path;
+    double timestamp = 0.0;
+    cv::Mat image;
+    TrajectoryPoint pose{};
+    bool poseKnown = false;          // поза уже найдена планировщиком
+    float scale = 1.0f;              // вес кадра (PipelineConfig::motion)
+    bool valid = true;               // false — кадр пропускается, но сохраняет свой номер
+    bool accumulated = false;        // точки уже добавлены в карту потоком проекции
+    std::vector<cv::Point2f> points; // мировые точки кадра
+    std::vector<std::uint8_t> labels; // метки точек (если карта ведёт слои по меткам)
+    std::vector<float> weights;      // веса точек в режиме splatting (площадь следа в ячейках)
+    std::size_t hits = 0;            // точки с метками из PipelineConfig::labels
+    cv::Point2f footprint[4];        // след кадра в мировой системе (слой occupancy)
+    bool hasFootprint = false;
+    MaskSignature signature;         // сигнатура маски (PipelineConfig::cullRepeatedMasks)
+    bool hasSignature = false;
+};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::uint64_t elapsedNs(Clock::time_point start) {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+void atomicMax(std::atomic<std::uint64_t>& target, std::uint64_t value) {
+    std::uint64_t current = target.load(std::memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// Путь папки без завершающего разделителя: "a/b/" и "a/b" совпадают
+std::string normalizedFolder(const std::string& folder) {
+    std::filesystem::path p = std::filesystem::path(folder).lexically_normal();
+    if (p.filename().empty() && p.has_parent_path() && p != p.root_path())
+        p = p.parent_path();
+    return p.string();
+}
+
+} // namespace
+
+double FramePipeline::extractTimestamp(const std::string& filename) {
+    std::filesystem::path p(filename);
+    std::string stem = p.stem().string(); // например, "16363.segm"
+    std::istringstream iss(stem);
+    double ts = 0.0;
+    iss >> ts;
+    return ts / 1000;
+}
+
+FramePipeline::FramePipeline(Camera& camera, const TrajectoryReader& trajectory,
+                             GlobalGridMapHandler& map, const PipelineConfig& config)
+    : FramePipeline({View{&camera, CameraMount(), std::string(), config.lutCacheFile}}, map, config) {
+    trajectory_ = &trajectory;
+}
+
+FramePipeline::FramePipeline(Camera& camera, TrajectoryStream& trajectory,
+                             GlobalGridMapHandler& map, const PipelineConfig& config)
+    : FramePipeline({View{&camera, CameraMount(), std::string(), config.lutCacheFile}}, map, config) {
+    poseStream_ = &trajectory;
+}
+
+FramePipeline::FramePipeline(CameraRig& rig, const TrajectoryReader& trajectory,
+                             GlobalGridMapHandler& map, const PipelineConfig& config)
+    : FramePipeline(rigViews(rig), map, config) {
+    trajectory_ = &trajectory;
+}
+
+FramePipeline::FramePipeline(CameraRig& rig, TrajectoryStream& trajectory,
+                             GlobalGridMapHandler& map, const PipelineConfig& config)
+    : FramePipeline(rigViews(rig), map, config) {
+    poseStream_ = &trajectory;
+}
+
+FramePipeline::FramePipeline(std::vector<View> views, GlobalGridMapHandler& map, const PipelineConfig& config)
+    : views_(std::move(views)),
+      map_(map),
+      config_(config),
+      // Одновременно в обработке не больше кадров, чем помещается в очереди
+      frameSource_(config.frameDecode, 4 * config.queueCapacity),
+      extractor_(config.labels),
+      scheduler_(config.motion),
+      decodeQueue_(config.queueCapacity),
+      poseQueue_(config.queueCapacity),
+      projectQueue_(config.queueCapacity),
+      accumulateQueue_(config.queueCapacity) {
+    config_.decodeThreads = std::max(1, config_.decodeThreads);
+    config_.poseThreads = std::max(1, config_.poseThreads);
+    config_.projectionThreads = std::max(1, config_.projectionThreads);
+    lastSignature_.resize(views_.size());
+    hasSignature_.assign(views_.size(), false);
+
+    stages_[SCAN].name = "scan";
+    stages_[DECODE].name = "decode";
+    stages_[POSE].name = "pose";
+    stages_[PROJECT].name = "project";
+    stages_[ACCUMULATE].name = "accumulate";
+}
+
+FramePipeline::~FramePipeline() = default;
+
+std::vector<FramePipeline::View> FramePipeline::rigViews(CameraRig& rig) {
+    std::vector<View> views;
+    for (std::size_t i = 0; i < rig.size(); i++) {
+        RigCamera& member = rig[i];
+        views.push_back({&member.camera, member.mount, normalizedFolder(member.segFolder), member.lutCacheFile});
+    }
+    return views;
+}
+
+int FramePipeline::viewOf(const std::string& path) const {
+    if (views_.size() == 1)
+        return 0;
+    const std::string folder = normalizedFolder(std::filesystem::path(path).parent_path().string());
+    for (std::size_t i = 0; i < views_.size(); i++) {
+        if (views_[i].segFolder == folder)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool FramePipeline::checkLayers() const {
+    const MapLayers& layers = map_.getLayers();
+    if (!layers.needsLabels())
+        return true;
+    // Со слоями по меткам тепло считает карта по heatLabels, а число попаданий и
+    // сигнатуру маски — конвейер по labels: разные наборы дали бы разные классы
+    std::vector<std::uint8_t> heat = layers.heatLabels;
+    std::vector<std::uint8_t> hits = extractor_.getLabels();
+    std::sort(heat.begin(), heat.end());
+    heat.erase(std::unique(heat.begin(), heat.end()), heat.end());
+    std::sort(hits.begin(), hits.end());
+    hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+    if (heat != hits) {
+        std::cerr << "Метки PipelineConfig::labels не совпадают с MapLayers::heatLabels карты\n";
+        return false;
+    }
+    if (config_.splatting) {
+        std::cerr << "PipelineConfig::splatting не поддерживается для карты со слоями по меткам\n";
+        return false;
+    }
+    return true;
+}
+
+bool FramePipeline::run(const std::string& segFolder) {
+    if (!checkLayers())
+        return false;
+    if (views_.size() != 1) {
+        std::cerr << "Папка кадров задана для одной камеры, а в установке их " << views_.size() << "\n";
+        return false;
+    }
+    if (!std::filesystem::is_directory(segFolder)) {
+        std::cerr << "Папка не найдена: " << segFolder << "\n";
+        return false;
+    }
+
+    const std::vector<std::pair<std::size_t, std::string>> folders{{0, segFolder}};
+    runStages([this, &folders] { scanStage(folders); });
+    return true;
+}
+
+bool FramePipeline::run() {
+    if (!checkLayers())
+        return false;
+    std::vector<std::pair<std::size_t, std::string>> folders;
+    for (std::size_t i = 0; i < views_.size(); i++) {
+        if (views_[i].segFolder.empty() || !std::filesystem::is_directory(views_[i].segFolder)) {
+            std::cerr << "Папка кадров камеры " << i << " не найдена: " << views_[i].segFolder << "\n";
+            return false;
+        }
+        folders.emplace_back(i, views_[i].segFolder);
+    }
+    if (folders.empty()) {
+        std::cerr << "В установке нет камер\n";
+        return false;
+    }
+
+    runStages([this, &folders] { scanStage(folders); });
+    return true;
+}
+
+bool FramePipeline::run(FrameStream& stream) {
+    if (!checkLayers())
+        return false;
+    runStages([this, &stream] { streamStage(stream); });
+    return true;
+}
+
+void FramePipeline::runStages(const std::function<void()>& producer) {
+    // Очереди закрываются в конце прогона; к этому моменту они пусты, и следующий run() открывает их снова
+    decodeQueue_.reopen();
+    poseQueue_.reopen();
+    projectQueue_.reopen();
+    accumulateQueue_.reopen();
+    stages_[DECODE].activeWorkers = config_.decodeThreads;
+    stages_[POSE].activeWorkers = config_.poseThreads;
+    stages_[PROJECT].activeWorkers = config_.projectionThreads;
+
+    std::vector<std::thread> threads;
+    threads.emplace_back(producer);
+    for (int i = 0; i < config_.decodeThreads; i++)
+        threads.emplace_back(&FramePipeline::decodeWorker, this);
+    for (int i = 0; i < config_.poseThreads; i++)
+        threads.emplace_back(&FramePipeline::poseWorker, this);
+    for (int i = 0; i < config_.projectionThreads; i++)
+        threads.emplace_back(&FramePipeline::projectionWorker, this);
+
+    // Накопление выполняется в вызывающем потоке
+    accumulateStage();
+
+    for (auto& t : threads)
+        t.join();
+}
+
+void FramePipeline::record(StageId id, std::uint64_t ns) {
+    Stage& stage = stages_[id];
+    stage.processed.fetch_add(1, std::memory_order_relaxed);
+    stage.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    atomicMax(stage.maxNs, ns);
+}
+
+void FramePipeline::observeDepth(StageId id, std::size_t depth) {
+    std::atomic<std::size_t>& maxDepth = stages_[id].maxDepth;
+    std::size_t current = maxDepth.load(std::memory_order_relaxed);
+    while (current < depth && !maxDepth.compare_exchange_weak(current, depth, std::memory_order_relaxed)) {
+    }
+}
+
+void FramePipeline::finishWorker(StageId id, BoundedQueue<FramePtr>& out) {
+    if (stages_[id].activeWorkers.fetch_sub(1) == 1)
+        out.close();
+}
+
+void FramePipeline::scanStage(const std::vector<std::pair<std::size_t, std::string>>& folders) {
+    auto start = Clock::now();
+
+    // Время извлекается из имени один раз на файл, а не в компараторе сортировки.
+    // Кадры камер сливаются по времени: соседние по времени кадры пишут в одни квадранты
+    std::vector<std::tuple<double, std::size_t, std::string>> files;
+    for (const auto& folder : folders) {
+        for (const auto& entry : std::filesystem::directory_iterator(folder.second)) {
+            if (entry.is_regular_file()) {
+                std::string path = entry.path().string();
+                files.emplace_back(extractTimestamp(path), folder.first, std::move(path));
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
+    record(SCAN, elapsedNs(start));
+
+    std::optional<TrajectoryReader::Cursor> cursor;
+    if (trajectory_)
+        cursor.emplace(*trajectory_);
+    std::size_t seq = 0;
+    for (std::size_t i = 0; i < files.size(); i++) {
+        auto frame = std::make_unique<Frame>();
+        frame->timestamp = std::get<0>(files[i]);
+        frame->view = std::get<1>(files[i]);
+        frame->path = std::move(std::get<2>(files[i]));
+        if (!scheduleFrame(*frame, cursor ? &*cursor : nullptr))
+            continue;
+        frame->seq = seq++;
+        decodeQueue_.push(std::move(frame));
+    }
+    decodeQueue_.close();
+}
+
+void FramePipeline::streamStage(FrameStream& stream) {
+    struct Pending {
+        double timestamp;
+        std::size_t view;
+        Clock::time_point arrival;
+        std::string path;
+    };
+    // При равном времени первым идёт кадр камеры с меньшим номером
+    auto later = [](const Pending& a, const Pending& b) {
+        return a.timestamp > b.timestamp || (a.timestamp == b.timestamp && a.view > b.view);
+    };
+    std::priority_queue<Pending, std::vector<Pending>, decltype(later)> pending(later);
+
+    const auto window = std::chrono::duration<double>(std::max(0.0, config_.reorderWindow));
+    const std::size_t capacity = std::max<std::size_t>(1, config_.reorderCapacity);
+    double newest = -std::numeric_limits<double>::infinity();   // новейшее пришедшее время
+    double released = -std::numeric_limits<double>::infinity(); // новейшее отданное время
+    std::size_t seq = 0;
+    // Позы для планировщика: курсор по загруженной траектории, если конвейер построен из неё
+    std::optional<TrajectoryReader::Cursor> cursor;
+    if (trajectory_)
+        cursor.emplace(*trajectory_);
+
+    auto release = [&] {
+        Pending next = pending.top();
+        pending.pop();
+        // Поза для такого кадра могла быть уже забыта (см. accumulateStage)
+        if (next.timestamp < released - window.count()) {
+            std::cerr << "Кадр опоздал больше окна переупорядочивания и пропущен: " << next.path << "\n";
+            return;
+        }
+        released = std::max(released, next.timestamp);
+        auto frame = std::make_unique<Frame>();
+        frame->timestamp = next.timestamp;
+        frame->view = next.view;
+        frame->path = std::move(next.path);
+        if (!scheduleFrame(*frame, cursor ? &*cursor : nullptr))
+            return;
+        frame->seq = seq++;
+        decodeQueue_.push(std::move(frame));
+    };
+
+    Clock::time_point lastArrival = Clock::now();
+    std::string path;
+    for (;;) {
+        // Кадр, дольше окна ждущий более ранних, отдаётся без них
+        Clock::time_point now = Clock::now();
+        while (!pending.empty() && now - pending.top().arrival >= window)
+            release();
+
+        double wait = 0.25;
+        if (!pending.empty())
+            wait = std::min(wait, (window - (now - pending.top().arrival)).count());
+        const FrameStream::Status status = stream.next(path, wait);
+        if (status == FrameStream::Status::End)
+            break;
+        if (status == FrameStream::Status::Timeout) {
+            if (config_.streamIdleTimeout > 0.0 &&
+                std::chrono::duration<double>(Clock::now() - lastArrival).count() >= config_.streamIdleTimeout) {
+                std::cerr << "Кадры не поступали " << config_.streamIdleTimeout << " с, поток завершён\n";
+                break;
+            }
+            continue;
+        }
+
+        auto start = Clock::now();
+        lastArrival = start;
+        const int view = viewOf(path);
+        if (view < 0) {
+            std::cerr << "Кадр не из папки ни одной камеры установки, пропущен: " << path << "\n";
+            continue;
+        }
+        const double ts = extractTimestamp(path);
+        newest = std::max(newest, ts);
+        pending.push({ts, static_cast<std::size_t>(view), start, std::move(path)});
+        while (!pending.empty() &&
+               (pending.top().timestamp <= newest - window.count() || pending.size() > capacity))
+            release();
+        record(SCAN, elapsedNs(start));
+    }
+
+    while (!pending.empty())
+        release();
+    decodeQueue_.close();
+}
+
+void FramePipeline::decodeWorker() {
+    FramePtr frame;
+    while (decodeQueue_.pop(frame)) {
+        observeDepth(DECODE, decodeQueue_.size());
+        auto start = Clock::now();
+        decodeFrame(*frame);
+        record(DECODE, elapsedNs(start));
+        poseQueue_.push(std::move(frame));
+    }
+    finishWorker(DECODE, poseQueue_);
+}
+
+void FramePipeline::poseWorker() {
+    // Кадры приходят почти по порядку времени, поэтому курсор ищет от предыдущей позы
+    std::optional<TrajectoryReader::Cursor> cursor;
+    if (trajectory_)
+        cursor.emplace(*trajectory_);
+    FramePtr frame;
+    while (poseQueue_.pop(frame)) {
+        observeDepth(POSE, poseQueue_.size());
+        auto start = Clock::now();
+        associatePose(*frame, cursor ? &*cursor : nullptr);
+        record(POSE, elapsedNs(start));
+        projectQueue_.push(std::move(frame));
+    }
+    finishWorker(POSE, projectQueue_);
+}
+
+void FramePipeline::projectionWorker() {
+    FramePtr frame;
+    while (projectQueue_.pop(frame)) {
+        observeDepth(PROJECT, projectQueue_.size());
+        auto start = Clock::now();
+        projectFrame(*frame);
+        record(PROJECT, elapsedNs(start));
+        if (!config_.orderedAccumulation)
+            accumulateConcurrent(*frame);
+        accumulateQueue_.push(std::move(frame));
+    }
+    finishWorker(PROJECT, accumulateQueue_);
+}
+
+void FramePipeline::accumulateStage() {
+    // Кадры приходят в произвольном порядке; буфер переупорядочивания
+    // ограничен числом кадров, находящихся в очередях и потоках
+    std::map<std::size_t, FramePtr> pending;
+    std::size_t nextSeq = 0;
+
+    FramePtr frame;
+    while (accumulateQueue_.pop(frame)) {
+        observeDepth(ACCUMULATE, accumulateQueue_.size());
+        std::size_t seq = frame->seq;
+        pending.emplace(seq, std::move(frame));
+        for (auto it = pending.begin(); it != pending.end() && it->first == nextSeq;
+             it = pending.erase(it), nextSeq++) {
+            // Кадры с большими номерами не старше этого больше чем на окно
+            // переупорядочивания (более поздние отбрасывает streamStage)
+            if (poseStream_)
+                poseStream_->discardBefore(it->second->timestamp - config_.reorderWindow);
+            if (it->second->accumulated) {
+                accumulateFrame(*it->second); // только журнал кадра
+                continue;
+            }
+            auto start = Clock::now();
+            accumulateFrame(*it->second);
+            record(ACCUMULATE, elapsedNs(start));
+        }
+    }
+}
+
+bool FramePipeline::lookupPose(double time, TrajectoryPoint& pose, TrajectoryReader::Cursor* cursor) const {
+    // Проба здесь, а не в стадии поз: при активном планировщике поза ищется ещё до декодирования
+    PROFILE_SCOPE(Pose);
+    if (poseStream_)
+        return config_.interpolatePose ? poseStream_->interpolate(time, pose, config_.poseTimeout)
+                                       : poseStream_->closest(time, pose, config_.poseTimeout);
+    return config_.interpolatePose ? cursor->interpolate(time, pose) : cursor->closest(time, pose);
+}
+
+bool FramePipeline::scheduleFrame(Frame& frame, TrajectoryReader::Cursor* cursor) {
+    if (!scheduler_.active())
+        return true;
+    // Кадр без позы не отбрасывается здесь: об отсутствии данных сообщит стадия поз
+    if (!lookupPose(frame.timestamp, frame.pose, cursor))
+        return true;
+    frame.poseKnown = true;
+    frame.scale = scheduler_.admit(frame.view, frame.timestamp, frame.pose);
+    if (frame.scale <= 0.0f) {
+        framesSkipped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (frame.scale < 1.0f)
+        framesWeighted_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void FramePipeline::decodeFrame(Frame& frame) {
+    if (!frameSource_.decode(frame.path, frame.image)) {
+        std::cerr << "Не удалось загрузить изображение: " << frame.path << "\n";
+        frame.valid = false;
+    }
+}
+
+void FramePipeline::associatePose(Frame& frame, TrajectoryReader::Cursor* cursor) {
+    if (!frame.valid || frame.poseKnown)
+        return;
+    if (!lookupPose(frame.timestamp, frame.pose, cursor)) {
+        std::cerr << "Нет данных траектории для timestamp " << frame.timestamp << "\n";
+        frame.valid = false;
+    }
+}
+
+void FramePipeline::projectFrame(Frame& frame) {
+    if (!frame.valid)
+        return;
+    PROFILE_SCOPE(Projection);
+    const cv::Mat& segImg = frame.image;
+    const int top = static_cast<int>(segImg.rows * config_.roiTopFraction);
+    const cv::Rect roi(0, top, segImg.cols, segImg.rows - top);
+
+    const View& view = views_[frame.view];
+    Camera& camera = *view.camera;
+    std::shared_lock<std::shared_mutex> lock(lutMutex_);
+    const ProjectionLut* lut = camera.getLut();
+    if (!lut || lut->imageSize() != segImg.size() || lut->roi() != roi) {
+        lock.unlock();
+        {
+            std::unique_lock<std::shared_mutex> writeLock(lutMutex_);
+            lut = camera.getLut();
+            if ((!lut || lut->imageSize() != segImg.size() || lut->roi() != roi) &&
+                !camera.prepareLut(segImg.size(), roi, view.lutCacheFile)) {
+                std::cerr << "Не удалось подготовить таблицу проекции для " << frame.path << "\n";
+                frame.valid = false;
+                return;
+            }
+        }
+        lock.lock();
+        lut = camera.getLut();
+    }
+    projectedFrames_.fetch_add(1, std::memory_order_relaxed);
+    projectedPixels_.fetch_add(static_cast<std::uint64_t>(roi.area()), std::memory_order_relaxed);
+    // Сигнатуру сравнивает стадия накопления, которая видит кадры по порядку
+    frame.hasSignature = config_.cullRepeatedMasks && config_.orderedAccumulation;
+
+    if (map_.getLayers().needsLabels()) {
+        // Слоям наблюдений нужны все пиксели ROI вместе с метками
+        thread_local std::vector<std::uint8_t> scratch;
+        frame.points.resize(static_cast<std::size_t>(roi.width) * roi.height);
+        frame.labels.resize(frame.points.size());
+        std::size_t k = 0;
+        frame.hits = 0;
+        for (int r = roi.y; r < roi.y + roi.height; r++) {
+            const std::uint8_t* labels = MaskExtractor::rowLabels(segImg, r, roi, scratch);
+            const cv::Point2f* lutRow = &lut->at(r, roi.x);
+            for (int c = 0; c < roi.width; c++, k++) {
+                frame.points[k] = lutRow[c];
+                frame.labels[k] = labels[c];
+                if (extractor_.accepts(labels[c])) {
+                    frame.hits++;
+                    if (frame.hasSignature)
+                        frame.signature.add(r, roi.x + c, roi);
+                }
+            }
+        }
+    } else {
+        // Пиксели нужных классов, затем их точки из таблицы проекции
+        thread_local std::vector<MaskPixel> pixels;
+        extractor_.extract(segImg, roi, pixels);
+        frame.points.resize(pixels.size());
+        for (std::size_t k = 0; k < pixels.size(); k++)
+            frame.points[k] = lut->at(pixels[k].row, pixels[k].col);
+        frame.hits = pixels.size();
+        if (frame.hasSignature)
+            frame.signature.build(pixels, roi);
+        if (config_.splatting) {
+            const double resolution = map_.getResolution();
+            const float invCellArea = static_cast<float>(1.0 / (resolution * resolution));
+            frame.weights.resize(pixels.size());
+            for (std::size_t k = 0; k < pixels.size(); k++)
+                frame.weights[k] = std::min(lut->area(pixels[k].row, pixels[k].col) * invCellArea,
+                                            config_.maxSplatCells);
+        }
+    }
+    lock.unlock();
+
+    // Поза кадра — поза вагона, сдвинутая и повёрнутая на установку камеры
+    const TrajectoryPoint pose = CameraRig::cameraPose(frame.pose, view.mount);
+    PoseTransform toWorld(pose.x, pose.y, pose.yaw, config_.mirrorX);
+    toWorld.apply(frame.points.data(), frame.points.data(), frame.points.size());
+
+    if (map_.getLayers().occupancy) {
+        // Без следа (нижний край ROI за горизонтом или дальше footprintRange)
+        // кадр просто не даёт свидетельств свободы
+        frame.hasFootprint = camera.projectFootprint(roi, frame.footprint,
+                                                     static_cast<float>(config_.footprintRange));
+        if (frame.hasFootprint)
+            toWorld.apply(frame.footprint, frame.footprint, 4);
+    }
+
+    // Изображение больше не нужно — буфер возвращается в пул до стадии накопления
+    frameSource_.recycle(frame.image);
+}
+
+void FramePipeline::accumulateFrame(Frame& frame) {
+    if (!frame.valid)
+        return;
+    if (config_.logFrames) {
+        std::clog << frame.path << "\n"
+                  << frame.timestamp << ' ' << frame.pose.x << ' ' << frame.pose.y
+                  << ", " << frame.pose.yaw << "\n";
+    }
+    // Окно онлайн-режима следует за позой в порядке кадров
+    map_.updatePose(frame.pose.x, frame.pose.y);
+    if (frame.accumulated)
+        return;
+    if (frame.hasSignature) {
+        // Стоящий вагон: маска почти та же, что у последнего добавленного кадра камеры
+        if (hasSignature_[frame.view] &&
+            frame.signature.similar(lastSignature_[frame.view], config_.repeatedMaskTolerance)) {
+            framesCulled_.fetch_add(1, std::memory_order_relaxed);
+            pointsCulled_.fetch_add(frame.hits, std::memory_order_relaxed);
+            return;
+        }
+        lastSignature_[frame.view] = frame.signature;
+        hasSignature_[frame.view] = true;
+    }
+    const float value = config_.pointValue * frame.scale;
+    if (!frame.weights.empty())
+        map_.addSplats(frame.points.data(), frame.weights.data(), frame.points.size(), value);
+    else if (frame.labels.empty())
+        map_.addPoints(frame.points.data(), frame.points.size(), value);
+    else
+        map_.addObservations(frame.points.data(), frame.labels.data(), frame.points.size(),
+                             value, frame.timestamp);
+    if (frame.hasFootprint)
+        map_.updateOccupancy(frame.footprint, 4, frame.points.data(),
+                             frame.labels.empty() ? nullptr : frame.labels.data(), frame.points.size());
+    totalPoints_.fetch_add(frame.hits, std::memory_order_relaxed);
+    PROFILE_COUNT(Frames, 1);
+}
+
+void FramePipeline::accumulateConcurrent(Frame& frame) {
+    if (!frame.valid)
+        return;
+    auto start = Clock::now();
+    // Окно онлайн-режима не сдвигается отсюда: кадры приходят не по порядку и качали бы
+    // его туда и обратно. Его сдвигает accumulateFrame; точки вне окна идут прямо в квадранты
+    const float value = config_.pointValue * frame.scale;
+    if (!frame.weights.empty())
+        map_.addSplatsConcurrent(frame.points.data(), frame.weights.data(), frame.points.size(), value);
+    else if (frame.labels.empty())
+        map_.addPointsConcurrent(frame.points.data(), frame.points.size(), value);
+    else
+        map_.addObservationsConcurrent(frame.points.data(), frame.labels.data(), frame.points.size(),
+                                       value, frame.timestamp);
+    if (frame.hasFootprint)
+        map_.updateOccupancyConcurrent(frame.footprint, 4, frame.points.data(),
+                                       frame.labels.empty() ? nullptr : frame.labels.data(), frame.points.size());
+    record(ACCUMULATE, elapsedNs(start));
+    totalPoints_.fetch_add(frame.hits, std::memory_order_relaxed);
+    PROFILE_COUNT(Frames, 1);
+    frame.accumulated = true;
+    frame.points.clear();
+    frame.points.shrink_to_fit();
+    frame.labels.clear();
+    frame.labels.shrink_to_fit();
+    frame.weights.clear();
+    frame.weights.shrink_to_fit();
+}
+
+std::vector<StageStats> FramePipeline::getStats() const {
+    const BoundedQueue<FramePtr>* inputs[STAGE_COUNT] = {
+        nullptr, &decodeQueue_, &poseQueue_, &projectQueue_, &accumulateQueue_};
+
+    std::vector<StageStats> stats;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const Stage& stage = stages_[i];
+        StageStats s;
+        s.name = stage.name;
+        s.queueDepth = inputs[i] ? inputs[i]->size() : 0;
+        s.maxQueueDepth = stage.maxDepth.load();
+        s.processed = stage.processed.load();
+        s.totalSeconds = stage.totalNs.load() * 1e-9;
+        s.maxSeconds = stage.maxNs.load() * 1e-9;
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+ScheduleStats FramePipeline::getScheduleStats() const {
+    ScheduleStats stats;
+    stats.framesSkipped = framesSkipped_.load();
+    stats.framesWeighted = framesWeighted_.load();
+    stats.framesCulled = framesCulled_.load();
+    stats.pointsCulled = pointsCulled_.load();
+    // Пропущенные кадры не декодировались: их ROI оценивается по обработанным
+    const std::uint64_t projected = projectedFrames_.load();
+    stats.pixelsSkipped = projected ? stats.framesSkipped * (projectedPixels_.load() / projected) : 0;
+    return stats;
+}
+
+void FramePipeline::printStats(std::ostream& os) const {
+    os << std::left << std::setw(12) << "стадия" << std::right
+       << std::setw(10) << "очередь" << std::setw(10) << "макс"
+       << std::setw(10) << "кадров" << std::setw(14) << "сред, мс" << std::setw(14) << "макс, мс" << "\n";
+    for (const StageStats& s : getStats()) {
+        double meanMs = s.processed ? s.totalSeconds / s.processed * 1e3 : 0.0;
+        os << std::left << std::setw(12) << s.name << std::right
+           << std::setw(10) << s.queueDepth << std::setw(10) << s.maxQueueDepth
+           << std::setw(10) << s.processed
+           << std::setw(14) << std::fixed << std::setprecision(3) << meanMs
+           << std::setw(14) << s.maxSeconds * 1e3 << "\n";
+    }
+    if (config_.motion.policy != MotionPolicy::Keep || config_.cullRepeatedMasks) {
+        const ScheduleStats schedule = getScheduleStats();
+        os << "отбор кадров: пропущено " << schedule.framesSkipped << " (~" << schedule.pixelsSkipped
+           << " пикс), с уменьшенным весом " << schedule.framesWeighted << ", повторных масок "
+           << schedule.framesCulled << " (" << schedule.pointsCulled << " точек)\n";
+    }
+}
@@ -0,0 +1,70 @@
+#include "FrameScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Разность углов в градусах, приведённая к [0, 180]
+double yawDelta(double a, double b) {
+    double d = std::fmod(std::fabs(a - b), 360.0);
+    return d > 180.0 ? 360.0 - d : d;
+}
+
+} // namespace
+
+void MaskSignature::build(const std::vector<MaskPixel>& pixels, const cv::Rect& roi) {
+    counts.fill(0);
+    total = 0;
+    if (roi.width <= 0 || roi.height <= 0)
+        return;
+    for (const MaskPixel& p : pixels)
+        add(p.row, p.col, roi);
+}
+
+bool MaskSignature::similar(const MaskSignature& other, double tolerance) const {
+    std::uint64_t diff = 0;
+    for (std::size_t k = 0; k < counts.size(); k++)
+        diff += counts[k] > other.counts[k] ? counts[k] - other.counts[k] : other.counts[k] - counts[k];
+    return static_cast<double>(diff) <= tolerance * static_cast<double>(std::max(total, other.total));
+}
+
+FrameScheduler::FrameScheduler(const MotionSchedule& schedule) : schedule_(schedule) {}
+
+float FrameScheduler::admit(std::size_t view, double timestamp, const TrajectoryPoint& pose) {
+    if (schedule_.policy == MotionPolicy::Keep)
+        return 1.0f;
+    if (view >= last_.size())
+        last_.resize(view + 1);
+    Last& last = last_[view];
+    if (!last.valid) {
+        last = {true, timestamp, pose};
+        return 1.0f;
+    }
+
+    const double distance = std::hypot(pose.x - last.pose.x, pose.y - last.pose.y);
+    const double yaw = yawDelta(pose.yaw, last.pose.yaw);
+    // Доля порога, пройденная с опорного кадра: 1 — кадр берётся полностью
+    double moved = 0.0;
+    if (schedule_.minDistance > 0.0)
+        moved = std::max(moved, distance / schedule_.minDistance);
+    if (schedule_.minYaw > 0.0)
+        moved = std::max(moved, yaw / schedule_.minYaw);
+    if (schedule_.minDistance <= 0.0 && schedule_.minYaw <= 0.0)
+        moved = 1.0;
+
+    if (schedule_.policy == MotionPolicy::Weight) {
+        // Сдвиг считается от последнего взятого кадра, поэтому суммарный вклад
+        // кадров пропорционален пройденному пути и на остановке не растёт
+        if (moved < schedule_.minWeight)
+            return 0.0f;
+        last = {true, timestamp, pose};
+        return static_cast<float>(std::min(moved, 1.0));
+    }
+
+    const bool overdue = schedule_.maxInterval > 0.0 && timestamp - last.time >= schedule_.maxInterval;
+    if (moved < 1.0 && !overdue)
+        return 0.0f;
+    last = {true, timestamp, pose};
+    return 1.0f;
+}
@@ -0,0 +1,141 @@
+#include "FrameSource.hpp"
+#include "Profiler.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr char RAW_MAGIC[4] = {'M', 'B', 'L', 'B'};
+constexpr std::uint32_t RAW_VERSION = 1;
+
+// Заголовок сырых меток; за ним height строк по width байт
+struct RawLabelHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t width;
+    std::int32_t height;
+};
+
+bool hasExtension(const std::string& path, const char* extension) {
+    const std::size_t n = std::strlen(extension);
+    return path.size() >= n && path.compare(path.size() - n, n, extension) == 0;
+}
+
+// Читает файл целиком в буфер, сохраняя его ёмкость между вызовами
+bool readFile(const std::string& path, std::vector<uchar>& buffer) {
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+    if (!ifs)
+        return false;
+    const std::streamsize size = ifs.tellg();
+    if (size <= 0)
+        return false;
+    buffer.resize(static_cast<std::size_t>(size));
+    ifs.seekg(0);
+    return static_cast<bool>(ifs.read(reinterpret_cast<char*>(buffer.data()), size));
+}
+
+} // namespace
+
+cv::Mat FrameBufferPool::acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.empty())
+        return cv::Mat();
+    cv::Mat frame = std::move(free_.back());
+    free_.pop_back();
+    return frame;
+}
+
+void FrameBufferPool::release(cv::Mat& frame) {
+    if (frame.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < capacity_) {
+            free_.push_back(frame);
+        }
+    }
+    frame.release();
+}
+
+FrameSource::FrameSource(FrameDecode mode, std::size_t poolCapacity)
+    : mode_(mode), pool_(poolCapacity) {}
+
+bool FrameSource::decode(const std::string& path, cv::Mat& frame) {
+    PROFILE_SCOPE(Decode);
+    frame = pool_.acquire();
+    if (hasExtension(path, RAW_EXTENSION))
+        return readRaw(path, frame);
+
+    // Сжатый файл читается в буфер потока, декодер пишет прямо в буфер из пула
+    thread_local std::vector<uchar> encoded;
+    if (!readFile(path, encoded))
+        return false;
+    int flags = cv::IMREAD_UNCHANGED;
+    if (mode_ == FrameDecode::Grayscale)
+        flags = cv::IMREAD_GRAYSCALE;
+    else if (mode_ == FrameDecode::Color)
+        flags = cv::IMREAD_COLOR;
+    cv::imdecode(cv::Mat(1, static_cast<int>(encoded.size()), CV_8UC1, encoded.data()), flags, &frame);
+    if (frame.empty())
+        return false;
+
+    if (frame.depth() != CV_8U) {
+        // 16-битные метки: значения классов помещаются в 8 бит
+        cv::Mat labels;
+        frame.convertTo(labels, CV_8U);
+        frame = labels;
+    }
+    if (frame.channels() == 4) {
+        // Альфа-канал не несёт метки: оставляем BGR
+        cv::Mat bgr;
+        cv::cvtColor(frame, bgr, cv::COLOR_BGRA2BGR);
+        frame = bgr;
+    }
+    return frame.channels() == 1 || frame.channels() == 3;
+}
+
+bool FrameSource::readRaw(const std::string& path, cv::Mat& frame) {
+    std::ifstream ifs(path, std::ios::binary);
+    RawLabelHeader header{};
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC)) != 0 ||
+        header.version != RAW_VERSION || header.width <= 0 || header.height <= 0) {
+        std::cerr << "Неверный формат файла меток: " << path << "\n";
+        return false;
+    }
+    // create не выделяет память, если буфер из пула уже нужного размера
+    frame.create(header.height, header.width, CV_8UC1);
+    for (int r = 0; r < frame.rows; r++) {
+        if (!ifs.read(reinterpret_cast<char*>(frame.ptr<uchar>(r)), frame.cols)) {
+            std::cerr << "Файл меток обрезан: " << path << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FrameSource::writeRaw(const std::string& path, const cv::Mat& labels) {
+    if (labels.type() != CV_8UC1 || labels.empty()) {
+        std::cerr << "Сырые метки должны быть CV_8UC1: " << path << "\n";
+        return false;
+    }
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    RawLabelHeader header{};
+    std::memcpy(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC));
+    header.version = RAW_VERSION;
+    header.width = labels.cols;
+    header.height = labels.rows;
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int r = 0; r < labels.rows; r++)
+        ofs.write(reinterpret_cast<const char*>(labels.ptr<uchar>(r)), labels.cols);
+    if (!ofs) {
+        std::cerr << "Не удалось записать файл меток: " << path << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,183 @@
+#include "FrameStream.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Ожидание разбивается на шаги, чтобы close() из другого потока срабатывал быстро
+constexpr int POLL_MS = 50;
+
+// Время кадра из имени файла ("16363.segm.png" -> 16363), как в FramePipeline::extractTimestamp
+double nameTime(const std::filesystem::path& path) {
+    return std::strtod(path.stem().string().c_str(), nullptr);
+}
+
+} // namespace
+
+FrameStream::~FrameStream() {
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+bool FrameStream::watchDirectory(const std::string& directory, const std::string& suffix, bool includeExisting) {
+    if (kind_ != Kind::None) {
+        std::cerr << "Источник кадров уже открыт\n";
+        return false;
+    }
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0 || inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "Не удалось следить за папкой: " << directory << "\n";
+        return false;
+    }
+    kind_ = Kind::Directory;
+    directory_ = directory;
+    suffix_ = suffix;
+    if (includeExisting) {
+        // Наблюдение уже установлено: файлы, изменённые после этого момента, придут событиями
+        watchStart_ = std::filesystem::file_time_type::clock::now();
+        // Каталог выдаёт файлы в произвольном порядке, а конвейер отбрасывает кадры,
+        // опоздавшие больше окна переупорядочивания: накопленные файлы сортируются заранее
+        std::vector<std::pair<double, std::string>> files;
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+            const std::filesystem::directory_entry& entry = *it;
+            std::error_code entryEc;
+            if (entry.is_regular_file(entryEc) && accepts(entry.path().filename().string()))
+                files.emplace_back(nameTime(entry.path()), entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        for (auto& file : files)
+            existing_.push_back(std::move(file.second));
+    }
+    return true;
+}
+
+bool FrameStream::openPathList(const std::string& path) {
+    if (kind_ != Kind::None) {
+        std::cerr << "Источник кадров уже открыт\n";
+        return false;
+    }
+    // O_NONBLOCK: открытие FIFO не ждёт писателя
+    fd_ = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "Не удалось открыть список кадров: " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    fifo_ = fstat(fd_, &st) == 0 && S_ISFIFO(st.st_mode);
+    kind_ = Kind::PathList;
+    return true;
+}
+
+bool FrameStream::accepts(const std::string& name) const {
+    return name.size() >= suffix_.size() &&
+           name.compare(name.size() - suffix_.size(), suffix_.size(), suffix_) == 0;
+}
+
+bool FrameStream::nextExisting(std::string& path) {
+    while (!existing_.empty()) {
+        std::string candidate = std::move(existing_.front());
+        existing_.pop_front();
+        // Файлы, записанные после начала наблюдения, выдаст inotify
+        std::error_code ec;
+        if (std::filesystem::last_write_time(candidate, ec) >= watchStart_ || ec)
+            continue;
+        path = std::move(candidate);
+        return true;
+    }
+    return false;
+}
+
+bool FrameStream::readSource() {
+    alignas(inotify_event) char buffer[1 << 16];
+    const ssize_t n = ::read(fd_, buffer, sizeof(buffer));
+    if (n < 0)
+        return errno == EAGAIN || errno == EINTR;
+
+    if (kind_ == Kind::Directory) {
+        for (ssize_t offset = 0; offset < n;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->mask & IN_Q_OVERFLOW)
+                std::cerr << "Переполнена очередь событий папки, часть кадров пропущена: " << directory_ << "\n";
+            if (event->mask & IN_IGNORED)
+                return false; // папку удалили
+            if (event->len == 0 || (event->mask & IN_ISDIR))
+                continue;
+            const std::string name(event->name);
+            if (accepts(name))
+                ready_.push_back(directory_ + "/" + name);
+        }
+        return true;
+    }
+
+    if (n == 0) {
+        if (fifo_) {
+            // Все писатели закрыли FIFO: последняя строка может быть без перевода строки
+            if (!partial_.empty())
+                ready_.push_back(std::move(partial_));
+            partial_.clear();
+            return false;
+        }
+        // Конец файла: ждём, пока его допишут
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+        return true;
+    }
+    partial_.append(buffer, static_cast<std::size_t>(n));
+    std::size_t begin = 0;
+    for (std::size_t nl; (nl = partial_.find('\n', begin)) != std::string::npos; begin = nl + 1) {
+        std::size_t end = nl;
+        if (end > begin && partial_[end - 1] == '\r')
+            end--;
+        if (end > begin)
+            ready_.push_back(partial_.substr(begin, end - begin));
+    }
+    partial_.erase(0, begin);
+    return true;
+}
+
+FrameStream::Status FrameStream::next(std::string& path, double timeout) {
+    if (kind_ == Kind::None)
+        return Status::End;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    for (;;) {
+        if (closed_)
+            return Status::End;
+        if (!ready_.empty()) {
+            path = std::move(ready_.front());
+            ready_.pop_front();
+            return Status::Ready;
+        }
+        if (ended_)
+            return Status::End;
+        // Файлы, уже лежавшие в папке, выдаются раньше событий
+        if (!existing_.empty() && nextExisting(path))
+            return Status::Ready;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return Status::Timeout;
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        pollfd p{fd_, POLLIN, 0};
+        const int ready = ::poll(&p, 1, static_cast<int>(std::min<long long>(left + 1, POLL_MS)));
+        if (ready < 0 && errno != EINTR) {
+            ended_ = true;
+            continue;
+        }
+        if (ready > 0 && !readSource())
+            ended_ = true;
+    }
+}
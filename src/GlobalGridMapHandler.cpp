@@ -1,7 +1,325 @@
 #include "GlobalGridMapHandler.hpp"
+#include "ParallelFor.hpp"
+#include "Profiler.hpp"
+#include "Simd.hpp"
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
+#include <thread>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+constexpr char MAP_MAGIC[8] = {'M', 'B', 'M', 'A', 'P', 0, 0, 0};
+constexpr std::uint32_t MAP_VERSION = 2;
+constexpr std::uint32_t MAP_FLAG_OBSERVATIONS = 1;
+constexpr std::uint32_t MAP_FLAG_LAST_SEEN = 2;
+constexpr std::uint32_t MAP_FLAG_OCCUPANCY = 4;
+constexpr std::uint64_t MAP_PAGE = 4096;
+
+// Заголовок файла карты. Раскладка файла:
+//   [MapFileHeader, дополненный до MAP_PAGE]
+//   [blockCount блоков по TILE_CELLS * stride float] — с dataOffset, по порядку квадрантов
+//   [quadrantCount записей MapQuadrantRecord]        — с quadrantTableOffset
+//   [blockCount записей MapBlockRecord]              — с blockTableOffset
+struct MapFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t tileCells;
+    double quadrantSize;
+    double resolution;
+    std::uint64_t quadrantCount;
+    std::uint64_t blockCount;
+    std::uint64_t dataOffset;
+    std::uint64_t quadrantTableOffset;
+    std::uint64_t blockTableOffset;
+    // Слои (версия 2; в версии 1 здесь нули и слой один — heat)
+    std::uint32_t channels;
+    std::uint32_t stride;
+    std::uint32_t layerFlags;
+    std::uint32_t classCount;
+    std::uint8_t classes[MapLayers::MAX_CHANNELS];
+    double timeOrigin;
+    float logOdds[4]; // hit, miss, min, max слоя occupancy
+};
+static_assert(sizeof(MapFileHeader) == 128, "MapFileHeader должен занимать 128 байт");
+
+struct MapQuadrantRecord {
+    std::int32_t qx;
+    std::int32_t qy;
+    std::int32_t rows;
+    std::int32_t cols;
+    std::uint64_t firstBlock; // индекс первого блока квадранта
+    std::uint64_t blockCount;
+};
+
+struct MapBlockRecord {
+    std::int32_t ti;
+    std::int32_t tj;
+};
+
+// Слои, записанные в заголовке файла карты (heatLabels в файле нет — берутся из heatLabels)
+MapLayers mapFileLayers(const MapFileHeader &header, const std::vector<std::uint8_t> &heatLabels) {
+    // Файл версии 1 содержит только слой heat
+    MapLayers layers;
+    layers.heatLabels = heatLabels;
+    if (header.version >= 2) {
+        layers.classes.assign(header.classes,
+                              header.classes + std::min<std::uint32_t>(header.classCount, MapLayers::MAX_CHANNELS));
+        layers.observations = (header.layerFlags & MAP_FLAG_OBSERVATIONS) != 0;
+        layers.lastSeen = (header.layerFlags & MAP_FLAG_LAST_SEEN) != 0;
+        layers.timeOrigin = header.timeOrigin;
+        layers.occupancy = (header.layerFlags & MAP_FLAG_OCCUPANCY) != 0;
+        if (layers.occupancy) {
+            layers.logOddsHit = header.logOdds[0];
+            layers.logOddsMiss = header.logOdds[1];
+            layers.logOddsMin = header.logOdds[2];
+            layers.logOddsMax = header.logOdds[3];
+        }
+    }
+    return layers;
+}
+
+// Заголовок, блоки (по blockBytes) и таблицы отображённого файла карты лежат внутри файла
+bool mapFileIntact(const MappedFile &file, std::uint64_t blockBytes) {
+    const std::uint64_t fileSize = file.size();
+    if (fileSize < MAP_PAGE)
+        return false;
+    const MapFileHeader *header = reinterpret_cast<const MapFileHeader *>(file.data());
+    // count записей по size байт с offset помещаются в файл; сравнение делением,
+    // чтобы суммы из повреждённого заголовка не переполнялись
+    auto fits = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t size) {
+        return offset <= fileSize && count <= (fileSize - offset) / size;
+    };
+    return std::memcmp(header->magic, MAP_MAGIC, sizeof(MAP_MAGIC)) == 0 &&
+           (header->version == MAP_VERSION || header->version == 1) && header->tileCells == TileGrid::TILE_CELLS &&
+           header->dataOffset % MAP_PAGE == 0 && blockBytes != 0 &&
+           fits(header->dataOffset, header->blockCount, blockBytes) &&
+           fits(header->quadrantTableOffset, header->quadrantCount, sizeof(MapQuadrantRecord)) &&
+           fits(header->blockTableOffset, header->blockCount, sizeof(MapBlockRecord));
+}
+
+// Заголовок отображённого файла карты, совпадающего с картой по геометрии и слоям;
+// nullptr с сообщением об ошибке, если файл повреждён или не совпадает
+const MapFileHeader *checkMapFile(const MappedFile &file, const std::string &fileName, double quadrantSize,
+                                  double resolution, const MapLayers &layers) {
+    if (!mapFileIntact(file, sizeof(float) * TileGrid::TILE_CELLS * static_cast<std::uint64_t>(layers.stride()))) {
+        std::cerr << "Файл карты повреждён: " << fileName << "\n";
+        return nullptr;
+    }
+    const MapFileHeader *header = reinterpret_cast<const MapFileHeader *>(file.data());
+    if (header->quadrantSize != quadrantSize || header->resolution != resolution) {
+        std::cerr << "Геометрия файла карты (" << header->quadrantSize << " м, " << header->resolution
+                  << " м/пикс) не совпадает с картой: " << fileName << "\n";
+        return nullptr;
+    }
+    if (mapFileLayers(*header, layers.heatLabels) != layers) {
+        std::cerr << "Слои файла карты не совпадают со слоями карты: " << fileName << "\n";
+        return nullptr;
+    }
+    return header;
+}
+
+// Заголовок файла карты из blockCount блоков, за которыми идут таблицы квадрантов и блоков
+MapFileHeader makeMapHeader(double quadrantSize, double resolution, const MapLayers &layers,
+                            std::uint64_t quadrantCount, std::uint64_t blockCount) {
+    MapFileHeader header{};
+    std::memcpy(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC));
+    header.version = MAP_VERSION;
+    header.tileCells = static_cast<std::uint32_t>(TileGrid::TILE_CELLS);
+    header.quadrantSize = quadrantSize;
+    header.resolution = resolution;
+    header.quadrantCount = quadrantCount;
+    header.blockCount = blockCount;
+    header.dataOffset = MAP_PAGE;
+    header.quadrantTableOffset =
+        MAP_PAGE + blockCount * sizeof(float) * TileGrid::TILE_CELLS * static_cast<std::uint64_t>(layers.stride());
+    header.blockTableOffset = header.quadrantTableOffset + quadrantCount * sizeof(MapQuadrantRecord);
+    header.channels = static_cast<std::uint32_t>(layers.channelCount());
+    header.stride = static_cast<std::uint32_t>(layers.stride());
+    header.layerFlags = (layers.observations ? MAP_FLAG_OBSERVATIONS : 0) |
+                        (layers.lastSeen ? MAP_FLAG_LAST_SEEN : 0) |
+                        (layers.occupancy ? MAP_FLAG_OCCUPANCY : 0);
+    header.classCount = static_cast<std::uint32_t>(layers.classes.size());
+    std::copy(layers.classes.begin(), layers.classes.end(), header.classes);
+    header.timeOrigin = layers.timeOrigin;
+    header.logOdds[0] = layers.logOddsHit;
+    header.logOdds[1] = layers.logOddsMiss;
+    header.logOdds[2] = layers.logOddsMin;
+    header.logOdds[3] = layers.logOddsMax;
+    return header;
+}
+
+// Дописывает таблицы, записывает заголовок в начало и переименовывает tmpName в fileName
+bool finishMapFile(std::ofstream &ofs, const std::string &tmpName, const std::string &fileName,
+                   const MapFileHeader &header, const std::vector<MapQuadrantRecord> &quadrantTable,
+                   const std::vector<MapBlockRecord> &blockTable) {
+    ofs.write(reinterpret_cast<const char *>(quadrantTable.data()), quadrantTable.size() * sizeof(MapQuadrantRecord));
+    ofs.write(reinterpret_cast<const char *>(blockTable.data()), blockTable.size() * sizeof(MapBlockRecord));
+    ofs.seekp(0);
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.close();
+    std::error_code ec;
+    if (ofs)
+        std::filesystem::rename(tmpName, fileName, ec);
+    if (!ofs || ec) {
+        std::cerr << "Ошибка записи файла карты: " << fileName << "\n";
+        std::filesystem::remove(tmpName, ec);
+        return false;
+    }
+    return true;
+}
+
+// Роль канала при свёртке блоков файлов карты
+enum class MergeRole : std::uint8_t {
+    Add,   // счётчики: сумма с весом
+    Max,   // last_seen и любой канал в MergeMode::Max
+    Clamp  // occupancy: сумма с весом, ограниченная [logOddsMin, logOddsMax]
+};
+
+// Сворачивает блок in (TILE_CELLS ячеек по stride float) в acc
+void mergeMapBlock(float *acc, const float *in, int stride, const std::vector<MergeRole> &roles, float weight,
+                   float lo, float hi) {
+    const std::size_t floats = TileGrid::TILE_CELLS * static_cast<std::size_t>(stride);
+    if (roles.size() == 1 && stride == 1) {
+        // Один слой: цикл без ветвлений векторизуется
+        if (roles[0] == MergeRole::Max) {
+            for (std::size_t k = 0; k < floats; k++)
+                acc[k] = std::max(acc[k], in[k]);
+        } else {
+            for (std::size_t k = 0; k < floats; k++)
+                acc[k] += weight * in[k];
+        }
+        return;
+    }
+    for (std::size_t cell = 0; cell < floats; cell += stride) {
+        for (std::size_t channel = 0; channel < roles.size(); channel++) {
+            float &a = acc[cell + channel];
+            const float v = in[cell + channel];
+            switch (roles[channel]) {
+            case MergeRole::Add:
+                a += weight * v;
+                break;
+            case MergeRole::Max:
+                a = std::max(a, v);
+                break;
+            case MergeRole::Clamp:
+                a = std::min(std::max(a + weight * v, lo), hi);
+                break;
+            }
+        }
+    }
+}
+
+// Предел следа кадра в ячейках: защищает от следа, уходящего за горизонт
+constexpr std::size_t MAX_FOOTPRINT_CELLS = std::size_t(1) << 24;
+
+// Состояние ячейки следа кадра
+constexpr std::uint8_t FOOTPRINT_FREE = 1;
+constexpr std::uint8_t FOOTPRINT_HIT = 2;
+
+// Построчно заполняет многоугольник (правило чёт-нечет) по центрам ячеек с шагом
+// resolution: для каждой строки ячеек gy из [gyBegin, gyEnd) вызывает
+// span(gy, gxBegin, gxEnd) для ячеек [gxBegin, gxEnd), центры которых внутри
+template <typename Span>
+void fillPolygon(const cv::Point2f* polygon, std::size_t count, double resolution,
+                 int gyBegin, int gyEnd, Span&& span) {
+    thread_local std::vector<double> crossings;
+    for (int gy = gyBegin; gy < gyEnd; gy++) {
+        const double yc = (gy + 0.5) * resolution;
+        crossings.clear();
+        for (std::size_t k = 0; k < count; k++) {
+            const cv::Point2f& a = polygon[k];
+            const cv::Point2f& b = polygon[k + 1 == count ? 0 : k + 1];
+            if ((a.y <= yc) != (b.y <= yc))
+                crossings.push_back(a.x + (yc - a.y) * (b.x - a.x) / (b.y - a.y));
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (std::size_t k = 0; k + 1 < crossings.size(); k += 2) {
+            // Центр ячейки gx: (gx + 0.5) * resolution, берём центры из [x0, x1)
+            const int gx0 = static_cast<int>(std::ceil(crossings[k] / resolution - 0.5));
+            const int gx1 = static_cast<int>(std::ceil(crossings[k + 1] / resolution - 0.5));
+            if (gx1 > gx0)
+                span(gy, gx0, gx1);
+        }
+    }
+}
+
+// Раскладывает каждую точку на четыре отсчёта в центрах окружающих ячеек сетки
+// с шагом resolution (центр ячейки gx — (gx + 0.5) * resolution) с билинейными весами
+void expandSplats(const cv::Point2f* points, const float* weights, std::size_t count, double resolution,
+                  std::vector<cv::Point2f>& taps, std::vector<float>& tapWeights) {
+    taps.resize(4 * count);
+    tapWeights.resize(4 * count);
+    const float res = static_cast<float>(resolution);
+    const float inv = static_cast<float>(1.0 / resolution);
+
+    std::size_t k = 0;
+    const simd::FloatV vRes = simd::broadcast(res);
+    const simd::FloatV vInv = simd::broadcast(inv);
+    const simd::FloatV half = simd::broadcast(0.5f);
+    const simd::FloatV one = simd::broadcast(1.0f);
+    for (; k + simd::WIDTH <= count; k += simd::WIDTH) {
+        simd::FloatV x, y;
+        simd::loadInterleaved(&points[k].x, x, y);
+        const simd::FloatV fx = x * vInv - half;
+        const simd::FloatV fy = y * vInv - half;
+        const simd::FloatV gx = simd::floor(fx);
+        const simd::FloatV gy = simd::floor(fy);
+        const simd::FloatV tx = fx - gx;
+        const simd::FloatV ty = fy - gy;
+        const simd::FloatV x0 = (gx + half) * vRes;
+        const simd::FloatV y0 = (gy + half) * vRes;
+        const simd::FloatV x1 = x0 + vRes;
+        const simd::FloatV y1 = y0 + vRes;
+        const simd::FloatV w = simd::load(weights + k);
+        const simd::FloatV wy0 = w * (one - ty);
+        const simd::FloatV wy1 = w * ty;
+
+        // Отсчёты WIDTH точек лежат четырьмя группами по WIDTH
+        cv::Point2f* out = taps.data() + 4 * k;
+        float* outWeights = tapWeights.data() + 4 * k;
+        simd::storeInterleaved(&out[0].x, x0, y0);
+        simd::storeInterleaved(&out[simd::WIDTH].x, x1, y0);
+        simd::storeInterleaved(&out[2 * simd::WIDTH].x, x0, y1);
+        simd::storeInterleaved(&out[3 * simd::WIDTH].x, x1, y1);
+        simd::store(outWeights, wy0 * (one - tx));
+        simd::store(outWeights + simd::WIDTH, wy0 * tx);
+        simd::store(outWeights + 2 * simd::WIDTH, wy1 * (one - tx));
+        simd::store(outWeights + 3 * simd::WIDTH, wy1 * tx);
+    }
+    for (; k < count; k++) {
+        const float fx = points[k].x * inv - 0.5f;
+        const float fy = points[k].y * inv - 0.5f;
+        const float gx = std::floor(fx);
+        const float gy = std::floor(fy);
+        const float tx = fx - gx;
+        const float ty = fy - gy;
+        const float x0 = (gx + 0.5f) * res;
+        const float y0 = (gy + 0.5f) * res;
+        cv::Point2f* out = taps.data() + 4 * k;
+        float* outWeights = tapWeights.data() + 4 * k;
+        out[0] = cv::Point2f(x0, y0);
+        out[1] = cv::Point2f(x0 + res, y0);
+        out[2] = cv::Point2f(x0, y0 + res);
+        out[3] = cv::Point2f(x0 + res, y0 + res);
+        outWeights[0] = weights[k] * (1.0f - ty) * (1.0f - tx);
+        outWeights[1] = weights[k] * (1.0f - ty) * tx;
+        outWeights[2] = weights[k] * ty * (1.0f - tx);
+        outWeights[3] = weights[k] * ty * tx;
+    }
+}
+
+} // namespace
 
 QuadrantKey GlobalGridMapHandler::getQuadrantKey(double x, double y) const {
     int qx = static_cast<int>(std::floor(x / quadrantSize_));
@@ -9,37 +327,1241 @@ QuadrantKey GlobalGridMapHandler::getQuadrantKey(double x, double y) const {
     return {qx, qy};
 }
 
-GlobalGridMapHandler::GlobalGridMapHandler(double quadrantSize, double resolution)
-    : quadrantSize_(quadrantSize), resolution_(resolution) {}
+GlobalGridMapHandler::GlobalGridMapHandler(double quadrantSize, double resolution, QuadrantStorage storage)
+    : quadrantSize_(quadrantSize), resolution_(resolution), storage_(storage) {
+    for (std::uint8_t label : layers_.heatLabels)
+        heatLabel_[label] = true;
+    if (storage_ == QuadrantStorage::Sparse)
+        tilePool_ = std::make_shared<TilePool>(TileGrid::TILE_CELLS);
+}
+
+bool GlobalGridMapHandler::setLayers(const MapLayers &layers) {
+    if (!layers.isValid()) {
+        std::cerr << "Некорректный набор слоёв: не больше " << MapLayers::MAX_CHANNELS
+                  << " слоёв, метки классов не должны повторяться, границы лог-шансов охватывают 0, "
+                     "компактный heat ведётся без других слоёв и с heatScale > 0\n";
+        return false;
+    }
+    if (layers.heatCell != CellType::Float32 && storage_ != QuadrantStorage::Sparse) {
+        std::cerr << "Компактные ячейки heat доступны только в режиме QuadrantStorage::Sparse\n";
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(quadrantsMutex_);
+    if (!quadrants_.empty() || online_.active) {
+        std::cerr << "Слои карты нельзя менять после добавления точек\n";
+        return false;
+    }
+    layers_ = layers;
+    heatLabel_.fill(false);
+    for (std::uint8_t label : layers_.heatLabels)
+        heatLabel_[label] = true;
+    if (storage_ == QuadrantStorage::Sparse)
+        tilePool_ = std::make_shared<TilePool>(TileGrid::TILE_CELLS * layers_.cellBytes() / sizeof(float));
+    return true;
+}
+
+GlobalGridMapHandler::~GlobalGridMapHandler() {
+    stopOnline();
+    if (!paging_.enabled)
+        return;
+    std::error_code ec;
+    for (const auto& item : quadrants_) {
+        if (item.second.spilled)
+            std::filesystem::remove(spillPath(item.first), ec);
+    }
+}
+
+bool GlobalGridMapHandler::enablePaging(std::size_t memoryBudgetBytes, const std::string &spillDirectory) {
+    std::error_code ec;
+    std::filesystem::create_directories(spillDirectory, ec);
+    if (ec) {
+        std::cerr << "Не удалось создать папку подкачки: " << spillDirectory << "\n";
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(quadrantsMutex_);
+    std::lock_guard<std::mutex> pagingLock(paging_.mutex);
+    paging_.budget = memoryBudgetBytes;
+    paging_.directory = spillDirectory;
+    if (!paging_.enabled) {
+        // Уже созданные квадранты становятся кандидатами на выгрузку
+        for (auto& item : quadrants_) {
+            Quadrant& quadrant = item.second;
+            if (!quadrant.map)
+                continue;
+            quadrant.bytes = quadrant.map->getMemoryBytes();
+            paging_.stats.residentBytes += quadrant.bytes;
+            paging_.stats.residentQuadrants++;
+            paging_.lru.push_front(&quadrant);
+            quadrant.lruIt = paging_.lru.begin();
+            quadrant.inLru = true;
+        }
+        paging_.enabled = true;
+    }
+    return true;
+}
+
+PagingStats GlobalGridMapHandler::getPagingStats() const {
+    std::lock_guard<std::mutex> lock(paging_.mutex);
+    return paging_.stats;
+}
+
+std::string GlobalGridMapHandler::spillPath(const QuadrantKey& key) const {
+    std::ostringstream oss;
+    oss << paging_.directory << "/quadrant_" << key.first << "_" << key.second << ".bin";
+    return oss.str();
+}
+
+std::unique_ptr<QuadrantMap> GlobalGridMapHandler::createQuadrantMap(const QuadrantKey& key) const {
+    // Центр квадранта: ((qx + 0.5) * quadrantSize, (qy + 0.5) * quadrantSize)
+    double centerX = (key.first + 0.5) * quadrantSize_;
+    double centerY = (key.second + 0.5) * quadrantSize_;
+    auto map = std::make_unique<QuadrantMap>(quadrantSize_, quadrantSize_, resolution_,
+                                             centerX, centerY, storage_, tilePool_, layers_);
+    // Плитки разреженного квадранта учитывает TilePool
+    PROFILE_COUNT(Quadrants, 1);
+    PROFILE_COUNT(BytesAllocated, map->getMemoryBytes());
+    return map;
+}
+
+QuadrantMap& GlobalGridMapHandler::acquire(Quadrant& quadrant) {
+    if (!paging_.enabled) {
+        if (!quadrant.map)
+            quadrant.map = createQuadrantMap(quadrant.key);
+        return *quadrant.map;
+    }
+
+    std::lock_guard<std::mutex> lock(paging_.mutex);
+    if (quadrant.map) {
+        paging_.stats.hits++;
+        paging_.lru.splice(paging_.lru.begin(), paging_.lru, quadrant.lruIt);
+        return *quadrant.map;
+    }
+
+    if (quadrant.spilled) {
+        std::ifstream ifs(spillPath(quadrant.key), std::ios::binary);
+        quadrant.map = QuadrantMap::readBinary(ifs, tilePool_, layers_);
+        if (quadrant.map) {
+            paging_.stats.misses++;
+            paging_.stats.bytesLoaded += static_cast<std::uint64_t>(ifs.tellg());
+            quadrant.dirty = false;
+        } else {
+            std::cerr << "Не удалось загрузить выгруженный квадрант (" << quadrant.key.first
+                      << ", " << quadrant.key.second << "), он будет пустым\n";
+            quadrant.spilled = false;
+        }
+    }
+    if (!quadrant.map) {
+        quadrant.map = createQuadrantMap(quadrant.key);
+        quadrant.dirty = true;
+    }
+    quadrant.bytes = quadrant.map->getMemoryBytes();
+    paging_.stats.residentBytes += quadrant.bytes;
+    paging_.stats.residentQuadrants++;
+    paging_.lru.push_front(&quadrant);
+    quadrant.lruIt = paging_.lru.begin();
+    quadrant.inLru = true;
+    return *quadrant.map;
+}
+
+void GlobalGridMapHandler::release(Quadrant& quadrant) {
+    quadrant.version++;
+    if (!paging_.enabled)
+        return;
+    std::lock_guard<std::mutex> lock(paging_.mutex);
+    quadrant.dirty = true;
+    const std::size_t bytes = quadrant.map->getMemoryBytes();
+    paging_.stats.residentBytes = paging_.stats.residentBytes - quadrant.bytes + bytes;
+    quadrant.bytes = bytes;
+
+    if (paging_.spillFailing && paging_.stats.residentBytes <= paging_.retryAbove)
+        return;
+
+    // Обходим LRU с хвоста; квадранты, занятые другими потоками, пропускаем
+    auto it = paging_.lru.end();
+    while (paging_.stats.residentBytes > paging_.budget && it != paging_.lru.begin()) {
+        Quadrant* victim = *--it;
+        if (victim == &quadrant || !victim->mutex.try_lock())
+            continue;
+        auto next = std::next(it);
+        const bool evicted = evict(*victim);
+        victim->mutex.unlock();
+        // Если запись не удалась (диск полон, папка недоступна), следующие жертвы
+        // не выгрузятся тоже: бюджет превышается, пока память не вырастет ещё на 1/16
+        if (!evicted) {
+            paging_.spillFailing = true;
+            paging_.retryAbove = paging_.stats.residentBytes + paging_.budget / 16;
+            break;
+        }
+        paging_.spillFailing = false;
+        it = next;
+    }
+}
+
+bool GlobalGridMapHandler::evict(Quadrant& quadrant) {
+    if (quadrant.dirty || !quadrant.spilled) {
+        // Пишем во временный файл и переименовываем: неудачная запись не портит прежнюю копию
+        const std::string path = spillPath(quadrant.key);
+        const std::string tmpPath = path + ".tmp";
+        std::size_t written = 0;
+        {
+            std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+            if (ofs)
+                written = quadrant.map->writeBinary(ofs);
+            ofs.close();
+            if (!ofs)
+                written = 0;
+        }
+        std::error_code ec;
+        if (written != 0)
+            std::filesystem::rename(tmpPath, path, ec);
+        if (written == 0 || ec) {
+            std::filesystem::remove(tmpPath, ec);
+            if (!paging_.spillFailing)
+                std::cerr << "Не удалось выгрузить квадрант (" << quadrant.key.first << ", "
+                          << quadrant.key.second << ") в " << paging_.directory
+                          << ", квадранты остаются в памяти сверх бюджета\n";
+            return false;
+        }
+        paging_.stats.bytesSpilled += written;
+        quadrant.spilled = true;
+    }
+    paging_.stats.evictions++;
+    paging_.stats.residentBytes -= quadrant.bytes;
+    paging_.stats.residentQuadrants--;
+    paging_.lru.erase(quadrant.lruIt);
+    quadrant.inLru = false;
+    quadrant.bytes = 0;
+    quadrant.dirty = false;
+    quadrant.map.reset();
+    // Плитки ссылались на отображение файла карты (MAP_PRIVATE): изменённые страницы
+    // стали анонимными копиями и без сброса остались бы в памяти после выгрузки
+    for (const auto &range : quadrant.mappedBlocks)
+        MappedFile::discard(range.first, range.second);
+    quadrant.mappedBlocks.clear();
+    return true;
+}
+
+bool GlobalGridMapHandler::withQuadrant(const Quadrant& quadrant,
+                                        const std::function<void(const QuadrantMap&)>& fn) const {
+    if (quadrant.map) {
+        fn(*quadrant.map);
+        return true;
+    }
+    if (!quadrant.spilled)
+        return false;
+    std::ifstream ifs(spillPath(quadrant.key), std::ios::binary);
+    std::unique_ptr<QuadrantMap> map = QuadrantMap::readBinary(ifs, nullptr, layers_);
+    if (!map)
+        return false;
+    fn(*map);
+    return true;
+}
+
+GlobalGridMapHandler::Quadrant& GlobalGridMapHandler::getOrCreateQuadrant(const QuadrantKey& key) {
+    Quadrant& quadrant = quadrants_[key];
+    quadrant.key = key;
+    return quadrant;
+}
+
+GlobalGridMapHandler::Quadrant& GlobalGridMapHandler::getOrCreateQuadrantShared(const QuadrantKey& key) {
+    {
+        std::shared_lock<std::shared_mutex> lock(quadrantsMutex_);
+        auto it = quadrants_.find(key);
+        if (it != quadrants_.end())
+            return it->second;
+    }
+    std::unique_lock<std::shared_mutex> lock(quadrantsMutex_);
+    return getOrCreateQuadrant(key);
+}
+
+bool GlobalGridMapHandler::startOnline(double x, double y, const OnlineConfig &config) {
+    if (online_.active) {
+        std::cerr << "Онлайн-режим уже включён\n";
+        return false;
+    }
+    const int cells = static_cast<int>(std::lround(config.windowSize / resolution_));
+    const double quadrantCells = quadrantSize_ / resolution_;
+    // Ячейки окна должны совпадать с ячейками квадрантов, иначе выгрузка их смешает
+    if (cells < 1 || std::abs(quadrantCells - std::round(quadrantCells)) > 1e-6) {
+        std::cerr << "Окно онлайн-режима должно быть не меньше ячейки, а размер квадранта — кратен разрешению\n";
+        return false;
+    }
+    const double side = cells * resolution_;
+    online_.config = config;
+    online_.cells = cells;
+    online_.cornerX = std::llround((x + 0.5 * side) / resolution_);
+    online_.cornerY = std::llround((y + 0.5 * side) / resolution_);
+    online_.window = std::make_unique<QuadrantMap>(side, side, resolution_,
+                                                   online_.cornerX * resolution_ - 0.5 * side,
+                                                   online_.cornerY * resolution_ - 0.5 * side,
+                                                   storage_, tilePool_, layers_);
+    FlushBatch empty;
+    recenterWindow(x, y, empty);
+    online_.stats = OnlineStats();
+    online_.stop = false;
+    online_.flusher = std::thread(&GlobalGridMapHandler::flushLoop, this);
+    online_.active = true;
+    return true;
+}
+
+void GlobalGridMapHandler::recenterWindow(double x, double y, FlushBatch& batch) {
+    const double side = online_.cells * resolution_;
+    online_.cornerX = std::llround((x + 0.5 * side) / resolution_);
+    online_.cornerY = std::llround((y + 0.5 * side) / resolution_);
+    const double maxX = online_.cornerX * resolution_;
+    const double maxY = online_.cornerY * resolution_;
+    online_.window->move(maxX - 0.5 * side, maxY - 0.5 * side, batch.cells, batch.values);
+    // Точки на самой границе окна пишутся в квадранты: так решение не зависит от округления
+    const double margin = 1e-3 * resolution_;
+    online_.maxX = maxX - margin;
+    online_.minX = maxX - side + margin;
+    online_.maxY = maxY - margin;
+    online_.minY = maxY - side + margin;
+}
+
+void GlobalGridMapHandler::updatePose(double x, double y) {
+    if (!online_.active)
+        return;
+    FlushBatch batch;
+    {
+        std::lock_guard<std::mutex> lock(online_.mutex);
+        const double half = 0.5 * online_.cells * resolution_;
+        const double dx = x - (online_.cornerX * resolution_ - half);
+        const double dy = y - (online_.cornerY * resolution_ - half);
+        if (std::abs(dx) <= online_.config.recenterDistance && std::abs(dy) <= online_.config.recenterDistance)
+            return;
+        recenterWindow(x, y, batch);
+    }
+    {
+        std::lock_guard<std::mutex> lock(online_.queueMutex);
+        online_.stats.moves++;
+    }
+    if (!batch.cells.empty())
+        enqueueFlush(std::move(batch));
+}
+
+void GlobalGridMapHandler::enqueueFlush(FlushBatch&& batch) {
+    std::unique_lock<std::mutex> lock(online_.queueMutex);
+    online_.drained.wait(lock, [&] { return online_.stats.queuedCells < online_.config.maxQueuedCells; });
+    online_.stats.queuedCells += batch.cells.size();
+    online_.queue.push_back(std::move(batch));
+    online_.queued.notify_one();
+}
+
+void GlobalGridMapHandler::flushLoop() {
+    const std::size_t channels = static_cast<std::size_t>(layers_.channelCount());
+    for (;;) {
+        FlushBatch batch;
+        {
+            std::unique_lock<std::mutex> lock(online_.queueMutex);
+            online_.queued.wait(lock, [&] { return online_.stop || !online_.queue.empty(); });
+            if (online_.queue.empty())
+                return;
+            batch = std::move(online_.queue.front());
+            online_.queue.pop_front();
+            online_.flushing = true;
+        }
+
+        // Полоса окна пересекает границы квадрантов редко: квадрант ищется на серию ячеек
+        const std::size_t count = batch.cells.size();
+        std::size_t runStart = 0;
+        while (runStart < count) {
+            const QuadrantKey key = getQuadrantKey(batch.cells[runStart].x, batch.cells[runStart].y);
+            std::size_t runEnd = runStart + 1;
+            while (runEnd < count && getQuadrantKey(batch.cells[runEnd].x, batch.cells[runEnd].y) == key)
+                runEnd++;
+            Quadrant& quadrant = getOrCreateQuadrantShared(key);
+            {
+                std::lock_guard<std::mutex> lock(quadrant.mutex);
+                acquire(quadrant).mergeCells(batch.cells.data() + runStart, batch.values.data() + runStart * channels,
+                                             runEnd - runStart);
+                release(quadrant);
+            }
+            runStart = runEnd;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(online_.queueMutex);
+            online_.stats.queuedCells -= count;
+            online_.stats.cellsFlushed += count;
+            online_.flushing = false;
+        }
+        online_.drained.notify_all();
+    }
+}
+
+void GlobalGridMapHandler::flushOnline() {
+    if (!online_.active)
+        return;
+    FlushBatch batch;
+    {
+        std::lock_guard<std::mutex> lock(online_.mutex);
+        online_.window->takeCells(batch.cells, batch.values);
+    }
+    if (!batch.cells.empty())
+        enqueueFlush(std::move(batch));
+    std::unique_lock<std::mutex> lock(online_.queueMutex);
+    online_.drained.wait(lock, [&] { return online_.queue.empty() && !online_.flushing; });
+}
+
+void GlobalGridMapHandler::stopOnline() {
+    if (!online_.active)
+        return;
+    flushOnline();
+    {
+        std::lock_guard<std::mutex> lock(online_.queueMutex);
+        online_.stop = true;
+    }
+    online_.queued.notify_all();
+    online_.flusher.join();
+    online_.window.reset();
+    online_.active = false;
+}
+
+OnlineStats GlobalGridMapHandler::getOnlineStats() const {
+    std::lock_guard<std::mutex> lock(online_.queueMutex);
+    return online_.stats;
+}
+
+bool GlobalGridMapHandler::routeToWindow(const cv::Point2f*& points, const std::uint8_t*& labels,
+                                         const float*& weights, std::size_t& count,
+                                         const std::function<void(QuadrantMap&, const cv::Point2f*,
+                                                                  const std::uint8_t*, const float*,
+                                                                  std::size_t)>& fn,
+                                         double margin) {
+    // Буферы потока: точки пакета внутри окна и вне его
+    thread_local std::vector<cv::Point2f> insidePoints, outsidePoints;
+    thread_local std::vector<std::uint8_t> insideLabels, outsideLabels;
+    thread_local std::vector<float> insideWeights, outsideWeights;
+
+    std::lock_guard<std::mutex> lock(online_.mutex);
+    std::size_t k = 0;
+    while (k < count && inWindow(points[k].x, points[k].y, margin))
+        k++;
+    if (k == count) { // обычный случай: весь кадр внутри окна
+        fn(*online_.window, points, labels, weights, count);
+        return false;
+    }
+
+    insidePoints.assign(points, points + k);
+    outsidePoints.clear();
+    insideLabels.clear();
+    outsideLabels.clear();
+    insideWeights.clear();
+    outsideWeights.clear();
+    if (labels)
+        insideLabels.assign(labels, labels + k);
+    if (weights)
+        insideWeights.assign(weights, weights + k);
+    for (; k < count; k++) {
+        const bool inside = inWindow(points[k].x, points[k].y, margin);
+        (inside ? insidePoints : outsidePoints).push_back(points[k]);
+        if (labels)
+            (inside ? insideLabels : outsideLabels).push_back(labels[k]);
+        if (weights)
+            (inside ? insideWeights : outsideWeights).push_back(weights[k]);
+    }
+    if (!insidePoints.empty())
+        fn(*online_.window, insidePoints.data(), labels ? insideLabels.data() : nullptr,
+           weights ? insideWeights.data() : nullptr, insidePoints.size());
+    {
+        std::lock_guard<std::mutex> statsLock(online_.queueMutex);
+        online_.stats.pointsOutside += outsidePoints.size();
+    }
+    points = outsidePoints.data();
+    labels = labels ? outsideLabels.data() : nullptr;
+    weights = weights ? outsideWeights.data() : nullptr;
+    count = outsidePoints.size();
+    return true;
+}
 
 void GlobalGridMapHandler::addPoint(double x, double y, float value) {
-    QuadrantKey key = getQuadrantKey(x, y);
-    if (quadrants_.find(key) == quadrants_.end()) {
-        // Центр квадранта: ((qx + 0.5) * quadrantSize, (qy + 0.5) * quadrantSize)
-        double centerX = (key.first + 0.5) * quadrantSize_;
-        double centerY = (key.second + 0.5) * quadrantSize_;
-        quadrants_[key] = std::make_unique<QuadrantMap>(quadrantSize_, quadrantSize_, resolution_, centerX, centerY);
+    if (online_.active) {
+        {
+            std::lock_guard<std::mutex> lock(online_.mutex);
+            if (inWindow(x, y)) {
+                online_.window->addPoint(x, y, value);
+                return;
+            }
+        }
+        // Вне окна: квадранты пишутся одновременно с потоком выгрузки
+        Quadrant& quadrant = getOrCreateQuadrantShared(getQuadrantKey(x, y));
+        std::lock_guard<std::mutex> lock(quadrant.mutex);
+        acquire(quadrant).addPoint(x, y, value);
+        release(quadrant);
+        return;
+    }
+    Quadrant& quadrant = getOrCreateQuadrant(getQuadrantKey(x, y));
+    if (!paging_.enabled) {
+        acquire(quadrant).addPoint(x, y, value);
+        release(quadrant);
+        return;
+    }
+    // Соседние точки почти всегда в одном квадранте: глобальный mutex подкачки берётся
+    // только при смене квадранта. Квадрант, выгруженный другой операцией, уже записан
+    // (dirty), и его прежний release не нужен
+    if (&quadrant != pointQuadrant_ || !quadrant.map) {
+        if (pointQuadrant_ && pointQuadrant_->map)
+            release(*pointQuadrant_);
+        acquire(quadrant);
+        pointQuadrant_ = &quadrant;
+    }
+    quadrant.map->addPoint(x, y, value);
+    quadrant.dirty = true;
+    quadrant.version++;
+}
+
+void GlobalGridMapHandler::addPoints(const cv::Point2f* points, std::size_t count, float value) {
+    if (online_.active) { // квадранты пишет и поток выгрузки
+        addPointsConcurrent(points, count, value);
+        return;
+    }
+    PROFILE_SCOPE(Accumulate);
+    PROFILE_COUNT(Points, count);
+    std::size_t runStart = 0;
+    while (runStart < count) {
+        const QuadrantKey key = getQuadrantKey(points[runStart].x, points[runStart].y);
+        std::size_t runEnd = runStart + 1;
+        while (runEnd < count && getQuadrantKey(points[runEnd].x, points[runEnd].y) == key)
+            runEnd++;
+        Quadrant& quadrant = getOrCreateQuadrant(key);
+        acquire(quadrant).addPoints(points + runStart, runEnd - runStart, value);
+        release(quadrant);
+        runStart = runEnd;
+    }
+}
+
+void GlobalGridMapHandler::addPointsConcurrent(const cv::Point2f* points, std::size_t count, float value) {
+    PROFILE_SCOPE(Accumulate);
+    PROFILE_COUNT(Points, count);
+    const std::uint8_t* labels = nullptr;
+    const float* weights = nullptr;
+    if (online_.active && !routeToWindow(points, labels, weights, count,
+                                         [&](QuadrantMap& window, const cv::Point2f* p, const std::uint8_t*,
+                                             const float*, std::size_t n) { window.addPoints(p, n, value); }))
+        return;
+
+    // Буферы потока: точки пакета, разложенные по квадрантам
+    thread_local std::map<QuadrantKey, std::vector<cv::Point2f>> bins;
+    if (bins.size() > 64)
+        bins.clear();
+
+    for (std::size_t i = 0; i < count; i++)
+        bins[getQuadrantKey(points[i].x, points[i].y)].push_back(points[i]);
+
+    for (auto& bin : bins) {
+        if (bin.second.empty())
+            continue;
+        Quadrant& quadrant = getOrCreateQuadrantShared(bin.first);
+        {
+            std::lock_guard<std::mutex> lock(quadrant.mutex);
+            acquire(quadrant).addPoints(bin.second.data(), bin.second.size(), value);
+            release(quadrant);
+        }
+        bin.second.clear();
+    }
+}
+
+bool GlobalGridMapHandler::splatInterior(double x, double y, QuadrantKey& key) const {
+    key = getQuadrantKey(x, y);
+    const double lx = x - key.first * quadrantSize_;
+    const double ly = y - key.second * quadrantSize_;
+    return lx > resolution_ && lx < quadrantSize_ - resolution_ &&
+           ly > resolution_ && ly < quadrantSize_ - resolution_;
+}
+
+void GlobalGridMapHandler::addSplats(const cv::Point2f* points, const float* weights, std::size_t count,
+                                     float value) {
+    if (online_.active) { // квадранты пишет и поток выгрузки
+        addSplatsConcurrent(points, weights, count, value);
+        return;
+    }
+    PROFILE_SCOPE(Accumulate);
+    PROFILE_COUNT(Points, count);
+    // Точки у края квадранта: их отсчёты раскладываются по квадрантам по одному
+    thread_local std::vector<cv::Point2f> borderPoints, taps;
+    thread_local std::vector<float> borderWeights, tapWeights;
+    borderPoints.clear();
+    borderWeights.clear();
+
+    QuadrantKey key, next;
+    std::size_t runStart = 0;
+    while (runStart < count) {
+        if (!splatInterior(points[runStart].x, points[runStart].y, key)) {
+            borderPoints.push_back(points[runStart]);
+            borderWeights.push_back(weights[runStart]);
+            runStart++;
+            continue;
+        }
+        std::size_t runEnd = runStart + 1;
+        while (runEnd < count && splatInterior(points[runEnd].x, points[runEnd].y, next) && next == key)
+            runEnd++;
+        Quadrant& quadrant = getOrCreateQuadrant(key);
+        acquire(quadrant).addSplats(points + runStart, weights + runStart, runEnd - runStart, value);
+        release(quadrant);
+        runStart = runEnd;
+    }
+
+    expandSplats(borderPoints.data(), borderWeights.data(), borderPoints.size(), resolution_, taps, tapWeights);
+    runStart = 0;
+    while (runStart < taps.size()) {
+        key = getQuadrantKey(taps[runStart].x, taps[runStart].y);
+        std::size_t runEnd = runStart + 1;
+        while (runEnd < taps.size() && getQuadrantKey(taps[runEnd].x, taps[runEnd].y) == key)
+            runEnd++;
+        Quadrant& quadrant = getOrCreateQuadrant(key);
+        acquire(quadrant).addWeightedPoints(taps.data() + runStart, tapWeights.data() + runStart,
+                                            runEnd - runStart, value);
+        release(quadrant);
+        runStart = runEnd;
+    }
+}
+
+void GlobalGridMapHandler::addSplatsConcurrent(const cv::Point2f* points, const float* weights,
+                                               std::size_t count, float value) {
+    PROFILE_SCOPE(Accumulate);
+    PROFILE_COUNT(Points, count);
+    // Отсчёты точки у края окна могли бы выйти за окно, поэтому такие точки идут в квадранты
+    const std::uint8_t* labels = nullptr;
+    if (online_.active && !routeToWindow(points, labels, weights, count,
+                                         [&](QuadrantMap& window, const cv::Point2f* p, const std::uint8_t*,
+                                             const float* w, std::size_t n) { window.addSplats(p, w, n, value); },
+                                         resolution_))
+        return;
+
+    // Буферы потока: точки пакета по квадрантам; точки у края квадранта —
+    // отсчётами с весами в квадрант каждого отсчёта
+    struct Bin {
+        std::vector<cv::Point2f> points;
+        std::vector<float> weights;
+        std::vector<cv::Point2f> taps;
+        std::vector<float> tapWeights;
+    };
+    thread_local std::map<QuadrantKey, Bin> bins;
+    thread_local std::vector<cv::Point2f> borderPoints, taps;
+    thread_local std::vector<float> borderWeights, tapWeights;
+    if (bins.size() > 64)
+        bins.clear();
+    borderPoints.clear();
+    borderWeights.clear();
+
+    QuadrantKey key;
+    for (std::size_t i = 0; i < count; i++) {
+        if (splatInterior(points[i].x, points[i].y, key)) {
+            Bin& bin = bins[key];
+            bin.points.push_back(points[i]);
+            bin.weights.push_back(weights[i]);
+        } else {
+            borderPoints.push_back(points[i]);
+            borderWeights.push_back(weights[i]);
+        }
+    }
+    expandSplats(borderPoints.data(), borderWeights.data(), borderPoints.size(), resolution_, taps, tapWeights);
+    for (std::size_t i = 0; i < taps.size(); i++) {
+        Bin& bin = bins[getQuadrantKey(taps[i].x, taps[i].y)];
+        bin.taps.push_back(taps[i]);
+        bin.tapWeights.push_back(tapWeights[i]);
+    }
+
+    for (auto& item : bins) {
+        Bin& bin = item.second;
+        if (bin.points.empty() && bin.taps.empty())
+            continue;
+        Quadrant& quadrant = getOrCreateQuadrantShared(item.first);
+        {
+            std::lock_guard<std::mutex> lock(quadrant.mutex);
+            QuadrantMap& map = acquire(quadrant);
+            map.addSplats(bin.points.data(), bin.weights.data(), bin.points.size(), value);
+            map.addWeightedPoints(bin.taps.data(), bin.tapWeights.data(), bin.taps.size(), value);
+            release(quadrant);
+        }
+        bin.points.clear();
+        bin.weights.clear();
+        bin.taps.clear();
+        bin.tapWeights.clear();
+    }
+}
+
+void GlobalGridMapHandler::addObservations(const cv::Point2f* points, const std::uint8_t* labels,
+                                           std::size_t count, float value, double time) {
+    if (online_.active) { // квадранты пишет и поток выгрузки
+        addObservationsConcurrent(points, labels, count, value, time);
+        return;
+    }
+    PROFILE_SCOPE(Accumulate);
+    PROFILE_COUNT(Points, count);
+    std::size_t runStart = 0;
+    while (runStart < count) {
+        const QuadrantKey key = getQuadrantKey(points[runStart].x, points[runStart].y);
+        std::size_t runEnd = runStart + 1;
+        while (runEnd < count && getQuadrantKey(points[runEnd].x, points[runEnd].y) == key)
+            runEnd++;
+        Quadrant& quadrant = getOrCreateQuadrant(key);
+        acquire(quadrant).addObservations(points + runStart, labels + runStart, runEnd - runStart, value, time);
+        release(quadrant);
+        runStart = runEnd;
+    }
+}
+
+void GlobalGridMapHandler::addObservationsConcurrent(const cv::Point2f* points, const std::uint8_t* labels,
+                                                     std::size_t count, float value, double time) {
+    PROFILE_SCOPE(Accumulate);
+    PROFILE_COUNT(Points, count);
+    const float* weights = nullptr;
+    if (online_.active && !routeToWindow(points, labels, weights, count,
+                                         [&](QuadrantMap& window, const cv::Point2f* p, const std::uint8_t* l,
+                                             const float*, std::size_t n) {
+                                             window.addObservations(p, l, n, value, time);
+                                         }))
+        return;
+
+    // Буферы потока: точки и метки пакета, разложенные по квадрантам
+    struct Bin {
+        std::vector<cv::Point2f> points;
+        std::vector<std::uint8_t> labels;
+    };
+    thread_local std::map<QuadrantKey, Bin> bins;
+    if (bins.size() > 64)
+        bins.clear();
+
+    for (std::size_t i = 0; i < count; i++) {
+        Bin& bin = bins[getQuadrantKey(points[i].x, points[i].y)];
+        bin.points.push_back(points[i]);
+        bin.labels.push_back(labels[i]);
+    }
+
+    for (auto& item : bins) {
+        Bin& bin = item.second;
+        if (bin.points.empty())
+            continue;
+        Quadrant& quadrant = getOrCreateQuadrantShared(item.first);
+        {
+            std::lock_guard<std::mutex> lock(quadrant.mutex);
+            acquire(quadrant).addObservations(bin.points.data(), bin.labels.data(), bin.points.size(), value, time);
+            release(quadrant);
+        }
+        bin.points.clear();
+        bin.labels.clear();
+    }
+}
+
+GlobalGridMapHandler::OccupancyBins* GlobalGridMapHandler::rasterizeFootprint(
+    const cv::Point2f* footprint, std::size_t vertexCount, const cv::Point2f* points,
+    const std::uint8_t* labels, std::size_t count) const {
+    if (layers_.occupancyChannel() < 0 || vertexCount < 3)
+        return nullptr;
+    float minX = footprint[0].x, maxX = footprint[0].x;
+    float minY = footprint[0].y, maxY = footprint[0].y;
+    for (std::size_t k = 1; k < vertexCount; k++) {
+        minX = std::min(minX, footprint[k].x);
+        maxX = std::max(maxX, footprint[k].x);
+        minY = std::min(minY, footprint[k].y);
+        maxY = std::max(maxY, footprint[k].y);
+    }
+    if (!std::isfinite(minX) || !std::isfinite(maxX) || !std::isfinite(minY) || !std::isfinite(maxY))
+        return nullptr;
+    const double width = std::floor(maxX / resolution_) - std::floor(minX / resolution_) + 1;
+    const double height = std::floor(maxY / resolution_) - std::floor(minY / resolution_) + 1;
+    if (width * height > static_cast<double>(MAX_FOOTPRINT_CELLS))
+        return nullptr;
+
+    // Окно следа в глобальных индексах ячеек: gx = floor(x / resolution)
+    const int gx0 = static_cast<int>(std::floor(minX / resolution_));
+    const int gy0 = static_cast<int>(std::floor(minY / resolution_));
+    const int w = static_cast<int>(width);
+    const int h = static_cast<int>(height);
+    thread_local std::vector<std::uint8_t> state;
+    state.assign(static_cast<std::size_t>(w) * h, 0);
+
+    fillPolygon(footprint, vertexCount, resolution_, gy0, gy0 + h, [&](int gy, int begin, int end) {
+        begin = std::max(begin, gx0);
+        end = std::min(end, gx0 + w);
+        if (begin < end) {
+            std::uint8_t* row = state.data() + static_cast<std::size_t>(gy - gy0) * w;
+            std::fill(row + (begin - gx0), row + (end - gx0), FOOTPRINT_FREE);
+        }
+    });
+    for (std::size_t k = 0; k < count; k++) {
+        if (labels && !heatLabel_[labels[k]])
+            continue;
+        const int gx = static_cast<int>(std::floor(points[k].x / resolution_)) - gx0;
+        const int gy = static_cast<int>(std::floor(points[k].y / resolution_)) - gy0;
+        if (gx >= 0 && gy >= 0 && gx < w && gy < h)
+            state[static_cast<std::size_t>(gy) * w + gx] = FOOTPRINT_HIT;
+    }
+
+    thread_local OccupancyBins bins;
+    if (bins.size() > 64)
+        bins.clear();
+    for (int y = 0; y < h; y++) {
+        const std::uint8_t* row = state.data() + static_cast<std::size_t>(y) * w;
+        const float yc = static_cast<float>((gy0 + y + 0.5) * resolution_);
+        QuadrantKey lastKey;
+        OccupancyBin* bin = nullptr;
+        for (int x = 0; x < w; x++) {
+            if (!row[x])
+                continue;
+            const cv::Point2f center(static_cast<float>((gx0 + x + 0.5) * resolution_), yc);
+            const QuadrantKey key = getQuadrantKey(center.x, center.y);
+            if (!bin || key != lastKey) {
+                bin = &bins[key];
+                lastKey = key;
+            }
+            bin->cells.push_back(center);
+            bin->hits.push_back(row[x] == FOOTPRINT_HIT);
+        }
+    }
+    return &bins;
+}
+
+bool GlobalGridMapHandler::updateOccupancy(const cv::Point2f* footprint, std::size_t vertexCount,
+                                           const cv::Point2f* points, const std::uint8_t* labels,
+                                           std::size_t count) {
+    if (online_.active) // квадранты пишет и поток выгрузки
+        return updateOccupancyConcurrent(footprint, vertexCount, points, labels, count);
+    OccupancyBins* bins = rasterizeFootprint(footprint, vertexCount, points, labels, count);
+    if (!bins)
+        return false;
+    for (auto& item : *bins) {
+        OccupancyBin& bin = item.second;
+        if (bin.cells.empty())
+            continue;
+        Quadrant& quadrant = getOrCreateQuadrant(item.first);
+        acquire(quadrant).updateOccupancy(bin.cells.data(), bin.hits.data(), bin.cells.size());
+        release(quadrant);
+        bin.cells.clear();
+        bin.hits.clear();
+    }
+    return true;
+}
+
+bool GlobalGridMapHandler::updateOccupancyConcurrent(const cv::Point2f* footprint, std::size_t vertexCount,
+                                                     const cv::Point2f* points, const std::uint8_t* labels,
+                                                     std::size_t count) {
+    OccupancyBins* bins = rasterizeFootprint(footprint, vertexCount, points, labels, count);
+    if (!bins)
+        return false;
+    for (auto& item : *bins) {
+        OccupancyBin& bin = item.second;
+        const cv::Point2f* cells = bin.cells.data();
+        const std::uint8_t* hits = bin.hits.data();
+        const float* weights = nullptr;
+        std::size_t cellCount = bin.cells.size();
+        if (online_.active && cellCount &&
+            !routeToWindow(cells, hits, weights, cellCount,
+                           [](QuadrantMap& window, const cv::Point2f* c, const std::uint8_t* h, const float*,
+                              std::size_t n) { window.updateOccupancy(c, h, n); }))
+            cellCount = 0;
+        if (cellCount) {
+            Quadrant& quadrant = getOrCreateQuadrantShared(item.first);
+            std::lock_guard<std::mutex> lock(quadrant.mutex);
+            acquire(quadrant).updateOccupancy(cells, hits, cellCount);
+            release(quadrant);
+        }
+        bin.cells.clear();
+        bin.hits.clear();
     }
-    quadrants_[key]->addPoint(x, y, value);
+    return true;
 }
 
-bool GlobalGridMapHandler::saveQuadrant(const QuadrantKey &key, const std::string &fileName) const {
+std::size_t GlobalGridMapHandler::getQuadrantCount() const {
+    std::shared_lock<std::shared_mutex> lock(quadrantsMutex_);
+    return quadrants_.size();
+}
+
+std::vector<std::pair<QuadrantKey, std::uint64_t>> GlobalGridMapHandler::getQuadrantVersions() const {
+    std::shared_lock<std::shared_mutex> lock(quadrantsMutex_);
+    std::vector<std::pair<QuadrantKey, std::uint64_t>> versions;
+    versions.reserve(quadrants_.size());
+    for (const auto& item : quadrants_)
+        versions.emplace_back(item.first, item.second.version);
+    return versions;
+}
+
+bool GlobalGridMapHandler::visitQuadrant(const QuadrantKey &key,
+                                         const std::function<void(const QuadrantMap&)>& fn) const {
+    std::shared_lock<std::shared_mutex> lock(quadrantsMutex_);
+    auto it = quadrants_.find(key);
+    if (it == quadrants_.end())
+        return false;
+    return withQuadrant(it->second, fn);
+}
+
+double GlobalGridMapHandler::getTotal() const {
+    std::shared_lock<std::shared_mutex> lock(quadrantsMutex_);
+    double total = 0.0;
+    for (const auto& item : quadrants_)
+        withQuadrant(item.second, [&](const QuadrantMap& map) { total += map.getTotal(); });
+    return total;
+}
+
+std::size_t GlobalGridMapHandler::getMemoryBytes() const {
+    std::shared_lock<std::shared_mutex> lock(quadrantsMutex_);
+    std::size_t bytes = 0;
+    for (const auto& item : quadrants_) {
+        if (item.second.map)
+            bytes += item.second.map->getMemoryBytes();
+    }
+    if (online_.active) {
+        std::lock_guard<std::mutex> windowLock(online_.mutex);
+        bytes += online_.window->getMemoryBytes();
+    }
+    return bytes;
+}
+
+bool GlobalGridMapHandler::saveMapFile(const std::string &fileName) const {
+    // Пишем во временный файл и переименовываем: исходный файл может быть
+    // отображён в память этой картой, и его нельзя обрезать на месте
+    const std::string tmpName = fileName + ".tmp";
+    std::ofstream ofs(tmpName, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        std::cerr << "Не удалось открыть файл карты для записи: " << tmpName << "\n";
+        return false;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(quadrantsMutex_);
+    // Место под заголовок; блоки пишутся сразу за ним, таблицы — в конце файла
+    const std::vector<char> headerPage(MAP_PAGE, 0);
+    ofs.write(headerPage.data(), headerPage.size());
+
+    std::vector<MapQuadrantRecord> quadrantTable;
+    std::vector<MapBlockRecord> blockTable;
+    std::vector<float> buffer(TileGrid::TILE_CELLS * layers_.stride());
+    for (const auto &item : quadrants_) {
+        withQuadrant(item.second, [&](const QuadrantMap &map) {
+            const grid_map::Size size = map.getSize();
+            MapQuadrantRecord record{item.first.first, item.first.second, size(0), size(1),
+                                     blockTable.size(), 0};
+            for (const auto &block : map.getNonEmptyBlocks()) {
+                map.readBlock(block.first, block.second, buffer.data());
+                ofs.write(reinterpret_cast<const char *>(buffer.data()), sizeof(float) * buffer.size());
+                blockTable.push_back({block.first, block.second});
+            }
+            record.blockCount = blockTable.size() - record.firstBlock;
+            quadrantTable.push_back(record);
+        });
+    }
+
+    const MapFileHeader header = makeMapHeader(quadrantSize_, resolution_, layers_, quadrantTable.size(),
+                                               blockTable.size());
+    return finishMapFile(ofs, tmpName, fileName, header, quadrantTable, blockTable);
+}
+
+bool GlobalGridMapHandler::loadMapFile(const std::string &fileName) {
+    auto file = std::make_unique<MappedFile>();
+    if (!file->open(fileName, MappedFile::Mode::CopyOnWrite)) {
+        std::cerr << "Не удалось отобразить файл карты: " << fileName << "\n";
+        return false;
+    }
+
+    const MapFileHeader *header = checkMapFile(*file, fileName, quadrantSize_, resolution_, layers_);
+    if (!header)
+        return false;
+    const std::uint64_t blockFloats = TileGrid::TILE_CELLS * static_cast<std::uint64_t>(layers_.stride());
+
+    const MapQuadrantRecord *quadrantTable =
+        reinterpret_cast<const MapQuadrantRecord *>(file->data() + header->quadrantTableOffset);
+    const MapBlockRecord *blockTable =
+        reinterpret_cast<const MapBlockRecord *>(file->data() + header->blockTableOffset);
+    float *blocks = reinterpret_cast<float *>(file->mutableData() + header->dataOffset);
+
+    std::unique_lock<std::shared_mutex> lock(quadrantsMutex_);
+    bool attached = false;
+    bool intact = true;
+    for (std::uint64_t q = 0; q < header->quadrantCount; q++) {
+        const MapQuadrantRecord &record = quadrantTable[q];
+        if (record.firstBlock > header->blockCount || record.blockCount > header->blockCount - record.firstBlock) {
+            std::cerr << "Файл карты повреждён: " << fileName << "\n";
+            intact = false;
+            break;
+        }
+        Quadrant &quadrant = getOrCreateQuadrant({record.qx, record.qy});
+        QuadrantMap &map = acquire(quadrant);
+        const grid_map::Size size = map.getSize();
+        if (size(0) != record.rows || size(1) != record.cols) {
+            std::cerr << "Размер квадранта (" << record.qx << ", " << record.qy
+                      << ") в файле карты не совпадает, квадрант пропущен\n";
+            release(quadrant);
+            continue;
+        }
+        bool quadrantAttached = false;
+        for (std::uint64_t b = record.firstBlock; b < record.firstBlock + record.blockCount; b++) {
+            float *data = blocks + b * blockFloats;
+            if (map.attachBlock(blockTable[b].ti, blockTable[b].tj, data))
+                quadrantAttached = true;
+            else
+                map.addBlock(blockTable[b].ti, blockTable[b].tj, data);
+        }
+        if (quadrantAttached) {
+            quadrant.mappedBlocks.emplace_back(reinterpret_cast<char *>(blocks + record.firstBlock * blockFloats),
+                                               record.blockCount * blockFloats * sizeof(float));
+            attached = true;
+        }
+        release(quadrant);
+    }
+    // Отображение нужно, пока на него ссылаются плитки, даже если файл прочитан не до конца
+    if (attached)
+        mappedFiles_.push_back(std::move(file));
+    return intact;
+}
+
+bool GlobalGridMapHandler::readMapFileInfo(const std::string &fileName, MapFileInfo &info) {
+    MappedFile file;
+    if (!file.open(fileName, MappedFile::Mode::ReadOnly)) {
+        std::cerr << "Не удалось отобразить файл карты: " << fileName << "\n";
+        return false;
+    }
+    if (file.size() < MAP_PAGE) {
+        std::cerr << "Файл карты повреждён: " << fileName << "\n";
+        return false;
+    }
+    const MapFileHeader *header = reinterpret_cast<const MapFileHeader *>(file.data());
+    const MapLayers layers = mapFileLayers(*header, MapLayers().heatLabels);
+    if (!layers.isValid() || (header->version >= 2 && header->stride != static_cast<std::uint32_t>(layers.stride())) ||
+        !mapFileIntact(file, sizeof(float) * TileGrid::TILE_CELLS * static_cast<std::uint64_t>(layers.stride()))) {
+        std::cerr << "Файл карты повреждён: " << fileName << "\n";
+        return false;
+    }
+    info.quadrantSize = header->quadrantSize;
+    info.resolution = header->resolution;
+    info.layers = layers;
+    info.quadrantCount = header->quadrantCount;
+    info.blockCount = header->blockCount;
+    return true;
+}
+
+bool GlobalGridMapHandler::mergeMapFiles(const std::vector<std::string> &inputs, const std::string &output,
+                                         const MergeOptions &options, MergeStats *stats) const {
+    if (options.mode == MergeMode::Weighted && !options.weights.empty() && options.weights.size() != inputs.size()) {
+        std::cerr << "Весов " << options.weights.size() << ", а файлов карты " << inputs.size() << "\n";
+        return false;
+    }
+    const std::uint64_t blockFloats = TileGrid::TILE_CELLS * static_cast<std::uint64_t>(layers_.stride());
+
+    // Входы отображаются только для чтения: страницы блоков читаются по мере свёртки
+    struct Input {
+        MappedFile file;
+        const MapBlockRecord *blocks = nullptr;
+        const float *data = nullptr;
+        float weight = 1.0f;
+    };
+    std::vector<std::unique_ptr<Input>> files;
+    // Ключ квадранта -> записи этого квадранта во входах (номер входа, запись); таблицы малы по сравнению с блоками
+    std::map<QuadrantKey, std::vector<std::pair<std::size_t, const MapQuadrantRecord *>>> sources;
+    for (std::size_t n = 0; n < inputs.size(); n++) {
+        auto input = std::make_unique<Input>();
+        if (!input->file.open(inputs[n], MappedFile::Mode::ReadOnly)) {
+            std::cerr << "Не удалось отобразить файл карты: " << inputs[n] << "\n";
+            return false;
+        }
+        const MapFileHeader *header = checkMapFile(input->file, inputs[n], quadrantSize_, resolution_, layers_);
+        if (!header)
+            return false;
+        input->blocks = reinterpret_cast<const MapBlockRecord *>(input->file.data() + header->blockTableOffset);
+        input->data = reinterpret_cast<const float *>(input->file.data() + header->dataOffset);
+        if (options.mode == MergeMode::Weighted && !options.weights.empty())
+            input->weight = static_cast<float>(options.weights[n]);
+        const MapQuadrantRecord *quadrantTable =
+            reinterpret_cast<const MapQuadrantRecord *>(input->file.data() + header->quadrantTableOffset);
+        for (std::uint64_t q = 0; q < header->quadrantCount; q++) {
+            const MapQuadrantRecord &record = quadrantTable[q];
+            if (record.firstBlock > header->blockCount || record.blockCount > header->blockCount - record.firstBlock ||
+                record.rows <= 0 || record.cols <= 0) {
+                std::cerr << "Файл карты повреждён: " << inputs[n] << "\n";
+                return false;
+            }
+            sources[{record.qx, record.qy}].emplace_back(n, &record);
+        }
+        files.push_back(std::move(input));
+    }
+
+    std::vector<MergeRole> roles(layers_.channelCount(), options.mode == MergeMode::Max ? MergeRole::Max : MergeRole::Add);
+    if (options.mode != MergeMode::Max) {
+        if (layers_.lastSeenChannel() >= 0)
+            roles[layers_.lastSeenChannel()] = MergeRole::Max;
+        if (layers_.occupancyChannel() >= 0)
+            roles[layers_.occupancyChannel()] = MergeRole::Clamp;
+    }
+
+    // Свёрнутый квадрант: блоки по (tj, ti), то есть в порядке getNonEmptyBlocks
+    struct Reduced {
+        MapQuadrantRecord record{};
+        std::map<std::pair<int, int>, std::vector<float>> blocks;
+        std::uint64_t blocksRead = 0;
+    };
+    std::vector<const std::pair<const QuadrantKey, std::vector<std::pair<std::size_t, const MapQuadrantRecord *>>> *> keys;
+    keys.reserve(sources.size());
+    for (const auto &item : sources)
+        keys.push_back(&item);
+
+    auto reduce = [&](std::size_t k, Reduced &out) {
+        const QuadrantKey &key = keys[k]->first;
+        const auto &records = keys[k]->second;
+        // Размер квадранта задаёт первый вход; записи другого размера пропускаются, как в loadMapFile
+        const MapQuadrantRecord &first = *records.front().second;
+        out.record = {key.first, key.second, first.rows, first.cols, 0, 0};
+        const int tileRows = (first.rows + TileGrid::TILE_MASK) >> TileGrid::TILE_SHIFT;
+        const int tileCols = (first.cols + TileGrid::TILE_MASK) >> TileGrid::TILE_SHIFT;
+        for (const auto &source : records) {
+            const Input &input = *files[source.first];
+            const MapQuadrantRecord &record = *source.second;
+            if (record.rows != first.rows || record.cols != first.cols) {
+                std::cerr << "Размер квадранта (" << key.first << ", " << key.second << ") в файле карты "
+                          << inputs[source.first] << " не совпадает, квадрант пропущен\n";
+                continue;
+            }
+            for (std::uint64_t b = record.firstBlock; b < record.firstBlock + record.blockCount; b++) {
+                const MapBlockRecord &block = input.blocks[b];
+                if (block.ti < 0 || block.tj < 0 || block.ti >= tileRows || block.tj >= tileCols)
+                    continue;
+                std::vector<float> &acc = out.blocks[{block.tj, block.ti}];
+                if (acc.empty()) {
+                    // Каналы Max начинаются с -inf, а не с 0: иначе отрицательные значения
+                    // (лог-шансы occupancy) терялись бы. Блок, который есть хотя бы в одном
+                    // входе, перезаписывает -inf во всех ячейках
+                    acc.assign(blockFloats, 0.0f);
+                    for (std::size_t channel = 0; channel < roles.size(); channel++) {
+                        if (roles[channel] != MergeRole::Max)
+                            continue;
+                        for (std::uint64_t cell = channel; cell < blockFloats; cell += layers_.stride())
+                            acc[cell] = -std::numeric_limits<float>::infinity();
+                    }
+                }
+                mergeMapBlock(acc.data(), input.data + b * blockFloats, layers_.stride(), roles, input.weight,
+                              layers_.logOddsMin, layers_.logOddsMax);
+                out.blocksRead++;
+            }
+        }
+        // Блоки, обнулённые весами, не пишутся, как пустые блоки в saveMapFile
+        for (auto it = out.blocks.begin(); it != out.blocks.end();) {
+            const std::vector<float> &values = it->second;
+            if (std::all_of(values.begin(), values.end(), [](float v) { return v == 0.0f; }))
+                it = out.blocks.erase(it);
+            else
+                ++it;
+        }
+    };
+
+    const std::string tmpName = output + ".tmp";
+    std::ofstream ofs(tmpName, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        std::cerr << "Не удалось открыть файл карты для записи: " << tmpName << "\n";
+        return false;
+    }
+    const std::vector<char> headerPage(MAP_PAGE, 0);
+    ofs.write(headerPage.data(), headerPage.size());
+
+    // Потоки берут ключи по порядку, но не уходят дальше window ключей от записанного:
+    // готовые квадранты ждут записи в кольце из window ячеек
+    const int threads = std::max(options.threads, 1);
+    const std::size_t window = 2 * static_cast<std::size_t>(threads);
+    std::vector<Reduced> ring(window);
+    std::vector<bool> ready(window, false);
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::size_t written = 0;
+
+    // Запись в порядке ключей — в отдельном потоке, свёртка — в parallelFor
+    MergeStats result;
+    result.inputs = inputs.size();
+    std::vector<MapQuadrantRecord> quadrantTable;
+    std::vector<MapBlockRecord> blockTable;
+    std::thread writer([&]() {
+        for (std::size_t k = 0; k < keys.size(); k++) {
+            Reduced reduced;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return ready[k % window]; });
+                reduced = std::move(ring[k % window]);
+                ring[k % window] = Reduced();
+                ready[k % window] = false;
+                written++;
+            }
+            changed.notify_all();
+            result.blocksRead += reduced.blocksRead;
+            if (reduced.blocks.empty())
+                continue;
+            reduced.record.firstBlock = blockTable.size();
+            for (const auto &block : reduced.blocks) {
+                ofs.write(reinterpret_cast<const char *>(block.second.data()), sizeof(float) * block.second.size());
+                blockTable.push_back({block.first.second, block.first.first});
+            }
+            reduced.record.blockCount = blockTable.size() - reduced.record.firstBlock;
+            quadrantTable.push_back(reduced.record);
+        }
+    });
+    parallelFor(keys.size(), threads, [&](std::size_t k) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return k < written + window; });
+        }
+        Reduced reduced;
+        reduce(k, reduced);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ring[k % window] = std::move(reduced);
+            ready[k % window] = true;
+        }
+        changed.notify_all();
+    });
+    writer.join();
+
+    result.quadrants = quadrantTable.size();
+    result.blocksWritten = blockTable.size();
+    if (stats)
+        *stats = result;
+    const MapFileHeader header = makeMapHeader(quadrantSize_, resolution_, layers_, quadrantTable.size(),
+                                               blockTable.size());
+    return finishMapFile(ofs, tmpName, output, header, quadrantTable, blockTable);
+}
+
+bool GlobalGridMapHandler::saveQuadrant(const QuadrantKey &key, const std::string &fileName, const std::string &layer,
+                                        const ImageOptions &options) const {
     auto it = quadrants_.find(key);
     if (it == quadrants_.end()) {
         std::cerr << "Квадрант (" << key.first << ", " << key.second << ") не существует.\n";
         return false;
     }
-    return it->second->saveAsImage(fileName);
+    bool saved = false;
+    withQuadrant(it->second, [&](const QuadrantMap& map) { saved = map.saveAsImage(fileName, layer, options); });
+    return saved;
 }
 
-void GlobalGridMapHandler::saveAllQuadrants(const std::string &prefix) const {
-    for (const auto &item : quadrants_) {
-        QuadrantKey key = item.first;
+void GlobalGridMapHandler::saveAllQuadrants(const std::string &prefix, const std::string &layer,
+                                            const ImageOptions &options) const {
+    std::vector<const Quadrant*> quadrants;
+    {
+        std::shared_lock<std::shared_mutex> lock(quadrantsMutex_);
+        quadrants.reserve(quadrants_.size());
+        for (const auto &item : quadrants_)
+            quadrants.push_back(&item.second);
+    }
+    const std::vector<int> params = options.encoderParams();
+    std::mutex logMutex;
+    // Квадранты независимы: каждый поток сам рендерит и кодирует свой
+    parallelFor(quadrants.size(), options.threads, [&](std::size_t k) {
+        const QuadrantKey key = quadrants[k]->key;
         std::ostringstream oss;
-        oss << prefix << "_" << key.first << "_" << key.second << ".png";
-        if (item.second->saveAsImage(oss.str()))
+        oss << prefix << "_";
+        if (layer != "heat")
+            oss << layer << "_";
+        oss << key.first << "_" << key.second << ".png";
+        bool rendered = false;
+        bool skipped = false;
+        bool saved = false;
+        {
+            PROFILE_SCOPE(SaveImage);
+            cv::Mat image;
+            withQuadrant(*quadrants[k], [&](const QuadrantMap& map) { rendered = map.renderImage(layer, options, image); });
+            skipped = rendered && image.empty();
+            saved = rendered && (skipped || cv::imwrite(oss.str(), image, params));
+        }
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (skipped)
+            std::cout << "Пустой квадрант пропущен: " << oss.str() << "\n";
+        else if (saved)
             std::cout << "Квадрант сохранён: " << oss.str() << "\n";
         else
             std::cerr << "Ошибка сохранения квадранта: " << oss.str() << "\n";
-    }
+    });
 }
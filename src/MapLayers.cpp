@@ -0,0 +1,82 @@
+#include "MapLayers.hpp"
+
+#include <algorithm>
+
+int MapLayers::channelCount() const {
+    return 1 + static_cast<int>(classes.size()) + (observations ? 1 : 0) + (lastSeen ? 1 : 0) +
+           (occupancy ? 1 : 0);
+}
+
+int MapLayers::stride() const {
+    int s = 1;
+    while (s < channelCount())
+        s <<= 1;
+    return s;
+}
+
+int MapLayers::cellBytes() const {
+    switch (heatCell) {
+    case CellType::UInt16:
+        return 2;
+    case CellType::UInt8Log:
+        return 1;
+    default:
+        return stride() * static_cast<int>(sizeof(float));
+    }
+}
+
+std::vector<std::string> MapLayers::channelNames() const {
+    std::vector<std::string> names{"heat"};
+    for (std::uint8_t label : classes)
+        names.push_back("hits_" + std::to_string(label));
+    if (observations)
+        names.push_back("observations");
+    if (lastSeen)
+        names.push_back("last_seen");
+    if (occupancy)
+        names.push_back("occupancy");
+    return names;
+}
+
+int MapLayers::channelOf(const std::string& name) const {
+    const std::vector<std::string> names = channelNames();
+    auto it = std::find(names.begin(), names.end(), name);
+    return it == names.end() ? -1 : static_cast<int>(it - names.begin());
+}
+
+int MapLayers::classChannel(std::uint8_t label) const {
+    auto it = std::find(classes.begin(), classes.end(), label);
+    return it == classes.end() ? -1 : 1 + static_cast<int>(it - classes.begin());
+}
+
+int MapLayers::observationsChannel() const {
+    return observations ? 1 + static_cast<int>(classes.size()) : -1;
+}
+
+int MapLayers::lastSeenChannel() const {
+    return lastSeen ? channelCount() - 1 - (occupancy ? 1 : 0) : -1;
+}
+
+int MapLayers::occupancyChannel() const {
+    return occupancy ? channelCount() - 1 : -1;
+}
+
+bool MapLayers::isValid() const {
+    if (channelCount() > MAX_CHANNELS)
+        return false;
+    if (occupancy && !(logOddsMin <= 0.0f && logOddsMax >= 0.0f))
+        return false;
+    if (heatCell != CellType::Float32 && (channelCount() != 1 || !(heatScale > 0.0f)))
+        return false;
+    std::vector<std::uint8_t> sorted = classes;
+    std::sort(sorted.begin(), sorted.end());
+    return std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+}
+
+bool MapLayers::operator==(const MapLayers& other) const {
+    return heatLabels == other.heatLabels && classes == other.classes &&
+           observations == other.observations && lastSeen == other.lastSeen &&
+           timeOrigin == other.timeOrigin && occupancy == other.occupancy &&
+           (!occupancy || (logOddsHit == other.logOddsHit && logOddsMiss == other.logOddsMiss &&
+                           logOddsMin == other.logOddsMin && logOddsMax == other.logOddsMax));
+}
@@ -0,0 +1,358 @@
+#include "MapPyramid.hpp"
+#include "ParallelFor.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int TILE = MapPyramid::TILE_SIZE;
+constexpr int REGION = 2 * TILE; // тайл уровня maxZoom - 1 в ячейках карты
+
+using TileKey = std::pair<int, int>; // (x, y) тайла внутри уровня
+
+std::int64_t floorDiv(std::int64_t a, std::int64_t b) {
+    std::int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+std::string tilePath(const std::string& root, int z, int x, int y, const char* extension) {
+    return root + "/" + std::to_string(z) + "/" + std::to_string(x) + "/" + std::to_string(y) + extension;
+}
+
+// Сворачивает область REGION x REGION (по строкам) в тайл TILE x TILE
+void reduce2x2(const float* src, float* dst, PyramidReduction reduction) {
+    for (int r = 0; r < TILE; r++) {
+        const float* top = src + static_cast<std::size_t>(2 * r) * REGION;
+        const float* bottom = top + REGION;
+        float* out = dst + static_cast<std::size_t>(r) * TILE;
+        if (reduction == PyramidReduction::Sum) {
+            for (int c = 0; c < TILE; c++)
+                out[c] = top[2 * c] + top[2 * c + 1] + bottom[2 * c] + bottom[2 * c + 1];
+        } else {
+            for (int c = 0; c < TILE; c++)
+                out[c] = std::max(std::max(top[2 * c], top[2 * c + 1]), std::max(bottom[2 * c], bottom[2 * c + 1]));
+        }
+    }
+}
+
+bool isEmpty(const float* values, std::size_t stride, int rows, int cols) {
+    for (int r = 0; r < rows; r++) {
+        const float* row = values + r * stride;
+        for (int c = 0; c < cols; c++) {
+            if (row[c] != 0.0f)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Записывает тайл TILE x TILE (строки с шагом stride) в png; пустой тайл удаляется.
+// written — был ли записан файл
+bool writePng(const std::string& path, const float* values, std::size_t stride, float scale,
+              const PyramidConfig& config, bool& written) {
+    written = false;
+    std::error_code ec;
+    if (isEmpty(values, stride, TILE, TILE)) {
+        std::filesystem::remove(path, ec);
+        return true;
+    }
+    const float range = config.displayMax - config.displayMin;
+    cv::Mat gray(TILE, TILE, CV_8UC1);
+    for (int r = 0; r < TILE; r++) {
+        const float* row = values + r * stride;
+        uchar* out = gray.ptr<uchar>(r);
+        for (int c = 0; c < TILE; c++) {
+            const float t = (row[c] / scale - config.displayMin) / range;
+            out[c] = static_cast<uchar>(std::lround(std::min(std::max(t, 0.0f), 1.0f) * 255.0f));
+        }
+    }
+    cv::Mat color;
+    cv::applyColorMap(gray, color, cv::COLORMAP_JET);
+    // Пустые ячейки прозрачны, чтобы тайлы можно было накладывать на подложку
+    cv::Mat image(TILE, TILE, CV_8UC4);
+    for (int r = 0; r < TILE; r++) {
+        const float* row = values + r * stride;
+        const cv::Vec3b* in = color.ptr<cv::Vec3b>(r);
+        cv::Vec4b* out = image.ptr<cv::Vec4b>(r);
+        for (int c = 0; c < TILE; c++)
+            out[c] = cv::Vec4b(in[c][0], in[c][1], in[c][2], row[c] != 0.0f ? 255 : 0);
+    }
+    if (!cv::imwrite(path, image)) {
+        std::cerr << "Не удалось сохранить тайл: " << path << "\n";
+        return false;
+    }
+    written = true;
+    return true;
+}
+
+// Сырые значения тайла: TILE * TILE float по строкам; пустой тайл удаляется
+bool writeRaw(const std::string& path, const float* values) {
+    std::error_code ec;
+    if (isEmpty(values, TILE, TILE, TILE)) {
+        std::filesystem::remove(path, ec);
+        return true;
+    }
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(values), sizeof(float) * TILE * TILE);
+    if (!ofs) {
+        std::cerr << "Не удалось сохранить сырой тайл: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Читает сырой тайл; отсутствующий тайл пуст
+bool readRaw(const std::string& path, float* values) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        std::fill(values, values + TILE * TILE, 0.0f);
+        return true;
+    }
+    if (!ifs.read(reinterpret_cast<char*>(values), sizeof(float) * TILE * TILE)) {
+        std::cerr << "Сырой тайл повреждён: " << path << "\n";
+        std::fill(values, values + TILE * TILE, 0.0f);
+        return false;
+    }
+    return true;
+}
+
+bool createDirectory(const std::string& path) {
+    std::error_code ec;
+    std::filesystem::create_directories(path, ec);
+    if (ec) {
+        std::cerr << "Не удалось создать папку тайлов: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+MapPyramid::MapPyramid(const PyramidConfig& config) : config_(config) {}
+
+void MapPyramid::markExported(const GlobalGridMapHandler& map) {
+    exported_.clear();
+    for (const auto& item : map.getQuadrantVersions())
+        exported_.insert(item);
+}
+
+bool MapPyramid::exportTiles(const GlobalGridMapHandler& map, const std::string& directory) {
+    tilesWritten_ = 0;
+    const int maxZoom = config_.maxZoom;
+    const int channel = map.getLayers().channelOf(config_.layer);
+    if (maxZoom < 1 || maxZoom > 22 || config_.minZoom < 0 || config_.minZoom >= maxZoom ||
+        !(config_.displayMax > config_.displayMin)) {
+        std::cerr << "Некорректные параметры пирамиды: нужно 0 <= minZoom < maxZoom <= 22, displayMin < displayMax\n";
+        return false;
+    }
+    if (channel < 0) {
+        std::cerr << "Слой \"" << config_.layer << "\" не найден.\n";
+        return false;
+    }
+
+    // Ячейка (gx, gy) карты — пиксель (gx + half, half - 1 - gy) уровня maxZoom
+    const std::int64_t half = (std::int64_t(1) << (maxZoom - 1)) * TILE;
+    const std::int64_t regionsPerAxis = std::int64_t(1) << (maxZoom - 1);
+    const std::int64_t cellsPerQuadrant = std::llround(map.getQuadrantSize() / map.getResolution());
+    const std::string rawRoot = directory + "/raw";
+
+    // Квадранты, изменившиеся с прошлого экспорта
+    const std::vector<std::pair<QuadrantKey, std::uint64_t>> versions = map.getQuadrantVersions();
+    std::set<QuadrantKey> existing;
+    std::vector<QuadrantKey> changed;
+    for (const auto& item : versions) {
+        existing.insert(item.first);
+        auto it = exported_.find(item.first);
+        if (it == exported_.end() || it->second != item.second)
+            changed.push_back(item.first);
+    }
+    if (changed.empty())
+        return true;
+
+    // Тайлы уровня maxZoom - 1 (области 2x2 тайлов исходного уровня) над изменёнными квадрантами
+    auto clampRegion = [&](std::int64_t v) { return std::min(std::max(v, std::int64_t(0)), regionsPerAxis - 1); };
+    std::set<TileKey> dirty;
+    for (const QuadrantKey& key : changed) {
+        const std::int64_t gx0 = key.first * cellsPerQuadrant;
+        const std::int64_t gy0 = key.second * cellsPerQuadrant;
+        const std::int64_t x0 = floorDiv(gx0 + half, REGION), x1 = floorDiv(gx0 + cellsPerQuadrant - 1 + half, REGION);
+        const std::int64_t y0 = floorDiv(half - gy0 - cellsPerQuadrant, REGION), y1 = floorDiv(half - 1 - gy0, REGION);
+        if (x1 < 0 || y1 < 0 || x0 >= regionsPerAxis || y0 >= regionsPerAxis)
+            continue;
+        for (std::int64_t x = clampRegion(x0); x <= clampRegion(x1); x++)
+            for (std::int64_t y = clampRegion(y0); y <= clampRegion(y1); y++)
+                dirty.emplace(static_cast<int>(x), static_cast<int>(y));
+    }
+
+    // Для каждой области — квадранты, из которых она собирается
+    std::map<QuadrantKey, std::vector<TileKey>> quadrantRegions;
+    std::map<TileKey, int> remaining;
+    for (const TileKey& region : dirty) {
+        const std::int64_t gx0 = std::int64_t(region.first) * REGION - half;
+        const std::int64_t gy1 = half - 1 - std::int64_t(region.second) * REGION;
+        for (std::int64_t qx = floorDiv(gx0, cellsPerQuadrant); qx <= floorDiv(gx0 + REGION - 1, cellsPerQuadrant); qx++) {
+            for (std::int64_t qy = floorDiv(gy1 - REGION + 1, cellsPerQuadrant); qy <= floorDiv(gy1, cellsPerQuadrant); qy++) {
+                const QuadrantKey key(static_cast<int>(qx), static_cast<int>(qy));
+                if (!existing.count(key))
+                    continue;
+                quadrantRegions[key].push_back(region);
+                remaining[region]++;
+            }
+        }
+    }
+
+    std::atomic<bool> ok{true};
+    std::atomic<std::size_t> written{0};
+    std::map<TileKey, std::vector<float>> buffers;
+
+    // Готовая область: четыре тайла исходного уровня и тайл уровня maxZoom - 1
+    auto finishRegions = [&](const std::vector<TileKey>& ready) {
+        for (const TileKey& region : ready) {
+            ok = createDirectory(directory + "/" + std::to_string(maxZoom) + "/" + std::to_string(2 * region.first)) && ok;
+            ok = createDirectory(directory + "/" + std::to_string(maxZoom) + "/" + std::to_string(2 * region.first + 1)) && ok;
+            ok = createDirectory(directory + "/" + std::to_string(maxZoom - 1) + "/" + std::to_string(region.first)) && ok;
+            ok = createDirectory(rawRoot + "/" + std::to_string(maxZoom - 1) + "/" + std::to_string(region.first)) && ok;
+        }
+        parallelFor(ready.size(), config_.threads, [&](std::size_t k) {
+            const TileKey& region = ready[k];
+            const float* cells = buffers.at(region).data();
+            bool pngWritten = false;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    const float* tile = cells + static_cast<std::size_t>(dy * TILE) * REGION + dx * TILE;
+                    if (!writePng(tilePath(directory, maxZoom, 2 * region.first + dx, 2 * region.second + dy, ".png"),
+                                  tile, REGION, 1.0f, config_, pngWritten))
+                        ok = false;
+                    written += pngWritten;
+                }
+            }
+            std::vector<float> reduced(static_cast<std::size_t>(TILE) * TILE);
+            reduce2x2(cells, reduced.data(), config_.reduction);
+            const float scale = config_.reduction == PyramidReduction::Sum ? 4.0f : 1.0f;
+            if (!writeRaw(tilePath(rawRoot, maxZoom - 1, region.first, region.second, ".f32"), reduced.data()) ||
+                !writePng(tilePath(directory, maxZoom - 1, region.first, region.second, ".png"),
+                          reduced.data(), TILE, scale, config_, pngWritten))
+                ok = false;
+            written += pngWritten;
+        });
+        for (const TileKey& region : ready)
+            buffers.erase(region);
+    };
+
+    // Квадранты читаются по одному; блоки квадранта раскладываются по областям параллельно
+    for (const auto& item : quadrantRegions) {
+        const QuadrantKey& key = item.first;
+        for (const TileKey& region : item.second) {
+            if (!buffers.count(region))
+                buffers[region].assign(static_cast<std::size_t>(REGION) * REGION, 0.0f);
+        }
+        const bool visited = map.visitQuadrant(key, [&](const QuadrantMap& quadrant) {
+            const grid_map::Size size = quadrant.getSize();
+            const grid_map::Index start = quadrant.getStartIndex();
+            const int stride = quadrant.getLayers().stride();
+            const std::vector<std::pair<int, int>> blocks = quadrant.getNonEmptyBlocks();
+            // Ячейка буфера с несмещённым индексом (iu, ju) — глобальная ячейка
+            // ((qx + 1) * n - 1 - iu, (qy + 1) * n - 1 - ju): индекс 0 у максимальных координат
+            const std::int64_t topX = (std::int64_t(key.first) + 1) * cellsPerQuadrant - 1;
+            const std::int64_t topY = (std::int64_t(key.second) + 1) * cellsPerQuadrant - 1;
+            parallelFor(blocks.size(), config_.threads, [&](std::size_t k) {
+                thread_local std::vector<float> block;
+                block.resize(quadrant.blockFloats());
+                const int ti = blocks[k].first;
+                const int tj = blocks[k].second;
+                quadrant.readBlock(ti, tj, block.data());
+                const int i0 = ti << TileGrid::TILE_SHIFT;
+                const int j0 = tj << TileGrid::TILE_SHIFT;
+                const int h = std::min(TileGrid::TILE_SIZE, size(0) - i0);
+                const int w = std::min(TileGrid::TILE_SIZE, size(1) - j0);
+                TileKey cachedRegion(-1, -1);
+                float* cachedBuffer = nullptr;
+                for (int c = 0; c < w; c++) {
+                    const int ju = ((j0 + c - start(1)) % size(1) + size(1)) % size(1);
+                    const std::int64_t row = half - 1 - (topY - ju);
+                    for (int r = 0; r < h; r++) {
+                        const float v = block[static_cast<std::size_t>(r + (c << TileGrid::TILE_SHIFT)) * stride + channel];
+                        if (v == 0.0f)
+                            continue;
+                        const int iu = ((i0 + r - start(0)) % size(0) + size(0)) % size(0);
+                        const std::int64_t col = topX - iu + half;
+                        const TileKey region(static_cast<int>(floorDiv(col, REGION)), static_cast<int>(floorDiv(row, REGION)));
+                        if (region != cachedRegion) {
+                            auto it = buffers.find(region); // структура buffers здесь не меняется
+                            cachedBuffer = it == buffers.end() ? nullptr : it->second.data();
+                            cachedRegion = region;
+                        }
+                        if (cachedBuffer)
+                            cachedBuffer[(row - std::int64_t(region.second) * REGION) * REGION +
+                                         (col - std::int64_t(region.first) * REGION)] = v;
+                    }
+                }
+            });
+        });
+        if (!visited) {
+            std::cerr << "Не удалось прочитать квадрант (" << key.first << ", " << key.second << ") для тайлов\n";
+            ok = false;
+        }
+        std::vector<TileKey> ready;
+        for (const TileKey& region : item.second) {
+            if (--remaining[region] == 0)
+                ready.push_back(region);
+        }
+        finishRegions(ready);
+    }
+
+    // Грубые уровни: тайл собирается из четырёх сырых тайлов уровня ниже
+    for (int z = maxZoom - 2; z >= config_.minZoom; z--) {
+        std::set<TileKey> parentSet;
+        for (const TileKey& child : dirty)
+            parentSet.emplace(child.first / 2, child.second / 2);
+        const std::vector<TileKey> parents(parentSet.begin(), parentSet.end());
+        for (const TileKey& parent : parents) {
+            ok = createDirectory(directory + "/" + std::to_string(z) + "/" + std::to_string(parent.first)) && ok;
+            ok = createDirectory(rawRoot + "/" + std::to_string(z) + "/" + std::to_string(parent.first)) && ok;
+        }
+        const float scale = config_.reduction == PyramidReduction::Sum
+                                ? std::pow(4.0f, static_cast<float>(maxZoom - z)) : 1.0f;
+        parallelFor(parents.size(), config_.threads, [&](std::size_t k) {
+            const TileKey& parent = parents[k];
+            std::vector<float> cells(static_cast<std::size_t>(REGION) * REGION);
+            std::vector<float> child(static_cast<std::size_t>(TILE) * TILE);
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    if (!readRaw(tilePath(rawRoot, z + 1, 2 * parent.first + dx, 2 * parent.second + dy, ".f32"), child.data()))
+                        ok = false;
+                    for (int r = 0; r < TILE; r++)
+                        std::copy(child.begin() + r * TILE, child.begin() + (r + 1) * TILE,
+                                  cells.begin() + static_cast<std::size_t>(dy * TILE + r) * REGION + dx * TILE);
+                }
+            }
+            std::vector<float> reduced(static_cast<std::size_t>(TILE) * TILE);
+            reduce2x2(cells.data(), reduced.data(), config_.reduction);
+            bool pngWritten = false;
+            if (!writeRaw(tilePath(rawRoot, z, parent.first, parent.second, ".f32"), reduced.data()) ||
+                !writePng(tilePath(directory, z, parent.first, parent.second, ".png"),
+                          reduced.data(), TILE, scale, config_, pngWritten))
+                ok = false;
+            written += pngWritten;
+        });
+        dirty = std::move(parentSet);
+    }
+
+    tilesWritten_ = written;
+    // При ошибке счётчики не запоминаются: те же тайлы перестроятся в следующий раз
+    if (!ok)
+        return false;
+    for (const auto& item : versions)
+        exported_[item.first] = item.second;
+    return true;
+}
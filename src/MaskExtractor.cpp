@@ -0,0 +1,98 @@
+#include "MaskExtractor.hpp"
+#include "Profiler.hpp"
+#include "Simd.hpp"
+
+#include <algorithm>
+#include <thread>
+
+MaskExtractor::MaskExtractor(std::uint8_t label)
+    : MaskExtractor(std::vector<std::uint8_t>{label}) {}
+
+MaskExtractor::MaskExtractor(const std::vector<std::uint8_t>& labels) {
+    for (std::uint8_t label : labels) {
+        if (!table_[label]) {
+            table_[label] = true;
+            labels_.push_back(label);
+        }
+    }
+}
+
+void MaskExtractor::setThreads(int threads) {
+    threads_ = std::max(1, threads);
+}
+
+const std::uint8_t* MaskExtractor::rowLabels(const cv::Mat& frame, int row, const cv::Rect& roi,
+                                             std::vector<std::uint8_t>& scratch) {
+    if (frame.type() != CV_8UC3)
+        return frame.ptr<std::uint8_t>(row) + roi.x;
+    // Метка трёхканального кадра — целое среднее каналов
+    scratch.resize(roi.width);
+    const std::uint8_t* bgr = frame.ptr<std::uint8_t>(row) + 3 * roi.x;
+    for (int c = 0; c < roi.width; c++)
+        scratch[c] = static_cast<std::uint8_t>((bgr[3 * c] + bgr[3 * c + 1] + bgr[3 * c + 2]) / 3);
+    return scratch.data();
+}
+
+void MaskExtractor::extractRows(const cv::Mat& frame, const cv::Rect& roi, int rowBegin, int rowEnd,
+                                std::vector<MaskPixel>& out) const {
+    const simd::ByteMatcher matcher(labels_.data(), static_cast<int>(labels_.size()));
+    const bool vectorized = labels_.size() <= static_cast<std::size_t>(simd::ByteMatcher::MAX_LABELS);
+    const int width = roi.width;
+    std::vector<std::uint8_t> scratch;
+
+    for (int r = rowBegin; r < rowEnd; r++) {
+        const std::uint8_t* labels = rowLabels(frame, r, roi, scratch);
+
+        const std::uint16_t row = static_cast<std::uint16_t>(r);
+        int c = 0;
+        if (vectorized) {
+            for (; c + simd::ByteMatcher::BYTES <= width; c += simd::ByteMatcher::BYTES) {
+                std::uint32_t mask = matcher.match(labels + c);
+                while (mask) {
+                    const int k = __builtin_ctz(mask);
+                    mask &= mask - 1;
+                    out.push_back({row, static_cast<std::uint16_t>(roi.x + c + k), labels[c + k]});
+                }
+            }
+        }
+        for (; c < width; c++) {
+            if (table_[labels[c]])
+                out.push_back({row, static_cast<std::uint16_t>(roi.x + c), labels[c]});
+        }
+    }
+}
+
+std::size_t MaskExtractor::extract(const cv::Mat& frame, const cv::Rect& roi, std::vector<MaskPixel>& out) const {
+    PROFILE_SCOPE(Mask);
+    out.clear();
+    if (frame.type() != CV_8UC1 && frame.type() != CV_8UC3)
+        return 0;
+    const cv::Rect area = roi & cv::Rect(0, 0, frame.cols, frame.rows);
+    if (area.empty())
+        return 0;
+
+    const int bands = std::min(threads_, area.height);
+    if (bands <= 1) {
+        extractRows(frame, area, area.y, area.y + area.height, out);
+        return out.size();
+    }
+
+    // Полосы строк обрабатываются параллельно и склеиваются по порядку
+    std::vector<std::vector<MaskPixel>> parts(bands);
+    std::vector<std::thread> workers;
+    for (int b = 0; b < bands; b++) {
+        const int rowBegin = area.y + area.height * b / bands;
+        const int rowEnd = area.y + area.height * (b + 1) / bands;
+        workers.emplace_back([&, b, rowBegin, rowEnd] { extractRows(frame, area, rowBegin, rowEnd, parts[b]); });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    std::size_t total = 0;
+    for (const auto& part : parts)
+        total += part.size();
+    out.reserve(total);
+    for (const auto& part : parts)
+        out.insert(out.end(), part.begin(), part.end());
+    return out.size();
+}
@@ -0,0 +1,33 @@
+#include "PoseTransform.hpp"
+#include "Simd.hpp"
+#include <cmath>
+
+PoseTransform::PoseTransform(double x, double y, double yawDegrees, bool mirrorX) {
+    const float rad = static_cast<float>(yawDegrees * CV_PI / 180.0);
+    const float cosA = std::cos(rad);
+    const float sinA = std::sin(rad);
+    const float sx = mirrorX ? -1.f : 1.f;
+    a_[0] = sx * cosA;
+    a_[1] = -sx * sinA;
+    a_[2] = sx * static_cast<float>(x);
+    a_[3] = sinA;
+    a_[4] = cosA;
+    a_[5] = static_cast<float>(y);
+}
+
+void PoseTransform::apply(const cv::Point2f* src, cv::Point2f* dst, std::size_t count) const {
+    using namespace simd;
+    const float* in = reinterpret_cast<const float*>(src);
+    float* out = reinterpret_cast<float*>(dst);
+    const FloatV a0 = broadcast(a_[0]), a1 = broadcast(a_[1]), a2 = broadcast(a_[2]);
+    const FloatV a3 = broadcast(a_[3]), a4 = broadcast(a_[4]), a5 = broadcast(a_[5]);
+
+    std::size_t i = 0;
+    for (; i + WIDTH <= count; i += WIDTH) {
+        FloatV x, y;
+        loadInterleaved(in + 2 * i, x, y);
+        storeInterleaved(out + 2 * i, a0 * x + a1 * y + a2, a3 * x + a4 * y + a5);
+    }
+    for (; i < count; i++)
+        dst[i] = apply(src[i]);
+}
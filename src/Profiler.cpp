@@ -0,0 +1,202 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+constexpr int PROBE_COUNT = static_cast<int>(Profiler::Probe::Count);
+constexpr int COUNTER_COUNT = static_cast<int>(Profiler::Counter::Count);
+
+const char* const PROBE_NAMES[PROBE_COUNT] = {
+    "decode", "pose", "mask", "projection", "camera_project", "accumulate", "save_image"};
+
+// Срабатывание пробы для трассы (время — нс от начала отсчёта)
+struct Event
+{
+    std::uint64_t start;
+    std::uint64_t duration;
+    Profiler::Probe probe;
+};
+
+// Буфер одного потока: пишет только владелец, читают после окончания работы
+struct ThreadBuffer
+{
+    int thread = 0;
+    std::vector<std::uint64_t> durations[PROBE_COUNT]; // нс
+    std::vector<Event> events;
+    std::uint64_t counters[COUNTER_COUNT] = {};
+    std::uint64_t first = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t last = 0;
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    // Буферы живут дольше своих потоков: сводка строится после их завершения
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::atomic<bool> trace{false};
+    const Profiler::Clock::time_point origin = Profiler::Clock::now();
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer& localBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = r.buffers.back().get();
+        buffer->thread = static_cast<int>(r.buffers.size());
+    }
+    return *buffer;
+}
+
+std::uint64_t sinceOrigin(Profiler::Clock::time_point t) {
+    // Самая первая проба начинается раньше, чем создаётся реестр
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - registry().origin).count();
+    return ns > 0 ? static_cast<std::uint64_t>(ns) : 0;
+}
+
+// Значение перцентиля p (0..1) отсортированной выборки
+std::uint64_t percentile(const std::vector<std::uint64_t>& sorted, double p) {
+    const std::size_t k = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(k, sorted.size() - 1)];
+}
+
+} // namespace
+
+void Profiler::enableTrace(bool enable) {
+    registry().trace.store(enable, std::memory_order_relaxed);
+}
+
+void Profiler::record(Probe probe, Clock::time_point start, Clock::time_point end) {
+    ThreadBuffer& buffer = localBuffer();
+    const std::uint64_t begin = sinceOrigin(start);
+    const std::uint64_t finish = sinceOrigin(end);
+    const std::uint64_t duration = finish > begin ? finish - begin : 0;
+    buffer.durations[static_cast<int>(probe)].push_back(duration);
+    buffer.first = std::min(buffer.first, begin);
+    buffer.last = std::max(buffer.last, begin + duration);
+    if (registry().trace.load(std::memory_order_relaxed))
+        buffer.events.push_back({begin, duration, probe});
+}
+
+void Profiler::add(Counter counter, std::uint64_t value) {
+    localBuffer().counters[static_cast<int>(counter)] += value;
+}
+
+void Profiler::printSummary(std::ostream& os) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    std::uint64_t counters[COUNTER_COUNT] = {};
+    std::uint64_t first = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t last = 0;
+    std::vector<std::uint64_t> durations[PROBE_COUNT];
+    for (const auto& buffer : r.buffers) {
+        for (int c = 0; c < COUNTER_COUNT; c++)
+            counters[c] += buffer->counters[c];
+        for (int p = 0; p < PROBE_COUNT; p++)
+            durations[p].insert(durations[p].end(), buffer->durations[p].begin(), buffer->durations[p].end());
+        first = std::min(first, buffer->first);
+        last = std::max(last, buffer->last);
+    }
+
+    const double seconds = last > first ? (last - first) * 1e-9 : 0.0;
+    const std::uint64_t frames = counters[static_cast<int>(Counter::Frames)];
+    const std::uint64_t points = counters[static_cast<int>(Counter::Points)];
+    os << std::fixed << std::setprecision(3)
+       << "профиль: " << seconds << " с, кадров " << frames << " ("
+       << (seconds > 0.0 ? frames / seconds : 0.0) << "/с), точек " << points << " ("
+       << std::setprecision(0) << (seconds > 0.0 ? points / seconds : 0.0) << "/с)\n";
+
+    // setw считает байты: буква кириллицы в UTF-8 занимает два
+    os << std::left << std::setw(16 + 5) << "проба" << std::right
+       << std::setw(10 + 7) << "вызовов" << std::setw(12 + 6) << "сумма, с" << std::setw(12 + 2) << "p50, мс"
+       << std::setw(12 + 2) << "p99, мс" << std::setw(12 + 6) << "макс, мс" << "\n";
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        std::vector<std::uint64_t>& d = durations[p];
+        if (d.empty())
+            continue;
+        std::sort(d.begin(), d.end());
+        std::uint64_t total = 0;
+        for (std::uint64_t v : d)
+            total += v;
+        os << std::left << std::setw(16) << PROBE_NAMES[p] << std::right
+           << std::setw(10) << d.size() << std::setprecision(3)
+           << std::setw(12) << total * 1e-9
+           << std::setw(12) << percentile(d, 0.50) * 1e-6
+           << std::setw(12) << percentile(d, 0.99) * 1e-6
+           << std::setw(12) << d.back() * 1e-6 << "\n";
+    }
+    os << "квадрантов создано: " << counters[static_cast<int>(Counter::Quadrants)]
+       << ", выделено под ячейки: " << std::setprecision(1)
+       << counters[static_cast<int>(Counter::BytesAllocated)] / (1024.0 * 1024.0) << " МБ\n";
+    os.unsetf(std::ios::floatfield);
+}
+
+bool Profiler::writeChromeTrace(const std::string& fileName) {
+    Registry& r = registry();
+    if (!r.trace.load(std::memory_order_relaxed)) {
+        std::cerr << "Трасса не записывалась (Profiler::enableTrace)\n";
+        return false;
+    }
+    std::ofstream ofs(fileName);
+    if (!ofs.is_open()) {
+        std::cerr << "Не удалось открыть файл: " << fileName << "\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    // Полные события ("ph":"X"), время в микросекундах
+    ofs << "{\"traceEvents\":[\n";
+    bool firstEvent = true;
+    char line[192];
+    for (const auto& buffer : r.buffers) {
+        std::snprintf(line, sizeof(line),
+                      "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                      firstEvent ? "" : ",\n", buffer->thread, buffer->thread);
+        ofs << line;
+        firstEvent = false;
+        for (const Event& e : buffer->events) {
+            std::snprintf(line, sizeof(line),
+                          ",\n{\"name\":\"%s\",\"cat\":\"map_builder\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                          "\"ts\":%.3f,\"dur\":%.3f}",
+                          PROBE_NAMES[static_cast<int>(e.probe)], buffer->thread, e.start * 1e-3, e.duration * 1e-3);
+            ofs << line;
+        }
+    }
+    ofs << "\n]}\n";
+    if (!ofs) {
+        std::cerr << "Ошибка записи трассы: " << fileName << "\n";
+        return false;
+    }
+    return true;
+}
+
+void Profiler::reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    // Буферы не удаляются: на них ссылаются thread_local указатели потоков
+    for (auto& buffer : r.buffers) {
+        for (auto& d : buffer->durations)
+            d.clear();
+        buffer->events.clear();
+        std::fill(std::begin(buffer->counters), std::end(buffer->counters), 0);
+        buffer->first = std::numeric_limits<std::uint64_t>::max();
+        buffer->last = 0;
+    }
+}
@@ -0,0 +1,192 @@
+#include "ProjectionLut.hpp"
+#include "Camera.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr char LUT_MAGIC[8] = {'M', 'B', 'L', 'U', 'T', 0, 0, 0};
+constexpr std::uint32_t LUT_VERSION = 2;
+
+// Заголовок файла таблицы; данные начинаются с выровненного смещения sizeof(LutFileHeader):
+// roiWidth * roiHeight точек float2, затем столько же площадей float (версия 2)
+struct LutFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t roiX;
+    std::int32_t roiY;
+    std::int32_t roiWidth;
+    std::int32_t roiHeight;
+    float homography[9];
+    std::uint8_t reserved[128 - 8 - 4 * 7 - 4 * 9];
+};
+static_assert(sizeof(LutFileHeader) == 128, "заголовок LUT должен занимать 128 байт");
+
+void homographyToFloat(const Camera& camera, float out[9]) {
+    cv::Mat H;
+    camera.getHomography().convertTo(H, CV_64F);
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+            out[r * 3 + c] = static_cast<float>(H.at<double>(r, c));
+}
+
+} // namespace
+
+ProjectionLut::~ProjectionLut() {
+    release();
+}
+
+void ProjectionLut::release() {
+    mapped_.close();
+    table_.clear();
+    table_.shrink_to_fit();
+    areaTable_.clear();
+    areaTable_.shrink_to_fit();
+    data_ = nullptr;
+    area_ = nullptr;
+}
+
+bool ProjectionLut::build(const Camera& camera, const cv::Size& imageSize, const cv::Rect& roi) {
+    if (roi.x < 0 || roi.y < 0 || roi.width <= 0 || roi.height <= 0 ||
+        roi.x + roi.width > imageSize.width || roi.y + roi.height > imageSize.height) {
+        std::cerr << "ROI таблицы проекции выходит за пределы кадра\n";
+        return false;
+    }
+    release();
+    imageSize_ = imageSize;
+    roi_ = roi;
+    homographyToFloat(camera, homography_);
+
+    table_.resize(static_cast<std::size_t>(roi.width) * roi.height);
+    for (int r = 0; r < roi.height; r++) {
+        cv::Point2f* row = table_.data() + static_cast<std::size_t>(r) * roi.width;
+        for (int c = 0; c < roi.width; c++)
+            row[c] = cv::Point2f(static_cast<float>(roi.x + c), static_cast<float>(roi.y + r));
+        camera.projectPoints(row, row, roi.width);
+    }
+
+    // Якобиан проективного отображения: |det J| = |det H| / |w|^3, w = h20 u + h21 v + h22
+    cv::Mat H;
+    camera.getHomography().convertTo(H, CV_64F);
+    const double det = std::fabs(cv::determinant(H));
+    areaTable_.resize(table_.size());
+    for (int r = 0; r < roi.height; r++) {
+        float* row = areaTable_.data() + static_cast<std::size_t>(r) * roi.width;
+        const double v = roi.y + r;
+        for (int c = 0; c < roi.width; c++) {
+            const double w = std::fabs(H.at<double>(2, 0) * (roi.x + c) + H.at<double>(2, 1) * v + H.at<double>(2, 2));
+            row[c] = static_cast<float>(det / (w * w * w));
+        }
+    }
+    data_ = table_.data();
+    area_ = areaTable_.data();
+    return true;
+}
+
+bool ProjectionLut::save(const std::string& fileName) const {
+    if (empty()) {
+        std::cerr << "Таблица проекции не построена\n";
+        return false;
+    }
+    LutFileHeader header{};
+    std::memcpy(header.magic, LUT_MAGIC, sizeof(LUT_MAGIC));
+    header.version = LUT_VERSION;
+    header.width = imageSize_.width;
+    header.height = imageSize_.height;
+    header.roiX = roi_.x;
+    header.roiY = roi_.y;
+    header.roiWidth = roi_.width;
+    header.roiHeight = roi_.height;
+    std::memcpy(header.homography, homography_, sizeof(homography_));
+
+    // Пишем во временный файл и переименовываем: кэш может быть отображён
+    // в память другими процессами, и обрезка на месте привела бы к SIGBUS
+    const std::string tmpName = fileName + ".tmp";
+    std::ofstream ofs(tmpName, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+        std::cerr << "Не удалось открыть файл: " << tmpName << std::endl;
+        return false;
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(data_),
+              static_cast<std::streamsize>(sizeof(cv::Point2f) * roi_.width * roi_.height));
+    ofs.write(reinterpret_cast<const char*>(area_),
+              static_cast<std::streamsize>(sizeof(float) * roi_.width * roi_.height));
+    ofs.close();
+    std::error_code ec;
+    if (ofs)
+        std::filesystem::rename(tmpName, fileName, ec);
+    if (!ofs || ec) {
+        std::cerr << "Ошибка записи таблицы проекции: " << fileName << std::endl;
+        std::filesystem::remove(tmpName, ec);
+        return false;
+    }
+    return true;
+}
+
+bool ProjectionLut::load(const std::string& fileName) {
+    release();
+    if (!mapped_.open(fileName))
+        return false;
+
+    const LutFileHeader* header = reinterpret_cast<const LutFileHeader*>(mapped_.data());
+    const std::size_t expected = sizeof(LutFileHeader) +
+        (mapped_.size() >= sizeof(LutFileHeader)
+             ? (sizeof(cv::Point2f) + sizeof(float)) * static_cast<std::size_t>(header->roiWidth) * header->roiHeight
+             : 0);
+    if (mapped_.size() < sizeof(LutFileHeader) ||
+        std::memcmp(header->magic, LUT_MAGIC, sizeof(LUT_MAGIC)) != 0 ||
+        header->version != LUT_VERSION || header->roiWidth <= 0 || header->roiHeight <= 0 ||
+        mapped_.size() != expected) {
+        mapped_.close();
+        std::cerr << "Файл таблицы проекции повреждён: " << fileName << std::endl;
+        return false;
+    }
+
+    imageSize_ = cv::Size(header->width, header->height);
+    roi_ = cv::Rect(header->roiX, header->roiY, header->roiWidth, header->roiHeight);
+    std::memcpy(homography_, header->homography, sizeof(homography_));
+    data_ = reinterpret_cast<const cv::Point2f*>(mapped_.data() + sizeof(LutFileHeader));
+    area_ = reinterpret_cast<const float*>(data_ + static_cast<std::size_t>(roi_.width) * roi_.height);
+    return true;
+}
+
+bool ProjectionLut::matches(const Camera& camera, const cv::Size& imageSize, const cv::Rect& roi) const {
+    if (empty() || imageSize_ != imageSize || roi_ != roi)
+        return false;
+    float h[9];
+    homographyToFloat(camera, h);
+    for (int i = 0; i < 9; i++) {
+        if (std::fabs(h[i] - homography_[i]) > 1e-6f * std::max(1.f, std::fabs(h[i])))
+            return false;
+    }
+    return true;
+}
+
+std::size_t ProjectionLut::gather(const cv::Mat& mask, cv::Point2f* dst, std::size_t capacity) const {
+    if (empty() || mask.type() != CV_8UC1 || mask.size() != imageSize_) {
+        std::cerr << "gather: маска не соответствует таблице проекции\n";
+        return 0;
+    }
+    std::size_t written = 0;
+    for (int r = roi_.y; r < roi_.y + roi_.height; r++) {
+        const uchar* m = mask.ptr<uchar>(r);
+        const cv::Point2f* lutRow = &at(r, roi_.x);
+        for (int c = roi_.x; c < roi_.x + roi_.width; c++) {
+            if (m[c]) {
+                if (written == capacity)
+                    return written;
+                dst[written++] = lutRow[c - roi_.x];
+            }
+        }
+    }
+    return written;
+}
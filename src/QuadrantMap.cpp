@@ -1,17 +1,220 @@
 #include "QuadrantMap.hpp"
+#include "Profiler.hpp"
+#include "Simd.hpp"
 #include <opencv2/opencv.hpp>
+#include <cmath>
 #include <iostream>
 #include <limits>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Переводит координаты точки в индекс буфера grid_map без обращения к слоям
+struct CellIndexer {
+    explicit CellIndexer(const grid_map::GridMap& map) {
+        const grid_map::Size size = map.getSize();
+        const grid_map::Length length = map.getLength();
+        const grid_map::Position center = map.getPosition();
+        start = map.getStartIndex();
+        // Индекс 0 в grid_map соответствует максимальным координатам карты
+        maxX = center.x() + 0.5 * length.x();
+        maxY = center.y() + 0.5 * length.y();
+        invResolution = 1.0 / map.getResolution();
+        rows = size(0);
+        cols = size(1);
+        wrap = start(0) != 0 || start(1) != 0;
+    }
+
+    bool operator()(double x, double y, int& i, int& j) const {
+        const double fi = (maxX - x) * invResolution;
+        const double fj = (maxY - y) * invResolution;
+        if (!(fi >= 0.0 && fj >= 0.0 && fi < rows && fj < cols))
+            return false;
+        i = static_cast<int>(fi);
+        j = static_cast<int>(fj);
+        if (wrap) {
+            i = (i + start(0)) % rows;
+            j = (j + start(1)) % cols;
+        }
+        return true;
+    }
+
+    double maxX, maxY, invResolution;
+    int rows, cols;
+    grid_map::Index start;
+    bool wrap;
+};
+
+// Коды CellType::UInt8Log в единицах heatScale: до LOG_LINEAR_CODES точно,
+// дальше каждый код на 1/LOG_LINEAR_CODES больше предыдущего (до ~3e7 единиц)
+constexpr int LOG_LINEAR_CODES = 16;
+
+const std::array<float, 256>& logCodes() {
+    static const std::array<float, 256> codes = [] {
+        std::array<float, 256> table{};
+        for (int b = 0; b < 256; b++)
+            table[b] = b <= LOG_LINEAR_CODES ? static_cast<float>(b)
+                                             : table[b - 1] * (1.0f + 1.0f / LOG_LINEAR_CODES);
+        return table;
+    }();
+    return codes;
+}
+
+// Равномерное [0, 1) для случайного округления (xorshift32): при одном порядке
+// добавления точек результат воспроизводится
+inline float nextDither(std::uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+}
+
+inline float unitsOf(std::uint16_t count) { return static_cast<float>(count); }
+inline float unitsOf(std::uint8_t code) { return logCodes()[code]; }
+
+// Насыщающий счётчик: дробная часть приращения даёт +1 с вероятностью, равной ей
+inline void addToCell(std::uint16_t& cell, float units, std::uint32_t& dither) {
+    if (!(units > 0.0f))
+        return;
+    units = std::min(units, 65535.0f);
+    const float whole = std::floor(units);
+    const std::uint32_t n = cell + static_cast<std::uint32_t>(whole) + (units - whole > nextDither(dither) ? 1u : 0u);
+    cell = static_cast<std::uint16_t>(std::min<std::uint32_t>(n, 65535u));
+}
+
+// Логарифмический код: новое значение между кодами b и b + 1 округляется
+// к b + 1 с вероятностью, при которой среднее значение ячейки не смещается
+inline void addToCell(std::uint8_t& cell, float units, std::uint32_t& dither) {
+    if (!(units > 0.0f))
+        return;
+    const std::array<float, 256>& codes = logCodes();
+    const float target = codes[cell] + units;
+    if (target >= codes[255]) {
+        cell = 255;
+        return;
+    }
+    const int b = static_cast<int>(std::upper_bound(codes.begin() + cell, codes.end(), target) - codes.begin()) - 1;
+    const float fraction = (target - codes[b]) / (codes[b + 1] - codes[b]);
+    cell = static_cast<std::uint8_t>(b + (fraction > nextDither(dither) ? 1 : 0));
+}
+
+// Минимум и максимум кодов по ячейкам внутри сетки (невыделенные плитки — нули)
+template <typename T>
+void compactMinMax(const CompactTileGrid<T>& grid, T& lo, T& hi) {
+    lo = std::numeric_limits<T>::max();
+    hi = 0;
+    for (int tj = 0; tj < grid.tileCols(); tj++) {
+        for (int ti = 0; ti < grid.tileRows(); ti++) {
+            const T* t = grid.tile(ti, tj);
+            if (!t) {
+                lo = 0;
+                continue;
+            }
+            const int h = std::min(TileGrid::TILE_SIZE, grid.rows() - (ti << TileGrid::TILE_SHIFT));
+            const int w = std::min(TileGrid::TILE_SIZE, grid.cols() - (tj << TileGrid::TILE_SHIFT));
+            for (int c = 0; c < w; c++) {
+                const T* column = t + (static_cast<std::size_t>(c) << TileGrid::TILE_SHIFT);
+                for (int r = 0; r < h; r++) {
+                    lo = std::min(lo, column[r]);
+                    hi = std::max(hi, column[r]);
+                }
+            }
+        }
+    }
+}
+
+constexpr char QUADRANT_MAGIC[4] = {'M', 'B', 'Q', 'D'};
+constexpr std::uint32_t QUADRANT_VERSION = 3;
+
+// Заголовок бинарного квадранта; за ним следуют blockCount блоков BlockHeader + плитка
+// (TILE_CELLS * stride float или TILE_CELLS компактных ячеек cellType)
+struct QuadrantHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t storage;
+    std::uint32_t blockCount;
+    std::uint32_t channels;
+    std::uint32_t stride;
+    std::uint32_t cellType;
+    float heatScale;
+    double lengthX;
+    double lengthY;
+    double resolution;
+    double centerX;
+    double centerY;
+    std::int32_t startI;
+    std::int32_t startJ;
+};
+
+struct BlockHeader {
+    std::int32_t ti;
+    std::int32_t tj;
+};
+
+} // namespace
+
+QuadrantMap::QuadrantMap(double width, double height, double resolution, double centerX, double centerY,
+                         QuadrantStorage storage, std::shared_ptr<TilePool> tilePool, const MapLayers &layers)
+    : storage_(storage),
+      layers_(layers),
+      channelNames_(layers.channelNames()),
+      stride_(layers.stride()),
+      lastSeenChannel_(layers.lastSeenChannel()),
+      occupancyChannel_(layers.occupancyChannel()),
+      cellType_(storage == QuadrantStorage::Sparse && layers.isValid() ? layers.heatCell : CellType::Float32),
+      heatScale_(layers.heatScale) {
+    for (std::uint8_t label : layers_.heatLabels)
+        heatLabel_[label] = true;
+    for (std::uint8_t label : layers_.classes)
+        classChannel_[label] = static_cast<std::int8_t>(layers_.classChannel(label));
 
-QuadrantMap::QuadrantMap(double width, double height, double resolution, double centerX, double centerY) {
     gridMap_.setGeometry(grid_map::Length(width, height),
                          resolution,
                          grid_map::Position(centerX, centerY));
-    gridMap_.add(LAYER_NAME, 0.0f);
+    if (storage_ == QuadrantStorage::Dense) {
+        for (const std::string &name : channelNames_)
+            gridMap_.add(name, 0.0f);
+    } else {
+        const grid_map::Size size = gridMap_.getSize();
+        if (cellType_ == CellType::UInt16)
+            counts16_ = std::make_unique<CompactTileGrid<std::uint16_t>>(size(0), size(1), std::move(tilePool));
+        else if (cellType_ == CellType::UInt8Log)
+            codes8_ = std::make_unique<CompactTileGrid<std::uint8_t>>(size(0), size(1), std::move(tilePool));
+        else
+            tiles_ = std::make_unique<TileGrid>(size(0), size(1), std::move(tilePool), stride_);
+    }
+}
+
+void QuadrantMap::addUnits(int i, int j, float units) {
+    if (counts16_)
+        addToCell(counts16_->ref(i, j), units, dither_);
+    else
+        addToCell(codes8_->ref(i, j), units, dither_);
+}
+
+std::size_t QuadrantMap::blockBytes() const {
+    if (counts16_)
+        return TileGrid::TILE_CELLS * sizeof(std::uint16_t);
+    if (codes8_)
+        return TileGrid::TILE_CELLS * sizeof(std::uint8_t);
+    return blockFloats() * sizeof(float);
 }
 
 void QuadrantMap::addPoint(double x, double y, float value) {
+    if (storage_ == QuadrantStorage::Sparse) {
+        int i, j;
+        if (!CellIndexer(gridMap_)(x, y, i, j))
+            return;
+        if (compact())
+            addUnits(i, j, value / heatScale_);
+        else
+            tiles_->ref(i, j) += value;
+        return;
+    }
     grid_map::Position pos(x, y);
     if (gridMap_.isInside(pos)) {
         grid_map::Index index;
@@ -21,39 +224,854 @@ void QuadrantMap::addPoint(double x, double y, float value) {
     }
 }
 
-bool QuadrantMap::saveAsImage(const std::string &fileName) const {
-    if (!gridMap_.exists(LAYER_NAME)) {
-        std::cerr << "Слой \"" << LAYER_NAME << "\" не найден.\n";
+void QuadrantMap::addPoints(const cv::Point2f* points, std::size_t count, float value) {
+    const CellIndexer indexer(gridMap_);
+    int i, j;
+
+    if (compact()) {
+        const float units = value / heatScale_;
+        for (std::size_t k = 0; k < count; k++) {
+            if (indexer(points[k].x, points[k].y, i, j))
+                addUnits(i, j, units);
+        }
+        return;
+    }
+    if (storage_ == QuadrantStorage::Sparse) {
+        for (std::size_t k = 0; k < count; k++) {
+            if (indexer(points[k].x, points[k].y, i, j))
+                tiles_->ref(i, j) += value;
+        }
+        return;
+    }
+
+    float* data = gridMap_.get(LAYER_NAME).data();
+    const std::size_t rows = static_cast<std::size_t>(indexer.rows);
+    for (std::size_t k = 0; k < count; k++) {
+        if (indexer(points[k].x, points[k].y, i, j))
+            data[i + j * rows] += value; // матрица хранится по столбцам
+    }
+}
+
+void QuadrantMap::addWeightedPoints(const cv::Point2f* points, const float* weights, std::size_t count,
+                                    float value) {
+    const CellIndexer indexer(gridMap_);
+    int i, j;
+
+    if (compact()) {
+        const float units = value / heatScale_;
+        for (std::size_t k = 0; k < count; k++) {
+            if (indexer(points[k].x, points[k].y, i, j))
+                addUnits(i, j, units * weights[k]);
+        }
+        return;
+    }
+    if (storage_ == QuadrantStorage::Sparse) {
+        for (std::size_t k = 0; k < count; k++) {
+            if (indexer(points[k].x, points[k].y, i, j))
+                tiles_->ref(i, j) += value * weights[k];
+        }
+        return;
+    }
+
+    float* data = gridMap_.get(LAYER_NAME).data();
+    const std::size_t rows = static_cast<std::size_t>(indexer.rows);
+    for (std::size_t k = 0; k < count; k++) {
+        if (indexer(points[k].x, points[k].y, i, j))
+            data[i + j * rows] += value * weights[k];
+    }
+}
+
+void QuadrantMap::addSplats(const cv::Point2f* points, const float* weights, std::size_t count, float value) {
+    const CellIndexer indexer(gridMap_);
+    float* dense = storage_ == QuadrantStorage::Dense ? gridMap_.get(LAYER_NAME).data() : nullptr;
+    const int rows = indexer.rows;
+    const int cols = indexer.cols;
+    const std::size_t denseRow = static_cast<std::size_t>(rows);
+    // Соседние по j ячейки: в плотном слое через столбец матрицы, в плитке через 64 ячейки
+    const std::size_t stepI = dense ? 1 : static_cast<std::size_t>(stride_);
+    const std::size_t stepJ = dense ? denseRow : static_cast<std::size_t>(stride_) << TileGrid::TILE_SHIFT;
+    const bool packed = compact();
+    const float invScale = 1.0f / heatScale_;
+
+    auto bufferIndex = [](int u, int start, int size) {
+        u += start;
+        return u >= size ? u - size : u;
+    };
+    auto add = [&](int i, int j, float v) {
+        if (i < 0 || j < 0 || i >= rows || j >= cols)
+            return;
+        i = bufferIndex(i, indexer.start(0), rows);
+        j = bufferIndex(j, indexer.start(1), cols);
+        if (dense)
+            dense[i + j * denseRow] += v;
+        else if (packed)
+            addUnits(i, j, v * invScale);
+        else
+            tiles_->ref(i, j) += v;
+    };
+    // Четыре отсчёта с ячейкой (i, j) в углу; если все четыре ячейки лежат
+    // в одном столбце буфера и одной плитке, адрес вычисляется один раз
+    auto splat = [&](int i, int j, float w00, float w10, float w01, float w11) {
+        if (!packed && i >= 0 && j >= 0 && i + 1 < rows && j + 1 < cols) {
+            const int bi = bufferIndex(i, indexer.start(0), rows);
+            const int bj = bufferIndex(j, indexer.start(1), cols);
+            const bool contiguous = bi + 1 < rows && bj + 1 < cols &&
+                (dense || ((bi & TileGrid::TILE_MASK) != TileGrid::TILE_MASK &&
+                           (bj & TileGrid::TILE_MASK) != TileGrid::TILE_MASK));
+            if (contiguous) {
+                float* cell = dense ? dense + bi + bj * denseRow : tiles_->cell(bi, bj);
+                cell[0] += w00;
+                cell[stepI] += w10;
+                cell[stepJ] += w01;
+                cell[stepI + stepJ] += w11;
+                return;
+            }
+        }
+        add(i, j, w00);
+        add(i + 1, j, w10);
+        add(i, j + 1, w01);
+        add(i + 1, j + 1, w11);
+    };
+
+    // Соседние пиксели кадра часто делят угловую ячейку: их веса суммируются
+    // в регистрах, и в память пишется одна четвёрка на серию
+    bool pending = false;
+    int pi = 0, pj = 0;
+    float p00 = 0.f, p10 = 0.f, p01 = 0.f, p11 = 0.f;
+    auto pend = [&](int i, int j, float w00, float w10, float w01, float w11) {
+        if (pending && i == pi && j == pj) {
+            p00 += w00;
+            p10 += w10;
+            p01 += w01;
+            p11 += w11;
+            return;
+        }
+        if (pending)
+            splat(pi, pj, p00, p10, p01, p11);
+        pending = true;
+        pi = i;
+        pj = j;
+        p00 = w00;
+        p10 = w10;
+        p01 = w01;
+        p11 = w11;
+    };
+
+    // Непрерывный индекс u = (maxX - x) / resolution - 0.5: центр ячейки i лежит в u = i
+    const float maxX = static_cast<float>(indexer.maxX);
+    const float maxY = static_cast<float>(indexer.maxY);
+    const float inv = static_cast<float>(indexer.invResolution);
+    std::size_t k = 0;
+    const simd::FloatV vMaxX = simd::broadcast(maxX);
+    const simd::FloatV vMaxY = simd::broadcast(maxY);
+    const simd::FloatV vInv = simd::broadcast(inv);
+    const simd::FloatV half = simd::broadcast(0.5f);
+    const simd::FloatV one = simd::broadcast(1.0f);
+    const simd::FloatV vValue = simd::broadcast(value);
+    alignas(32) float gi[simd::WIDTH], gj[simd::WIDTH];
+    alignas(32) float w00[simd::WIDTH], w10[simd::WIDTH], w01[simd::WIDTH], w11[simd::WIDTH];
+    for (; k + simd::WIDTH <= count; k += simd::WIDTH) {
+        simd::FloatV x, y;
+        simd::loadInterleaved(&points[k].x, x, y);
+        const simd::FloatV u = (vMaxX - x) * vInv - half;
+        const simd::FloatV v = (vMaxY - y) * vInv - half;
+        const simd::FloatV fi = simd::floor(u);
+        const simd::FloatV fj = simd::floor(v);
+        const simd::FloatV ti = u - fi;
+        const simd::FloatV tj = v - fj;
+        const simd::FloatV w = simd::load(weights + k) * vValue;
+        const simd::FloatV wj0 = w * (one - tj);
+        const simd::FloatV wj1 = w * tj;
+        simd::store(gi, fi);
+        simd::store(gj, fj);
+        simd::store(w00, wj0 * (one - ti));
+        simd::store(w10, wj0 * ti);
+        simd::store(w01, wj1 * (one - ti));
+        simd::store(w11, wj1 * ti);
+        for (int l = 0; l < simd::WIDTH; l++)
+            pend(static_cast<int>(gi[l]), static_cast<int>(gj[l]), w00[l], w10[l], w01[l], w11[l]);
+    }
+    for (; k < count; k++) {
+        const float u = (maxX - points[k].x) * inv - 0.5f;
+        const float v = (maxY - points[k].y) * inv - 0.5f;
+        const float fi = std::floor(u);
+        const float fj = std::floor(v);
+        const float ti = u - fi;
+        const float tj = v - fj;
+        const float w = weights[k] * value;
+        pend(static_cast<int>(fi), static_cast<int>(fj), w * (1.0f - tj) * (1.0f - ti), w * (1.0f - tj) * ti,
+             w * tj * (1.0f - ti), w * tj * ti);
+    }
+    if (pending)
+        splat(pi, pj, p00, p10, p01, p11);
+}
+
+void QuadrantMap::addObservations(const cv::Point2f *points, const std::uint8_t *labels, std::size_t count,
+                                  float value, double time) {
+    const CellIndexer indexer(gridMap_);
+    const int observationsChannel = layers_.observationsChannel();
+    const float seen = static_cast<float>(time - layers_.timeOrigin);
+    int i, j;
+
+    if (compact()) {
+        // Компактный квадрант ведёт только heat
+        const float units = value / heatScale_;
+        for (std::size_t k = 0; k < count; k++) {
+            if (heatLabel_[labels[k]] && indexer(points[k].x, points[k].y, i, j))
+                addUnits(i, j, units);
+        }
+        return;
+    }
+    if (storage_ == QuadrantStorage::Sparse) {
+        // Все каналы ячейки лежат подряд: одно обращение к памяти на пиксель
+        for (std::size_t k = 0; k < count; k++) {
+            if (!indexer(points[k].x, points[k].y, i, j))
+                continue;
+            float *cell = tiles_->cell(i, j);
+            const std::uint8_t label = labels[k];
+            if (heatLabel_[label])
+                cell[0] += value;
+            if (classChannel_[label])
+                cell[classChannel_[label]] += 1.0f;
+            if (observationsChannel >= 0)
+                cell[observationsChannel] += 1.0f;
+            if (lastSeenChannel_ >= 0)
+                cell[lastSeenChannel_] = std::max(cell[lastSeenChannel_], seen);
+        }
+        return;
+    }
+
+    std::vector<float *> layers;
+    for (const std::string &name : channelNames_)
+        layers.push_back(gridMap_.get(name).data());
+    const std::size_t rows = static_cast<std::size_t>(indexer.rows);
+    for (std::size_t k = 0; k < count; k++) {
+        if (!indexer(points[k].x, points[k].y, i, j))
+            continue;
+        const std::size_t offset = i + j * rows;
+        const std::uint8_t label = labels[k];
+        if (heatLabel_[label])
+            layers[0][offset] += value;
+        if (classChannel_[label])
+            layers[classChannel_[label]][offset] += 1.0f;
+        if (observationsChannel >= 0)
+            layers[observationsChannel][offset] += 1.0f;
+        if (lastSeenChannel_ >= 0)
+            layers[lastSeenChannel_][offset] = std::max(layers[lastSeenChannel_][offset], seen);
+    }
+}
+
+void QuadrantMap::updateOccupancy(const cv::Point2f *cells, const std::uint8_t *hits, std::size_t count) {
+    if (occupancyChannel_ < 0)
+        return;
+    const CellIndexer indexer(gridMap_);
+    const float delta[2] = {layers_.logOddsMiss, layers_.logOddsHit};
+    const float lo = layers_.logOddsMin;
+    const float hi = layers_.logOddsMax;
+    int i, j;
+
+    if (storage_ == QuadrantStorage::Sparse) {
+        for (std::size_t k = 0; k < count; k++) {
+            if (!indexer(cells[k].x, cells[k].y, i, j))
+                continue;
+            float &v = tiles_->cell(i, j)[occupancyChannel_];
+            v = std::min(std::max(v + delta[hits[k] != 0], lo), hi);
+        }
+        return;
+    }
+
+    float *data = gridMap_.get(channelNames_[occupancyChannel_]).data();
+    const std::size_t rows = static_cast<std::size_t>(indexer.rows);
+    for (std::size_t k = 0; k < count; k++) {
+        if (!indexer(cells[k].x, cells[k].y, i, j))
+            continue;
+        float &v = data[i + j * rows];
+        v = std::min(std::max(v + delta[hits[k] != 0], lo), hi);
+    }
+}
+
+void QuadrantMap::mergeCells(const cv::Point2f *cells, const float *values, std::size_t count) {
+    const CellIndexer indexer(gridMap_);
+    const std::size_t channels = channelNames_.size();
+    int i, j;
+
+    if (compact()) {
+        for (std::size_t k = 0; k < count; k++) {
+            if (indexer(cells[k].x, cells[k].y, i, j))
+                addUnits(i, j, values[k] / heatScale_);
+        }
+        return;
+    }
+    if (storage_ == QuadrantStorage::Sparse) {
+        for (std::size_t k = 0; k < count; k++) {
+            if (!indexer(cells[k].x, cells[k].y, i, j))
+                continue;
+            float *cell = tiles_->cell(i, j);
+            const float *in = values + k * channels;
+            for (std::size_t channel = 0; channel < channels; channel++)
+                cell[channel] = mergeChannel(static_cast<int>(channel), cell[channel], in[channel]);
+        }
+        return;
+    }
+
+    std::vector<float *> layers;
+    for (const std::string &name : channelNames_)
+        layers.push_back(gridMap_.get(name).data());
+    const std::size_t rows = static_cast<std::size_t>(indexer.rows);
+    for (std::size_t k = 0; k < count; k++) {
+        if (!indexer(cells[k].x, cells[k].y, i, j))
+            continue;
+        const std::size_t offset = i + j * rows;
+        const float *in = values + k * channels;
+        for (std::size_t channel = 0; channel < channels; channel++)
+            layers[channel][offset] = mergeChannel(static_cast<int>(channel), layers[channel][offset], in[channel]);
+    }
+}
+
+void QuadrantMap::takeRange(int i0, int i1, int j0, int j1, std::vector<cv::Point2f> &cells,
+                            std::vector<float> &values) {
+    const std::size_t channels = channelNames_.size();
+    const grid_map::Size size = gridMap_.getSize();
+    const grid_map::Index start = gridMap_.getStartIndex();
+    const grid_map::Length length = gridMap_.getLength();
+    const grid_map::Position center = gridMap_.getPosition();
+    const double resolution = gridMap_.getResolution();
+    // Индекс 0 без учёта кольцевого буфера — угол с максимальными координатами
+    const double maxX = center.x() + 0.5 * length.x();
+    const double maxY = center.y() + 0.5 * length.y();
+    std::vector<float *> layers;
+    if (storage_ == QuadrantStorage::Dense) {
+        for (const std::string &name : channelNames_)
+            layers.push_back(gridMap_.get(name).data());
+    }
+
+    const bool packed = compact();
+    float cell[MapLayers::MAX_CHANNELS];
+    for (int j = j0; j < j1; j++) {
+        const int uj = (j - start(1) + size(1)) % size(1);
+        for (int i = i0; i < i1; i++) {
+            bool empty = true;
+            if (packed) {
+                const bool allocated = withCompact([&](auto &grid) {
+                    auto *tile = grid.tile(i >> TileGrid::TILE_SHIFT, j >> TileGrid::TILE_SHIFT);
+                    if (!tile)
+                        return false;
+                    auto &stored = tile[(i & TileGrid::TILE_MASK) + ((j & TileGrid::TILE_MASK) << TileGrid::TILE_SHIFT)];
+                    cell[0] = unitsOf(stored) * heatScale_;
+                    empty = stored == 0;
+                    stored = 0;
+                    return true;
+                });
+                if (!allocated) {
+                    i |= TileGrid::TILE_MASK;
+                    continue;
+                }
+            } else if (storage_ == QuadrantStorage::Sparse) {
+                if (!tiles_->tile(i >> TileGrid::TILE_SHIFT, j >> TileGrid::TILE_SHIFT)) {
+                    i |= TileGrid::TILE_MASK; // до конца невыделенной плитки
+                    continue;
+                }
+                float *stored = tiles_->cell(i, j);
+                for (std::size_t channel = 0; channel < channels; channel++) {
+                    cell[channel] = stored[channel];
+                    empty &= stored[channel] == 0.0f;
+                    stored[channel] = 0.0f;
+                }
+            } else {
+                const std::size_t offset = i + static_cast<std::size_t>(j) * size(0);
+                for (std::size_t channel = 0; channel < channels; channel++) {
+                    cell[channel] = layers[channel][offset];
+                    empty &= cell[channel] == 0.0f;
+                    layers[channel][offset] = 0.0f;
+                }
+            }
+            if (empty)
+                continue;
+            const int ui = (i - start(0) + size(0)) % size(0);
+            cells.emplace_back(static_cast<float>(maxX - (ui + 0.5) * resolution),
+                               static_cast<float>(maxY - (uj + 0.5) * resolution));
+            values.insert(values.end(), cell, cell + channels);
+        }
+    }
+}
+
+void QuadrantMap::move(double centerX, double centerY, std::vector<cv::Point2f> &cells, std::vector<float> &values) {
+    const grid_map::Size size = gridMap_.getSize();
+    const grid_map::Position center = gridMap_.getPosition();
+    const double resolution = gridMap_.getResolution();
+    const long long shift[2] = {std::llround((centerX - center.x()) / resolution),
+                                std::llround((centerY - center.y()) / resolution)};
+    if (shift[0] == 0 && shift[1] == 0)
+        return;
+
+    // Сдвиг центра на +n ячеек уводит из квадранта n ячеек с наибольшими
+    // индексами без учёта кольцевого буфера (самые малые координаты), на -n — с наименьшими
+    const grid_map::Index start = gridMap_.getStartIndex();
+    std::vector<int> freed[2]; // освобождённые строки и столбцы (индексы хранения)
+    for (int axis = 0; axis < 2; axis++) {
+        const int n = static_cast<int>(std::min<long long>(std::llabs(shift[axis]), size(axis)));
+        for (int k = 0; k < n; k++) {
+            const int unwrapped = shift[axis] > 0 ? size(axis) - 1 - k : k;
+            const int index = (unwrapped + start(axis)) % size(axis);
+            freed[axis].push_back(index);
+            // Угловые ячейки обнулены первой осью и второй раз не выгружаются
+            if (axis == 0)
+                takeRange(index, index + 1, 0, size(1), cells, values);
+            else
+                takeRange(0, size(0), index, index + 1, cells, values);
+        }
+    }
+    gridMap_.move(grid_map::Position(center.x() + shift[0] * resolution, center.y() + shift[1] * resolution));
+    // grid_map заполняет освободившиеся полосы NaN, а накопление в Dense прибавляет к ячейке:
+    // без обнуления ячейки навсегда остались бы NaN
+    if (storage_ == QuadrantStorage::Dense) {
+        for (const std::string &name : channelNames_) {
+            grid_map::Matrix &layer = gridMap_.get(name);
+            for (int index : freed[0])
+                layer.row(index).setZero();
+            for (int index : freed[1])
+                layer.col(index).setZero();
+        }
+    }
+}
+
+void QuadrantMap::takeCells(std::vector<cv::Point2f> &cells, std::vector<float> &values) {
+    const grid_map::Size size = gridMap_.getSize();
+    takeRange(0, size(0), 0, size(1), cells, values);
+}
+
+double QuadrantMap::getTotal() const {
+    if (compact()) {
+        return heatScale_ * withCompact([](const auto &grid) {
+            double total = 0.0;
+            for (int tj = 0; tj < grid.tileCols(); tj++) {
+                for (int ti = 0; ti < grid.tileRows(); ti++) {
+                    const auto *tile = grid.tile(ti, tj);
+                    if (!tile)
+                        continue;
+                    for (std::size_t k = 0; k < TileGrid::TILE_CELLS; k++)
+                        total += unitsOf(tile[k]);
+                }
+            }
+            return total;
+        });
+    }
+    if (storage_ == QuadrantStorage::Sparse)
+        return tiles_->sum();
+    // Суммируем в double по месту, без копии слоя
+    const grid_map::Matrix &layer = gridMap_.get(LAYER_NAME);
+    const float *values = layer.data();
+    const std::size_t count = static_cast<std::size_t>(layer.size());
+    double total = 0.0;
+    for (std::size_t k = 0; k < count; k++)
+        total += values[k];
+    return total;
+}
+
+std::size_t QuadrantMap::getMemoryBytes() const {
+    if (compact())
+        return withCompact([](const auto &grid) { return grid.memoryBytes(); });
+    if (storage_ == QuadrantStorage::Sparse)
+        return tiles_->memoryBytes();
+    return static_cast<std::size_t>(gridMap_.get(LAYER_NAME).size()) * sizeof(float) * channelNames_.size();
+}
+
+std::vector<std::pair<int, int>> QuadrantMap::getNonEmptyBlocks() const {
+    const grid_map::Size size = gridMap_.getSize();
+    const int rows = size(0);
+    const int cols = size(1);
+    const int tileRows = (rows + TileGrid::TILE_MASK) >> TileGrid::TILE_SHIFT;
+    const int tileCols = (cols + TileGrid::TILE_MASK) >> TileGrid::TILE_SHIFT;
+    std::vector<const grid_map::Matrix *> layers;
+    if (storage_ == QuadrantStorage::Dense) {
+        for (const std::string &name : channelNames_)
+            layers.push_back(&gridMap_.get(name));
+    }
+
+    // Плотные слои режутся на блоки того же размера, что и плитки
+    std::vector<std::pair<int, int>> blocks;
+    for (int tj = 0; tj < tileCols; tj++) {
+        for (int ti = 0; ti < tileRows; ti++) {
+            if (storage_ == QuadrantStorage::Sparse) {
+                const bool allocated = compact()
+                    ? withCompact([&](const auto &grid) { return grid.tile(ti, tj) != nullptr; })
+                    : tiles_->tile(ti, tj) != nullptr;
+                if (allocated)
+                    blocks.emplace_back(ti, tj);
+                continue;
+            }
+            const int h = std::min(TileGrid::TILE_SIZE, rows - (ti << TileGrid::TILE_SHIFT));
+            const int w = std::min(TileGrid::TILE_SIZE, cols - (tj << TileGrid::TILE_SHIFT));
+            for (const grid_map::Matrix *layer : layers) {
+                if ((layer->block(ti << TileGrid::TILE_SHIFT, tj << TileGrid::TILE_SHIFT, h, w).array() != 0.0f).any()) {
+                    blocks.emplace_back(ti, tj);
+                    break;
+                }
+            }
+        }
+    }
+    return blocks;
+}
+
+void QuadrantMap::readBlock(int ti, int tj, float *dst) const {
+    if (compact()) {
+        // Единственное место, где компактные ячейки становятся float (вместе с takeRange и imageRow)
+        withCompact([&](const auto &grid) {
+            const auto *tile = grid.tile(ti, tj);
+            if (!tile) {
+                std::fill(dst, dst + TileGrid::TILE_CELLS, 0.0f);
+                return;
+            }
+            for (std::size_t k = 0; k < TileGrid::TILE_CELLS; k++)
+                dst[k] = unitsOf(tile[k]) * heatScale_;
+        });
+        return;
+    }
+    if (storage_ == QuadrantStorage::Sparse) {
+        const float *tile = tiles_->tile(ti, tj);
+        if (tile)
+            std::memcpy(dst, tile, sizeof(float) * blockFloats());
+        else
+            std::fill(dst, dst + blockFloats(), 0.0f);
+        return;
+    }
+    const grid_map::Size size = gridMap_.getSize();
+    const int i0 = ti << TileGrid::TILE_SHIFT;
+    const int j0 = tj << TileGrid::TILE_SHIFT;
+    const int h = std::min(TileGrid::TILE_SIZE, size(0) - i0);
+    const int w = std::min(TileGrid::TILE_SIZE, size(1) - j0);
+    std::fill(dst, dst + blockFloats(), 0.0f);
+    for (std::size_t channel = 0; channel < channelNames_.size(); channel++) {
+        const grid_map::Matrix &layer = gridMap_.get(channelNames_[channel]);
+        for (int c = 0; c < w; c++) {
+            const float *column = &layer(i0, j0 + c);
+            float *out = dst + static_cast<std::size_t>(c << TileGrid::TILE_SHIFT) * stride_ + channel;
+            if (stride_ == 1) {
+                // Столбец блока непрерывен и в матрице, и в плитке
+                std::memcpy(out, column, sizeof(float) * h);
+                continue;
+            }
+            for (int r = 0; r < h; r++)
+                out[static_cast<std::size_t>(r) * stride_] = column[r];
+        }
+    }
+}
+
+void QuadrantMap::addBlock(int ti, int tj, const float *src) {
+    const grid_map::Size size = gridMap_.getSize();
+    const int i0 = ti << TileGrid::TILE_SHIFT;
+    const int j0 = tj << TileGrid::TILE_SHIFT;
+    const int h = std::min(TileGrid::TILE_SIZE, size(0) - i0);
+    const int w = std::min(TileGrid::TILE_SIZE, size(1) - j0);
+    if (ti < 0 || tj < 0 || h <= 0 || w <= 0)
+        return;
+    const int channels = static_cast<int>(channelNames_.size());
+
+    if (compact()) {
+        for (int c = 0; c < w; c++) {
+            for (int r = 0; r < h; r++)
+                addUnits(i0 + r, j0 + c, src[r + (c << TileGrid::TILE_SHIFT)] / heatScale_);
+        }
+        return;
+    }
+    if (storage_ == QuadrantStorage::Sparse) {
+        float *tile = tiles_->mutableTile(ti, tj);
+        for (int c = 0; c < w; c++) {
+            for (int r = 0; r < h; r++) {
+                const std::size_t cell = static_cast<std::size_t>(r + (c << TileGrid::TILE_SHIFT)) * stride_;
+                for (int channel = 0; channel < channels; channel++) {
+                    float &dst = tile[cell + channel];
+                    const float v = src[cell + channel];
+                    dst = mergeChannel(channel, dst, v);
+                }
+            }
+        }
+        return;
+    }
+    for (int channel = 0; channel < channels; channel++) {
+        grid_map::Matrix &layer = gridMap_.get(channelNames_[channel]);
+        for (int c = 0; c < w; c++) {
+            float *column = &layer(i0, j0 + c);
+            const float *in = src + static_cast<std::size_t>(c << TileGrid::TILE_SHIFT) * stride_ + channel;
+            for (int r = 0; r < h; r++) {
+                const float v = in[static_cast<std::size_t>(r) * stride_];
+                column[r] = mergeChannel(channel, column[r], v);
+            }
+        }
+    }
+}
+
+float QuadrantMap::mergeChannel(int channel, float current, float value) const {
+    if (channel == lastSeenChannel_)
+        return std::max(current, value);
+    if (channel == occupancyChannel_) // лог-шансы независимых наблюдений складываются
+        return std::min(std::max(current + value, layers_.logOddsMin), layers_.logOddsMax);
+    return current + value;
+}
+
+bool QuadrantMap::attachBlock(int ti, int tj, float *external) {
+    if (storage_ != QuadrantStorage::Sparse || compact() || ti < 0 || tj < 0 ||
+        ti >= tiles_->tileRows() || tj >= tiles_->tileCols())
         return false;
+    return tiles_->attachTile(ti, tj, external);
+}
+
+std::size_t QuadrantMap::writeBinary(std::ostream &os) const {
+    const std::vector<std::pair<int, int>> blocks = getNonEmptyBlocks();
+
+    QuadrantHeader header{};
+    std::memcpy(header.magic, QUADRANT_MAGIC, sizeof(QUADRANT_MAGIC));
+    header.version = QUADRANT_VERSION;
+    header.storage = static_cast<std::uint32_t>(storage_);
+    header.blockCount = static_cast<std::uint32_t>(blocks.size());
+    header.channels = static_cast<std::uint32_t>(channelNames_.size());
+    header.stride = static_cast<std::uint32_t>(stride_);
+    header.cellType = static_cast<std::uint32_t>(cellType_);
+    header.heatScale = heatScale_;
+    header.lengthX = gridMap_.getLength().x();
+    header.lengthY = gridMap_.getLength().y();
+    header.resolution = gridMap_.getResolution();
+    header.centerX = gridMap_.getPosition().x();
+    header.centerY = gridMap_.getPosition().y();
+    header.startI = gridMap_.getStartIndex()(0);
+    header.startJ = gridMap_.getStartIndex()(1);
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    std::vector<float> buffer(blockFloats());
+    for (const auto &index : blocks) {
+        const BlockHeader block{index.first, index.second};
+        const void *data = nullptr;
+        if (compact())
+            data = withCompact([&](const auto &grid) -> const void * { return grid.tile(block.ti, block.tj); });
+        else if (storage_ == QuadrantStorage::Sparse)
+            data = tiles_->tile(block.ti, block.tj);
+        if (!data) {
+            readBlock(block.ti, block.tj, buffer.data());
+            data = buffer.data();
+        }
+        os.write(reinterpret_cast<const char *>(&block), sizeof(block));
+        os.write(static_cast<const char *>(data), blockBytes());
+    }
+    if (!os)
+        return 0;
+    return sizeof(header) + blocks.size() * (sizeof(BlockHeader) + blockBytes());
+}
+
+std::unique_ptr<QuadrantMap> QuadrantMap::readBinary(std::istream &is, std::shared_ptr<TilePool> tilePool,
+                                                     const MapLayers &layers) {
+    QuadrantHeader header{};
+    if (!is.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, QUADRANT_MAGIC, sizeof(QUADRANT_MAGIC)) != 0 ||
+        header.version != QUADRANT_VERSION) {
+        std::cerr << "Неверный формат бинарного квадранта\n";
+        return nullptr;
     }
+    if (header.channels != static_cast<std::uint32_t>(layers.channelCount()) ||
+        header.stride != static_cast<std::uint32_t>(layers.stride())) {
+        std::cerr << "Слои бинарного квадранта не совпадают с ожидаемыми\n";
+        return nullptr;
+    }
+    const QuadrantStorage storage = header.storage == static_cast<std::uint32_t>(QuadrantStorage::Sparse)
+                                        ? QuadrantStorage::Sparse : QuadrantStorage::Dense;
+    auto quadrant = std::make_unique<QuadrantMap>(header.lengthX, header.lengthY, header.resolution,
+                                                  header.centerX, header.centerY, storage, std::move(tilePool),
+                                                  layers);
+    quadrant->gridMap_.setStartIndex(grid_map::Index(header.startI, header.startJ));
+    if (header.cellType != static_cast<std::uint32_t>(quadrant->cellType_) ||
+        (quadrant->compact() && header.heatScale != quadrant->heatScale_)) {
+        std::cerr << "Тип ячеек бинарного квадранта не совпадает с ожидаемым\n";
+        return nullptr;
+    }
+
+    std::vector<float> buffer(quadrant->blockFloats());
+    for (std::uint32_t b = 0; b < header.blockCount; b++) {
+        BlockHeader block{};
+        if (!is.read(reinterpret_cast<char *>(&block), sizeof(block))) {
+            std::cerr << "Бинарный квадрант обрезан\n";
+            return nullptr;
+        }
+        if (quadrant->compact()) {
+            // Компактные плитки читаются как есть, без перевода во float и обратно
+            const bool read = quadrant->withCompact([&](auto &grid) {
+                if (block.ti < 0 || block.tj < 0 || block.ti >= grid.tileRows() || block.tj >= grid.tileCols())
+                    return false;
+                return static_cast<bool>(is.read(reinterpret_cast<char *>(grid.mutableTile(block.ti, block.tj)),
+                                                 quadrant->blockBytes()));
+            });
+            if (!read) {
+                std::cerr << "Бинарный квадрант обрезан или повреждён\n";
+                return nullptr;
+            }
+            continue;
+        }
+        if (!is.read(reinterpret_cast<char *>(buffer.data()), sizeof(float) * buffer.size())) {
+            std::cerr << "Бинарный квадрант обрезан\n";
+            return nullptr;
+        }
+        quadrant->addBlock(block.ti, block.tj, buffer.data());
+    }
+    return quadrant;
+}
 
+const float *QuadrantMap::imageRow(const float *dense, int channel, int r, std::vector<float> &scratch) const {
     const grid_map::Size size = gridMap_.getSize();
-    cv::Mat image(size(1), size(0), CV_8UC1);
+    if (dense)
+        return dense + static_cast<std::size_t>(r) * size(0); // столбец матрицы непрерывен
+    scratch.resize(size(0));
+    if (compact()) {
+        withCompact([&](const auto &grid) {
+            const std::size_t offset = static_cast<std::size_t>(r & TileGrid::TILE_MASK) << TileGrid::TILE_SHIFT;
+            for (int ti = 0; ti < grid.tileRows(); ti++) {
+                const int i0 = ti << TileGrid::TILE_SHIFT;
+                const int h = std::min(TileGrid::TILE_SIZE, size(0) - i0);
+                const auto *tile = grid.tile(ti, r >> TileGrid::TILE_SHIFT);
+                for (int k = 0; k < h; k++)
+                    scratch[i0 + k] = tile ? unitsOf(tile[offset + k]) * heatScale_ : 0.0f;
+            }
+        });
+        return scratch.data();
+    }
+    const int stride = tiles_->stride();
+    const std::size_t offset = static_cast<std::size_t>((r & TileGrid::TILE_MASK) << TileGrid::TILE_SHIFT) * stride + channel;
+    for (int ti = 0; ti < tiles_->tileRows(); ti++) {
+        const int i0 = ti << TileGrid::TILE_SHIFT;
+        const int h = std::min(TileGrid::TILE_SIZE, size(0) - i0);
+        const float *tile = tiles_->tile(ti, r >> TileGrid::TILE_SHIFT);
+        if (!tile) {
+            std::fill(scratch.begin() + i0, scratch.begin() + i0 + h, 0.0f);
+            continue;
+        }
+        const float *column = tile + offset;
+        if (stride == 1) {
+            std::memcpy(scratch.data() + i0, column, sizeof(float) * h);
+            continue;
+        }
+        for (int k = 0; k < h; k++)
+            scratch[i0 + k] = column[static_cast<std::size_t>(k) * stride];
+    }
+    return scratch.data();
+}
+
+bool QuadrantMap::renderImage(const std::string &layer, const ImageOptions &options, cv::Mat &image) const {
+    image.release();
+    const int channel = layers_.channelOf(layer);
+    if (channel < 0 || (storage_ == QuadrantStorage::Dense && !gridMap_.exists(layer))) {
+        std::cerr << "Слой \"" << layer << "\" не найден.\n";
+        return false;
+    }
+
+    const grid_map::Size size = gridMap_.getSize();
+    const int rows = size(1);
+    const int cols = size(0);
+    // Плотный слой читается по ссылке, без копии матрицы
+    const float *dense = storage_ == QuadrantStorage::Dense ? gridMap_.get(layer).data() : nullptr;
 
     float minVal = std::numeric_limits<float>::max();
     float maxVal = std::numeric_limits<float>::lowest();
-    const grid_map::Matrix matrix = gridMap_.get(LAYER_NAME);
-    for (int i = 0; i < matrix.size(); i++) {
-        float v = matrix(i);
-        if (v < minVal) minVal = v;
-        if (v > maxVal) maxVal = v;
+    if (dense) {
+        simd::minMax(dense, static_cast<std::size_t>(rows) * cols, minVal, maxVal);
+    } else if (compact()) {
+        // Коды монотонны: минимум и максимум ищутся по кодам, во float переводятся два значения
+        withCompact([&](const auto &grid) {
+            typename std::remove_reference_t<decltype(grid)>::value_type lo, hi;
+            compactMinMax(grid, lo, hi);
+            minVal = unitsOf(lo) * heatScale_;
+            maxVal = unitsOf(hi) * heatScale_;
+        });
+    } else {
+        tiles_->minMax(minVal, maxVal, channel);
     }
+    if (options.skipEmpty && minVal == 0.0f && maxVal == 0.0f)
+        return true;
 
-    for (int r = 0; r < image.rows; r++) {
-        for (int c = 0; c < image.cols; c++) {
-            grid_map::Index index(c, r);
-            float value = gridMap_.at(LAYER_NAME, index);
-            int pixelValue = 0;
-            if (maxVal > minVal) {
-                pixelValue = static_cast<int>(std::round((value - minVal) / (maxVal - minVal) * 255));
+    thread_local std::vector<float> scratch;
+    float upper = maxVal;
+    if (options.scale == ImageScale::Percentile && maxVal > minVal) {
+        // Перцентиль ненулевых значений по гистограмме на [minVal, maxVal]
+        constexpr int BINS = 4096;
+        std::vector<std::uint64_t> histogram(BINS, 0);
+        const float binScale = BINS / (maxVal - minVal);
+        std::uint64_t nonZero = 0;
+        for (int r = 0; r < rows; r++) {
+            const float *values = imageRow(dense, channel, r, scratch);
+            for (int c = 0; c < cols; c++) {
+                if (values[c] == 0.0f)
+                    continue;
+                histogram[std::min(static_cast<int>((values[c] - minVal) * binScale), BINS - 1)]++;
+                nonZero++;
+            }
+        }
+        const double target = nonZero * std::min(std::max(options.percentile, 0.0f), 100.0f) / 100.0;
+        std::uint64_t cumulative = 0;
+        for (int b = 0; b < BINS; b++) {
+            cumulative += histogram[b];
+            if (cumulative >= target) {
+                upper = minVal + (b + 1) / binScale;
+                break;
             }
-            pixelValue = std::min(std::max(pixelValue, 0), 255);
-            image.at<uchar>(r, c) = static_cast<uchar>(pixelValue);
         }
     }
-    cv::Mat colorMap;
-    cv::applyColorMap(image, colorMap, cv::COLORMAP_JET);
-    if (!cv::imwrite(fileName, colorMap)) {
+
+    // Палитра JET один раз на процесс: индекс яркости -> BGR
+    static const std::vector<cv::Vec3b> palette = [] {
+        cv::Mat ramp(1, 256, CV_8UC1);
+        for (int k = 0; k < 256; k++)
+            ramp.ptr<uchar>(0)[k] = static_cast<uchar>(k);
+        cv::Mat colors;
+        cv::applyColorMap(ramp, colors, cv::COLORMAP_JET);
+        return std::vector<cv::Vec3b>(colors.ptr<cv::Vec3b>(0), colors.ptr<cv::Vec3b>(0) + 256);
+    }();
+
+    const bool logScale = options.scale == ImageScale::Log;
+    float factor = 0.0f; // при upper <= minVal изображение заполняется нулевым цветом
+    if (upper > minVal)
+        factor = 255.0f / (logScale ? std::log1p(upper - minVal) : upper - minVal);
+
+    image.create(rows, cols, CV_8UC3);
+    thread_local std::vector<std::uint8_t> indices;
+    indices.resize(cols);
+    for (int r = 0; r < rows; r++) {
+        const float *values = imageRow(dense, channel, r, scratch);
+        // Цикл без ветвлений векторизуется компилятором
+        if (logScale) {
+            for (int c = 0; c < cols; c++) {
+                const float t = std::log1p(std::max(values[c] - minVal, 0.0f)) * factor + 0.5f;
+                indices[c] = static_cast<std::uint8_t>(std::min(std::max(t, 0.0f), 255.0f));
+            }
+        } else {
+            for (int c = 0; c < cols; c++) {
+                const float t = (values[c] - minVal) * factor + 0.5f;
+                indices[c] = static_cast<std::uint8_t>(std::min(std::max(t, 0.0f), 255.0f));
+            }
+        }
+        cv::Vec3b *out = image.ptr<cv::Vec3b>(r);
+        for (int c = 0; c < cols; c++)
+            out[c] = palette[indices[c]];
+    }
+    return true;
+}
+
+std::vector<int> ImageOptions::encoderParams() const {
+    std::vector<int> params;
+    if (pngCompression >= 0)
+        params.insert(params.end(), {cv::IMWRITE_PNG_COMPRESSION, std::min(pngCompression, 9)});
+    static const int strategies[] = {cv::IMWRITE_PNG_STRATEGY_DEFAULT, cv::IMWRITE_PNG_STRATEGY_FILTERED,
+                                     cv::IMWRITE_PNG_STRATEGY_HUFFMAN_ONLY, cv::IMWRITE_PNG_STRATEGY_RLE,
+                                     cv::IMWRITE_PNG_STRATEGY_FIXED};
+    if (pngStrategy != PngStrategy::Default)
+        params.insert(params.end(), {cv::IMWRITE_PNG_STRATEGY, strategies[static_cast<int>(pngStrategy)]});
+    return params;
+}
+
+bool QuadrantMap::saveAsImage(const std::string &fileName, const std::string &layer,
+                              const ImageOptions &options) const {
+    PROFILE_SCOPE(SaveImage);
+    cv::Mat image;
+    if (!renderImage(layer, options, image))
+        return false;
+    if (image.empty())
+        return true; // пустой квадрант пропущен
+    if (!cv::imwrite(fileName, image, options.encoderParams())) {
         std::cerr << "Не удалось сохранить изображение: " << fileName << "\n";
         return false;
     }
@@ -0,0 +1,163 @@
+#include "TileGrid.hpp"
+#include "Profiler.hpp"
+#include "Simd.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+constexpr std::size_t CACHE_LINE_FLOATS = 64 / sizeof(float);
+
+} // namespace
+
+TilePool::TilePool(std::size_t tileFloats, std::size_t tilesPerSlab)
+    : tileFloats_(tileFloats), tilesPerSlab_(std::max<std::size_t>(1, tilesPerSlab)) {}
+
+float* TilePool::allocate() {
+    float* tile = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            // Память без типа: пул раздаёт и float-плитки, и компактные (CompactTileGrid).
+            // Запас на выравнивание начала куска по кэш-линии
+            const std::size_t bytes = (tileFloats_ * tilesPerSlab_ + CACHE_LINE_FLOATS) * sizeof(float);
+            slabs_.emplace_back(new unsigned char[bytes]);
+            PROFILE_COUNT(BytesAllocated, bytes);
+            unsigned char* slab = slabs_.back().get();
+            const std::uintptr_t misalign = reinterpret_cast<std::uintptr_t>(slab) % 64;
+            if (misalign)
+                slab += 64 - misalign;
+            for (std::size_t k = tilesPerSlab_; k-- > 0;)
+                free_.push_back(reinterpret_cast<float*>(slab) + k * tileFloats_);
+        }
+        tile = free_.back();
+        free_.pop_back();
+    }
+    std::memset(tile, 0, tileFloats_ * sizeof(float)); // нулевые биты — 0.0f и нулевой счётчик
+    return tile;
+}
+
+void TilePool::release(float* tile) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(tile);
+}
+
+std::size_t TilePool::reservedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slabs_.size() * tilesPerSlab_ * tileFloats_ * sizeof(float);
+}
+
+TileGrid::TileGrid(int rows, int cols, std::shared_ptr<TilePool> pool, int stride)
+    : rows_(rows),
+      cols_(cols),
+      tileRows_((rows + TILE_MASK) >> TILE_SHIFT),
+      tileCols_((cols + TILE_MASK) >> TILE_SHIFT),
+      strideShift_(0),
+      tiles_(static_cast<std::size_t>(tileRows_) * tileCols_, nullptr),
+      external_(tiles_.size(), false) {
+    while ((1 << strideShift_) < stride)
+        strideShift_++;
+    pool_ = pool ? std::move(pool) : std::make_shared<TilePool>(tileFloats());
+}
+
+TileGrid::~TileGrid() {
+    for (std::size_t k = 0; k < tiles_.size(); k++) {
+        if (tiles_[k] && !external_[k])
+            pool_->release(tiles_[k]);
+    }
+}
+
+float* TileGrid::allocateTile() {
+    allocated_++;
+    return pool_->allocate();
+}
+
+bool TileGrid::attachTile(int ti, int tj, float* external) {
+    const std::size_t k = static_cast<std::size_t>(tj) * tileRows_ + ti;
+    if (tiles_[k])
+        return false;
+    tiles_[k] = external;
+    external_[k] = true;
+    allocated_++;
+    return true;
+}
+
+std::size_t TileGrid::memoryBytes() const {
+    return allocated_ * tileFloats() * sizeof(float) + tiles_.size() * sizeof(float*);
+}
+
+double TileGrid::sum(int channel) const {
+    double total = 0.0;
+    for (const float* tile : tiles_) {
+        if (!tile)
+            continue;
+        const float* values = tile + channel;
+        for (std::size_t k = 0; k < TILE_CELLS; k++)
+            total += values[k << strideShift_];
+    }
+    return total;
+}
+
+void TileGrid::minMax(float& minVal, float& maxVal, int channel) const {
+    minVal = std::numeric_limits<float>::max();
+    maxVal = std::numeric_limits<float>::lowest();
+    // Невыделенная плитка — это нули; у крайних плиток учитываются только ячейки внутри сетки
+    for (int tj = 0; tj < tileCols_; tj++) {
+        for (int ti = 0; ti < tileRows_; ti++) {
+            const float* t = tile(ti, tj);
+            if (!t) {
+                minVal = std::min(minVal, 0.0f);
+                maxVal = std::max(maxVal, 0.0f);
+                continue;
+            }
+            const int h = std::min(TILE_SIZE, rows_ - (ti << TILE_SHIFT));
+            const int w = std::min(TILE_SIZE, cols_ - (tj << TILE_SHIFT));
+            if (strideShift_ == 0 && h == TILE_SIZE) {
+                // Одноканальная плитка во всю высоту непрерывна
+                simd::minMax(t, static_cast<std::size_t>(w) << TILE_SHIFT, minVal, maxVal);
+                continue;
+            }
+            for (int c = 0; c < w; c++) {
+                for (int r = 0; r < h; r++) {
+                    float v = t[(static_cast<std::size_t>(r + (c << TILE_SHIFT)) << strideShift_) + channel];
+                    minVal = std::min(minVal, v);
+                    maxVal = std::max(maxVal, v);
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+CompactTileGrid<T>::CompactTileGrid(int rows, int cols, std::shared_ptr<TilePool> pool)
+    : rows_(rows),
+      cols_(cols),
+      tileRows_((rows + TileGrid::TILE_MASK) >> TileGrid::TILE_SHIFT),
+      tileCols_((cols + TileGrid::TILE_MASK) >> TileGrid::TILE_SHIFT),
+      tiles_(static_cast<std::size_t>(tileRows_) * tileCols_, nullptr),
+      pool_(pool ? std::move(pool) : std::make_shared<TilePool>(tileFloats())) {}
+
+template <typename T>
+CompactTileGrid<T>::~CompactTileGrid() {
+    for (T* tile : tiles_) {
+        if (tile)
+            pool_->release(reinterpret_cast<float*>(tile));
+    }
+}
+
+template <typename T>
+T* CompactTileGrid<T>::allocateTile() {
+    allocated_++;
+    return reinterpret_cast<T*>(pool_->allocate());
+}
+
+template <typename T>
+std::size_t CompactTileGrid<T>::memoryBytes() const {
+    return allocated_ * TileGrid::TILE_CELLS * sizeof(T) + tiles_.size() * sizeof(T*);
+}
+
+template class CompactTileGrid<std::uint16_t>;
+template class CompactTileGrid<std::uint8_t>;
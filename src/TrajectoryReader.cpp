@@ -1,11 +1,130 @@
 #include "TrajectoryReader.hpp"
+#include "MappedFile.hpp"
 
+#include <charconv>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Номера нужных столбцов: time, x, y, yaw (-1 — столбца нет)
+constexpr int FIELD_COUNT = 4;
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Число из поля [begin, end) без копирования; пробелы по краям и '+' допускаются, как у std::stod
+bool parseField(const char* begin, const char* end, double& value) {
+    while (begin < end && isBlank(*begin)) begin++;
+    if (begin < end && *begin == '+') begin++;
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc();
+}
+
+// Разбирает строки из [begin, end); begin указывает на начало строки
+void parseLines(const char* begin, const char* end, const int (&columns)[FIELD_COUNT],
+                std::vector<TrajectoryPoint>& out) {
+    int lastColumn = -1;
+    for (int column : columns)
+        lastColumn = std::max(lastColumn, column);
+    // Столбец -> номер поля (time, x, y, yaw) или -1
+    std::vector<int> slot(lastColumn + 1, -1);
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        if (columns[f] >= 0)
+            slot[columns[f]] = f;
+    }
+
+    const char* line = begin;
+    while (line < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!lineEnd)
+            lineEnd = end;
+
+        double values[FIELD_COUNT] = {0.0, 0.0, 0.0, 0.0};
+        bool valid = lineEnd > line;
+        const char* field = line;
+        for (int column = 0; valid && column <= lastColumn; column++) {
+            if (field > lineEnd) {
+                valid = false; // строка короче, чем нужно
+                break;
+            }
+            const char* fieldEnd = static_cast<const char*>(std::memchr(field, ',', lineEnd - field));
+            if (!fieldEnd)
+                fieldEnd = lineEnd;
+            if (slot[column] >= 0)
+                valid = parseField(field, fieldEnd, values[slot[column]]);
+            field = fieldEnd + 1;
+        }
+
+        if (valid && values[0] > 0.0)
+            out.push_back({values[0], values[1], values[2], values[3]});
+        line = lineEnd + 1;
+    }
+}
+
+// Номера столбцов time, x, y, yaw по заголовку [begin, end)
+void parseHeader(const char* begin, const char* end, int (&columns)[FIELD_COUNT]) {
+    static const char* const NAMES[FIELD_COUNT] = {"time.s", "local.x.m", "local.y.m", "local_yaw.grad"};
+    std::fill(columns, columns + FIELD_COUNT, -1);
+    const char* field = begin;
+    for (int column = 0; field <= end; column++) {
+        const char* fieldEnd = static_cast<const char*>(std::memchr(field, ',', end - field));
+        if (!fieldEnd)
+            fieldEnd = end;
+        const char* b = field;
+        const char* e = fieldEnd;
+        while (b < e && isBlank(*b)) b++;
+        while (e > b && (isBlank(e[-1]) || e[-1] == '\r')) e--;
+        for (int f = 0; f < FIELD_COUNT; f++) {
+            if (static_cast<std::size_t>(e - b) == std::strlen(NAMES[f]) &&
+                std::memcmp(b, NAMES[f], e - b) == 0)
+                columns[f] = column;
+        }
+        field = fieldEnd + 1;
+    }
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        if (columns[f] < 0)
+            std::cerr << "Не найден столбец " << NAMES[f] << "!\n";
+    }
+}
+
+// Поза в момент time по первому отсчёту с временем >= time (index — результат lower_bound)
+template <typename Points>
+bool interpolateAt(const Points& trajectory, std::size_t index, double time, TrajectoryPoint& out) {
+    if (index >= trajectory.size())
+        return false;
+    const TrajectoryPoint& b = trajectory[index];
+    if (b.time == time) {
+        out = b;
+        return true;
+    }
+    if (index == 0)
+        return false;
+    const TrajectoryPoint& a = trajectory[index - 1];
+    const double s = (time - a.time) / (b.time - a.time);
+    out.time = time;
+    out.x = a.x + s * (b.x - a.x);
+    out.y = a.y + s * (b.y - a.y);
+    // Разность углов в [-180, 180]: интерполяция по кратчайшей дуге
+    out.yaw = a.yaw + s * std::remainder(b.yaw - a.yaw, 360.0);
+    return true;
+}
+
+} // namespace
 
 TrajectoryReader::TrajectoryReader(const std::string& extFilePath)
     : extFilePath_(extFilePath) {}
@@ -118,6 +237,72 @@ bool TrajectoryReader::readExtFile() {
     return true;
 }
 
+bool TrajectoryReader::readExtFileMapped(int threads) {
+    MappedFile file;
+    if (!file.open(extFilePath_)) {
+        std::cerr << "Не удалось открыть файл: " << extFilePath_ << std::endl;
+        return false;
+    }
+    const char* data = file.data();
+    const char* end = data + file.size();
+
+    // Заголовок: первая строка
+    const char* headerEnd = static_cast<const char*>(std::memchr(data, '\n', end - data));
+    if (!headerEnd) {
+        std::cerr << "Файл пуст или не содержит заголовка: " << extFilePath_ << std::endl;
+        return false;
+    }
+
+    int columns[FIELD_COUNT];
+    parseHeader(data, headerEnd, columns);
+
+    // Куски тела файла, выровненные по началу строки
+    const char* body = headerEnd + 1;
+    const int chunkCount = std::max(1, std::min<int>(threads, static_cast<int>((end - body) / (1 << 20)) + 1));
+    std::vector<const char*> bounds(chunkCount + 1, end);
+    bounds[0] = body;
+    for (int k = 1; k < chunkCount; k++) {
+        const char* p = body + (end - body) * k / chunkCount;
+        p = std::max(p, bounds[k - 1]);
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        bounds[k] = nl ? nl + 1 : end;
+    }
+
+    std::vector<std::vector<TrajectoryPoint>> parts(chunkCount);
+    if (chunkCount == 1) {
+        parseLines(bounds[0], bounds[1], columns, parts[0]);
+    } else {
+        std::vector<std::thread> workers;
+        for (int k = 0; k < chunkCount; k++) {
+            workers.emplace_back([&, k] {
+                // Грубая оценка числа строк: ~64 байта на строку
+                parts[k].reserve(static_cast<std::size_t>(bounds[k + 1] - bounds[k]) / 64);
+                parseLines(bounds[k], bounds[k + 1], columns, parts[k]);
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    trajectory_.clear();
+    std::size_t total = 0;
+    for (const auto& part : parts)
+        total += part.size();
+    trajectory_.reserve(total);
+    for (const auto& part : parts)
+        trajectory_.insert(trajectory_.end(), part.begin(), part.end());
+
+    // Журнал обычно уже упорядочен по времени
+    auto byTime = [](const TrajectoryPoint &a, const TrajectoryPoint &b) { return a.time < b.time; };
+    if (!std::is_sorted(trajectory_.begin(), trajectory_.end(), byTime))
+        std::sort(trajectory_.begin(), trajectory_.end(), byTime);
+
+    if (trajectory_.empty()) {
+        std::cerr << "Не найдено валидных точек в файле " << extFilePath_ << std::endl;
+        return false;
+    }
+    return true;
+}
 
 bool TrajectoryReader::getClosestTrajectoryPoint(double imageTime, TrajectoryPoint& outPoint) const {
     if (trajectory_.empty()) {
@@ -137,3 +322,203 @@ bool TrajectoryReader::getClosestTrajectoryPoint(double imageTime, TrajectoryPoi
     return false;
 }
 
+bool TrajectoryReader::getInterpolatedTrajectoryPoint(double time, TrajectoryPoint& outPoint) const {
+    auto it = std::lower_bound(trajectory_.begin(), trajectory_.end(), time,
+                               [](const TrajectoryPoint &tp, double t) {
+                                   return tp.time < t;
+                               });
+    return interpolateAt(trajectory_, static_cast<std::size_t>(it - trajectory_.begin()), time, outPoint);
+}
+
+std::size_t TrajectoryReader::Cursor::locate(double time) {
+    const std::vector<TrajectoryPoint>& trajectory = reader_->trajectory_;
+    const std::size_t n = trajectory.size();
+    auto lowerBound = [&](std::size_t first, std::size_t last) {
+        return static_cast<std::size_t>(
+            std::lower_bound(trajectory.begin() + first, trajectory.begin() + last, time,
+                             [](const TrajectoryPoint &tp, double t) { return tp.time < t; }) -
+            trajectory.begin());
+    };
+
+    std::size_t i = std::min(index_, n);
+    std::size_t step = 1;
+    if (i < n && trajectory[i].time < time) {
+        // Вперёд: ответ в (lo, probe]
+        std::size_t lo = i;
+        while (true) {
+            std::size_t probe = lo + step;
+            if (probe >= n || trajectory[probe].time >= time) {
+                index_ = lowerBound(lo + 1, std::min(probe, n));
+                return index_;
+            }
+            lo = probe;
+            step <<= 1;
+        }
+    }
+    // Назад: hi == n или trajectory[hi].time >= time
+    std::size_t hi = i;
+    while (hi > 0 && trajectory[hi - 1].time >= time) {
+        std::size_t lo = hi > step ? hi - step : 0;
+        if (trajectory[lo].time < time) {
+            hi = lowerBound(lo + 1, hi);
+            break;
+        }
+        hi = lo;
+        step <<= 1;
+    }
+    index_ = hi;
+    return index_;
+}
+
+bool TrajectoryReader::Cursor::interpolate(double time, TrajectoryPoint& outPoint) {
+    return interpolateAt(reader_->trajectory_, locate(time), time, outPoint);
+}
+
+bool TrajectoryReader::Cursor::closest(double time, TrajectoryPoint& outPoint) {
+    const std::size_t index = locate(time);
+    if (index >= reader_->trajectory_.size())
+        return false;
+    outPoint = reader_->trajectory_[index];
+    return true;
+}
+
+TrajectoryStream::TrajectoryStream(const std::string& extFilePath)
+    : extFilePath_(extFilePath) {}
+
+TrajectoryStream::~TrajectoryStream() {
+    stop();
+}
+
+bool TrajectoryStream::start() {
+    if (reader_.joinable())
+        return true;
+    // O_NONBLOCK: открытие FIFO не ждёт писателя
+    int fd = ::open(extFilePath_.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        std::cerr << "Не удалось открыть файл: " << extFilePath_ << std::endl;
+        return false;
+    }
+    struct stat st;
+    const bool fifo = fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+    stop_ = false;
+    finished_ = false;
+    reader_ = std::thread(&TrajectoryStream::readLoop, this, fd, fifo);
+    return true;
+}
+
+void TrajectoryStream::stop() {
+    stop_ = true;
+    if (reader_.joinable())
+        reader_.join();
+}
+
+void TrajectoryStream::readLoop(int fd, bool fifo) {
+    constexpr int POLL_MS = 50;
+    std::vector<char> buffer;
+    std::size_t parsed = 0; // начало неразобранной строки в buffer
+    bool header = true;
+    int columns[FIELD_COUNT] = {-1, -1, -1, -1};
+    std::vector<TrajectoryPoint> batch;
+    char chunk[1 << 16];
+
+    while (!stop_) {
+        pollfd p{fd, POLLIN, 0};
+        const int ready = ::poll(&p, 1, POLL_MS);
+        if (ready < 0 && errno != EINTR)
+            break;
+        if (ready <= 0)
+            continue;
+        const ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            break;
+        }
+        if (n == 0) {
+            // Конец FIFO — все писатели закрыли канал; файл ждёт дописывания
+            if (fifo && (p.revents & POLLHUP))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+            continue;
+        }
+        buffer.insert(buffer.end(), chunk, chunk + n);
+
+        // Разбираются только целые строки; хвост ждёт следующего чтения
+        const char* begin = buffer.data() + parsed;
+        const char* end = buffer.data() + buffer.size();
+        const char* last = begin;
+        for (const char* nl; (nl = static_cast<const char*>(std::memchr(last, '\n', end - last))); last = nl + 1) {
+            if (header) {
+                parseHeader(last, nl, columns);
+                header = false;
+                begin = nl + 1;
+            }
+        }
+        batch.clear();
+        if (last > begin)
+            parseLines(begin, last - 1, columns, batch);
+        parsed = static_cast<std::size_t>(last - buffer.data());
+        if (parsed > (1 << 20)) {
+            buffer.erase(buffer.begin(), buffer.begin() + parsed);
+            parsed = 0;
+        }
+        if (batch.empty())
+            continue;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const TrajectoryPoint& point : batch) {
+                // Отсчёты обычно приходят по порядку; запоздавший вставляется на своё место
+                if (points_.empty() || points_.back().time <= point.time) {
+                    points_.push_back(point);
+                    continue;
+                }
+                auto it = std::upper_bound(points_.begin(), points_.end(), point.time,
+                                           [](double t, const TrajectoryPoint &tp) { return t < tp.time; });
+                points_.insert(it, point);
+            }
+        }
+        updated_.notify_all();
+    }
+    ::close(fd);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+    }
+    updated_.notify_all();
+}
+
+std::size_t TrajectoryStream::waitFor(double time, double timeout, std::unique_lock<std::mutex>& lock) {
+    updated_.wait_for(lock, std::chrono::duration<double>(timeout), [&] {
+        return finished_ || stop_ || (!points_.empty() && points_.back().time >= time);
+    });
+    return static_cast<std::size_t>(
+        std::lower_bound(points_.begin(), points_.end(), time,
+                         [](const TrajectoryPoint &tp, double t) { return tp.time < t; }) -
+        points_.begin());
+}
+
+bool TrajectoryStream::interpolate(double time, TrajectoryPoint& outPoint, double timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return interpolateAt(points_, waitFor(time, timeout, lock), time, outPoint);
+}
+
+bool TrajectoryStream::closest(double time, TrajectoryPoint& outPoint, double timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::size_t index = waitFor(time, timeout, lock);
+    if (index >= points_.size())
+        return false;
+    outPoint = points_[index];
+    return true;
+}
+
+void TrajectoryStream::discardBefore(double time) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (points_.size() > 1 && points_[1].time < time)
+        points_.pop_front();
+}
+
+std::size_t TrajectoryStream::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return points_.size();
+}
@@ -0,0 +1,83 @@
+#include "GlobalGridMapHandler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Объединение файлов карты нескольких проездов (свёртка по ключу квадранта):
+//   merge_maps <результат.map> <вход.map>... [--mode sum|max|weighted] [--weights w1,w2,...] [--threads N]
+// Геометрия и слои берутся из первого входа, остальные должны с ними совпадать.
+// Результат — обычный файл карты, поэтому проезды можно делить между процессами
+// или машинами и сводить частичные карты следующим запуском.
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Использование: " << argv[0]
+                  << " <результат.map> <вход.map>... [--mode sum|max|weighted] [--weights w1,w2,...] [--threads N]\n";
+        return -1;
+    }
+    const std::string output = argv[1];
+    std::vector<std::string> inputs;
+    MergeOptions options;
+    options.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i = 2; i < argc; i++) {
+        if (std::strncmp(argv[i], "--", 2) != 0) {
+            inputs.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Нет значения параметра: " << argv[i] << "\n";
+            return -1;
+        }
+        const std::string name = argv[i];
+        const std::string value = argv[++i];
+        if (name == "--mode") {
+            if (value == "sum")
+                options.mode = MergeMode::Sum;
+            else if (value == "max")
+                options.mode = MergeMode::Max;
+            else if (value == "weighted")
+                options.mode = MergeMode::Weighted;
+            else {
+                std::cerr << "Неизвестный способ свёртки: " << value << "\n";
+                return -1;
+            }
+        } else if (name == "--weights") {
+            std::istringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ','))
+                options.weights.push_back(std::atof(item.c_str()));
+        } else if (name == "--threads") {
+            options.threads = std::atoi(value.c_str());
+        } else {
+            std::cerr << "Неизвестный параметр: " << name << "\n";
+            return -1;
+        }
+    }
+    if (inputs.empty()) {
+        std::cerr << "Не заданы входные файлы карты\n";
+        return -1;
+    }
+
+    MapFileInfo info;
+    if (!GlobalGridMapHandler::readMapFileInfo(inputs.front(), info))
+        return -1;
+    GlobalGridMapHandler map(info.quadrantSize, info.resolution, QuadrantStorage::Sparse);
+    if (!map.setLayers(info.layers))
+        return -1;
+
+    const auto start = std::chrono::steady_clock::now();
+    MergeStats stats;
+    if (!map.mergeMapFiles(inputs, output, options, &stats))
+        return -1;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Входов: " << stats.inputs << ", квадрантов: " << stats.quadrants
+              << ", блоков прочитано: " << stats.blocksRead << ", записано: " << stats.blocksWritten
+              << ", время: " << seconds << " с\n";
+    return 0;
+}